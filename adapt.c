@@ -32,12 +32,12 @@
 *
 ***************************************************************************/
 
-#define _ADAPT_C_
-
 /***************************************************************************
 *                             INCLUDED FILES
 ***************************************************************************/
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "adapt.h"
 
 /***************************************************************************
@@ -47,20 +47,64 @@
 #define MAX_OVF 3
 #define MAX_UNF 3
 
+/* defaults for the configurable policies */
+#define DEFAULT_EMA_SHIFT   3
+#define DEFAULT_WINDOW_SIZE 16
+
+/* ADAPT_EMA keeps its average with this many fraction bits */
+#define EMA_FRACTION    8
+
 /***************************************************************************
 *                            TYPE DEFINITIONS
 ***************************************************************************/
 
-typedef struct adaptive_data_t
+struct adaptive_data_t
 {
+    adapt_params_t params;
     unsigned char codeSize;
+    unsigned char maxSize;      /* largest code size (also literal size) */
+
+    /* ADAPT_CLASSIC and ADAPT_THRESHOLD */
     unsigned char overflowCount;
     unsigned char underflowCount;
-} adaptive_data_t;
+
+    /* ADAPT_WINDOW */
+    unsigned char window[MAX_WINDOW_SIZE];  /* widths of recent deltas */
+    unsigned int windowPos;                 /* oldest entry in window */
+    unsigned int histogram[MAX_CODE_SIZE + 2];  /* count of each width */
+
+    /* ADAPT_EMA */
+    unsigned long average;      /* average width << EMA_FRACTION */
+};
+
+/* the operations that make up a policy */
+typedef struct
+{
+    const char *name;
+    void (*Reset)(adaptive_data_t *data);
+    unsigned char (*Update)(adaptive_data_t *data, const unsigned char width);
+} policy_ops_t;
 
 /***************************************************************************
 *                               PROTOTYPES
 ***************************************************************************/
+static void ResetThreshold(adaptive_data_t *data);
+static void ResetWindow(adaptive_data_t *data);
+static unsigned int GrowthBits(const unsigned int width,
+    const unsigned int maxSize);
+static void ResetEma(adaptive_data_t *data);
+
+/***************************************************************************
+*                            GLOBAL VARIABLES
+***************************************************************************/
+/* indexed by adapt_policy_t */
+static const policy_ops_t policyOps[ADAPT_NUM_POLICIES] =
+{
+    {"classic", ResetThreshold, UpdateThreshold},
+    {"window", ResetWindow, UpdateWindow},
+    {"threshold", ResetThreshold, UpdateThreshold},
+    {"ema", ResetEma, UpdateEma}
+};
 
 /***************************************************************************
 *                                FUNCTIONS
@@ -71,29 +115,67 @@ typedef struct adaptive_data_t
 *   Description: This function creates the data structure used to track
 *                encoding/decoding statistics and determine how the code
 *                word size should be adapted.
-*   Parameters : codeSize - The number of bits used for code words at the
+*   Parameters : params - The policy used to adapt the code word size and
+*                         its parameters.
+*                codeSize - The number of bits used for code words at the
 *                           start of coding.
+*                maxSize - The largest code word size the stream may use.
+*                          This is the sample size in bits, which is also
+*                          the size of the literal following an overflow.
 *   Effects    : The data structure used to track encoding/decoding
 *                statistics is created on the heap.
 *   Returned   : A pointer to created data structure on success, otherwise
 *                NULL.
 ***************************************************************************/
-adaptive_data_t* CreateAdaptiveData(const unsigned char codeSize)
+adaptive_data_t* CreateAdaptiveData(const adapt_params_t *params,
+    const unsigned char codeSize, const unsigned char maxSize)
 {
     adaptive_data_t *data;
 
+    if (!ValidAdaptiveParams(params) ||
+        (maxSize < MIN_CODE_SIZE) || (maxSize > MAX_CODE_SIZE))
+    {
+        return NULL;
+    }
+
     data = malloc(sizeof(adaptive_data_t));
 
     if (NULL != data)
     {
-        data->codeSize = codeSize;
-        data->overflowCount = 0;
-        data->underflowCount = 0;
+        data->params = *params;
+        data->maxSize = maxSize;
+
+        if (ADAPT_CLASSIC == params->policy)
+        {
+            /* the classic rules aren't configurable */
+            data->params.maxOverflow = MAX_OVF;
+            data->params.maxUnderflow = MAX_UNF;
+            data->params.step = 1;
+        }
+
+        ResetAdaptiveData(data, codeSize);
     }
 
     return data;
 }
 
+/***************************************************************************
+*   Function   : ResetAdaptiveData
+*   Description: This function returns the data structure used to track
+*                encoding/decoding statistics to the state it had when it
+*                was created, but with a new starting code size.
+*   Parameters : data - a pointer to the data structure to be reset.
+*                codeSize - The number of bits used for code words at the
+*                           start of coding.
+*   Effects    : All statistics are cleared.
+*   Returned   : None
+***************************************************************************/
+void ResetAdaptiveData(adaptive_data_t *data, const unsigned char codeSize)
+{
+    data->codeSize = codeSize;
+    policyOps[data->params.policy].Reset(data);
+}
+
 /***************************************************************************
 *   Function   : FreeAdaptiveData
 *   Description: This function frees the data structure used to track
@@ -119,23 +201,57 @@ void FreeAdaptiveData(adaptive_data_t *data)
 *                word size to be used.
 *   Parameters : data - pointer to the data structure that is used to
 *                       determine the code word size.
-*                stat - an indication of overflow, underflow, or neither
-*                       used to determine the size of the next code word.
+*                width - the number of bits needed to code the current
+*                        delta without an overflow (see DeltaWidth).
 *   Effects    : Statistical counters are updated and a new code word
 *                length may be determined.
 *   Returned   : The number of bits to be used for the next code word.
 ***************************************************************************/
 unsigned char UpdateAdaptiveStatistics(adaptive_data_t *data,
-    const code_word_stat_t stat)
+    const unsigned char width)
+{
+    return policyOps[data->params.policy].Update(data, width);
+}
+
+/***************************************************************************
+*   Function   : ResetThreshold
+*   Description: This function clears the overflow and underflow counters
+*                used by ADAPT_CLASSIC and ADAPT_THRESHOLD.
+*   Parameters : data - pointer to the data structure to be reset.
+*   Effects    : Counters are cleared.
+*   Returned   : None
+***************************************************************************/
+static void ResetThreshold(adaptive_data_t *data)
 {
-    switch(stat)
+    data->overflowCount = 0;
+    data->underflowCount = 0;
+}
+
+/***************************************************************************
+*   Function   : UpdateThreshold
+*   Description: This function implements the original adaptation rules
+*                with configurable parameters.  The code word size grows
+*                (shrinks) by step bits once overflows (underflows)
+*                outnumber fits by maxOverflow (maxUnderflow).
+*   Parameters : data - pointer to the data structure that is used to
+*                       determine the code word size.
+*                width - the number of bits needed to code the current
+*                        delta without an overflow.
+*   Effects    : Statistical counters are updated and a new code word
+*                length may be determined.
+*   Returned   : The number of bits to be used for the next code word.
+***************************************************************************/
+unsigned char UpdateThreshold(adaptive_data_t *data,
+    const unsigned char width)
+{
+    switch(ClassifyWidth(width, data->codeSize))
     {
         case CS_OKAY:
             if (data->overflowCount > 0)
             {
                 data->overflowCount--;
             }
-            
+
             if (data->underflowCount > 0)
             {
                 data->underflowCount--;
@@ -150,11 +266,15 @@ unsigned char UpdateAdaptiveStatistics(adaptive_data_t *data,
 
             data->overflowCount++;
 
-            if (MAX_OVF < data->overflowCount)
+            if (data->params.maxOverflow < data->overflowCount)
             {
-                if (data->codeSize < 8)
+                if (data->codeSize + data->params.step < data->maxSize)
                 {
-                    data->codeSize++;
+                    data->codeSize += data->params.step;
+                }
+                else
+                {
+                    data->codeSize = data->maxSize;
                 }
 
                 data->underflowCount = 0;
@@ -170,21 +290,519 @@ unsigned char UpdateAdaptiveStatistics(adaptive_data_t *data,
 
             data->underflowCount++;
 
-            if (MAX_UNF < data->underflowCount)
+            if (data->params.maxUnderflow < data->underflowCount)
             {
-                if (data->codeSize > 2)
+                if (data->codeSize > MIN_CODE_SIZE + data->params.step)
+                {
+                    data->codeSize -= data->params.step;
+                }
+                else
                 {
-                    data->codeSize--;
+                    data->codeSize = MIN_CODE_SIZE;
                 }
 
                 data->underflowCount = 0;
                 data->overflowCount = 0;
             }
             break;
-            
+
         default:
             break;
     }
 
     return data->codeSize;
 }
+
+/***************************************************************************
+*   Function   : ResetWindow
+*   Description: This function fills the ADAPT_WINDOW window as if every
+*                delta in it was a perfect fit for the current code size.
+*   Parameters : data - pointer to the data structure to be reset.
+*   Effects    : The window and histogram are reset.
+*   Returned   : None
+***************************************************************************/
+static void ResetWindow(adaptive_data_t *data)
+{
+    unsigned int i;
+
+    for (i = 0; i < data->params.windowSize; i++)
+    {
+        data->window[i] = data->codeSize;
+    }
+
+    for (i = 0; i < (MAX_CODE_SIZE + 2); i++)
+    {
+        data->histogram[i] = 0;
+    }
+
+    data->histogram[data->codeSize] = data->params.windowSize;
+    data->windowPos = 0;
+}
+
+/***************************************************************************
+*   Function   : UpdateWindow
+*   Description: This function keeps a histogram of the widths of the last
+*                windowSize deltas and picks the code word size that would
+*                have coded the window in the fewest bits (see
+*                CheapestCodeSize).  The size may jump by any number of
+*                bits in one update.
+*   Parameters : data - pointer to the data structure that is used to
+*                       determine the code word size.
+*                width - the number of bits needed to code the current
+*                        delta without an overflow.
+*   Effects    : The window and histogram are updated and a new code word
+*                length may be determined.
+*   Returned   : The number of bits to be used for the next code word.
+***************************************************************************/
+unsigned char UpdateWindow(adaptive_data_t *data, const unsigned char width)
+{
+    unsigned int clipped, maxSize;
+    unsigned long windowSize;
+
+    maxSize = data->maxSize;
+    clipped = (width > (maxSize + 1)) ? (maxSize + 1) : width;
+    windowSize = data->params.windowSize;
+
+    /* replace the oldest width with the current one */
+    data->histogram[data->window[data->windowPos]]--;
+    data->histogram[clipped]++;
+    data->window[data->windowPos] = clipped;
+    data->windowPos++;
+
+    if (data->windowPos == windowSize)
+    {
+        data->windowPos = 0;
+    }
+
+    data->codeSize = CheapestCodeSize(data->histogram, windowSize, maxSize);
+    return data->codeSize;
+}
+
+/***************************************************************************
+*   Function   : CheapestCodeSize
+*   Description: This function picks the code word size that would code a
+*                set of deltas in the fewest bits, given a histogram of
+*                their widths.  Deltas that don't fit cost an overflow
+*                code word plus whichever is shorter of the unary size
+*                increment and the literal the coder could follow it with.
+*                Adaptation while coding isn't taken into account.
+*   Parameters : histogram - The number of deltas of each width.  It has
+*                            maxSize + 2 entries, with deltas wider than
+*                            maxSize counted in the last.
+*                count - The number of deltas in the histogram.
+*                maxSize - The largest code word size.
+*   Effects    : None
+*   Returned   : The cheapest code word size.  Ties go to the larger size,
+*                which is cheaper if the deltas are still growing.
+***************************************************************************/
+unsigned char CheapestCodeSize(const unsigned int *histogram,
+    const unsigned long count, const unsigned char maxSize)
+{
+    unsigned int size, top, literal, entries;
+    unsigned long cost, bestCost, sized, fixed;
+    unsigned char best;
+
+    /* walk sizes from largest to smallest.  a delta costs size bits,
+     * size bits and a literal, or, once it's grown in unary, bits that
+     * don't depend on the size.  sized counts the deltas costing size
+     * bits and fixed sums the bits that don't.  only the most negative
+     * sample is wider than maxSize, and it always needs a literal (a
+     * flag bit and maxSize bits). */
+    literal = maxSize + 1;
+    entries = histogram[maxSize + 1];
+    sized = count;
+    fixed = (unsigned long)entries * literal;
+
+    /* sizes wider than every delta only cost more */
+    for (top = maxSize; (top > MIN_CODE_SIZE) && (0 == entries) &&
+        (0 == histogram[top]); top--)
+    {
+    }
+
+    bestCost = top * sized + fixed;
+    best = top;
+
+    /* widths size + 1 through top are grown */
+    for (size = top - 1; size >= MIN_CODE_SIZE; size--)
+    {
+        /* a width just past the size is always cheaper grown */
+        entries = histogram[size + 1];
+        sized -= entries;
+        fixed += (unsigned long)entries * GrowthBits(size + 1, maxSize);
+
+        /* the increments get longer as the size shrinks, so the widest
+         * grown widths switch to literals */
+        while (GrowthBits(top, maxSize) - size >= literal)
+        {
+            entries = histogram[top];
+            sized += entries;
+            fixed -= (unsigned long)entries *
+                (GrowthBits(top, maxSize) - literal);
+            top--;
+        }
+
+        cost = size * sized + fixed;
+
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            best = size;
+        }
+    }
+
+    return best;
+}
+
+/***************************************************************************
+*   Function   : GrowthBits
+*   Description: This function computes the bits used to code a delta
+*                that overflows as a unary code size increment, plus the
+*                code size it overflowed.  It mirrors OverflowCost in
+*                delta.c.
+*   Parameters : width - the number of bits needed to code the delta.  It
+*                        must not be more than maxSize.
+*                maxSize - The largest code word size.
+*   Effects    : None
+*   Returned   : The bits in the increment and the delta, plus the size
+*                of the code word that overflowed.
+***************************************************************************/
+static unsigned int GrowthBits(const unsigned int width,
+    const unsigned int maxSize)
+{
+    /* the increment in unary, ending with a 0 unless it reaches maxSize,
+     * then the delta less its top bit */
+    return width + (width - 1) + ((width < maxSize) ? 1 : 0);
+}
+
+/***************************************************************************
+*   Function   : ResetEma
+*   Description: This function starts the ADAPT_EMA average at the current
+*                code size.
+*   Parameters : data - pointer to the data structure to be reset.
+*   Effects    : The average is reset.
+*   Returned   : None
+***************************************************************************/
+static void ResetEma(adaptive_data_t *data)
+{
+    data->average = (unsigned long)data->codeSize << EMA_FRACTION;
+}
+
+/***************************************************************************
+*   Function   : UpdateEma
+*   Description: This function keeps an exponential moving average of the
+*                widths of deltas, weighting the newest width by
+*                2^-emaShift, and uses the average rounded up as the code
+*                word size.
+*   Parameters : data - pointer to the data structure that is used to
+*                       determine the code word size.
+*                width - the number of bits needed to code the current
+*                        delta without an overflow.
+*   Effects    : The average is updated and a new code word length may be
+*                determined.
+*   Returned   : The number of bits to be used for the next code word.
+***************************************************************************/
+unsigned char UpdateEma(adaptive_data_t *data, const unsigned char width)
+{
+    unsigned long sample, size;
+
+    sample = (unsigned long)width << EMA_FRACTION;
+
+    /* average += (sample - average) / 2^shift without signed math */
+    if (sample >= data->average)
+    {
+        data->average += (sample - data->average) >> data->params.emaShift;
+    }
+    else
+    {
+        data->average -= (data->average - sample) >> data->params.emaShift;
+    }
+
+    size = (data->average + (1UL << EMA_FRACTION) - 1) >> EMA_FRACTION;
+
+    if (size < MIN_CODE_SIZE)
+    {
+        size = MIN_CODE_SIZE;
+    }
+    else if (size > data->maxSize)
+    {
+        size = data->maxSize;
+    }
+
+    data->codeSize = (unsigned char)size;
+    return data->codeSize;
+}
+
+/***************************************************************************
+*   Function   : DefaultAdaptiveParams
+*   Description: This function fills in a parameter structure with the
+*                default parameters for a policy.
+*   Parameters : params - pointer to the structure to fill in.
+*                policy - the policy the parameters are for.
+*   Effects    : params is filled in.  Parameters that don't apply to the
+*                policy are set to their defaults too.
+*   Returned   : None
+***************************************************************************/
+void DefaultAdaptiveParams(adapt_params_t *params,
+    const adapt_policy_t policy)
+{
+    params->policy = policy;
+    params->maxOverflow = MAX_OVF;
+    params->maxUnderflow = MAX_UNF;
+    params->step = 1;
+    params->emaShift = DEFAULT_EMA_SHIFT;
+    params->windowSize = DEFAULT_WINDOW_SIZE;
+}
+
+/***************************************************************************
+*   Function   : ValidAdaptiveParams
+*   Description: This function checks that a policy exists and its
+*                parameters are in range.
+*   Parameters : params - pointer to the parameters to check.
+*   Effects    : None
+*   Returned   : Non-zero if the parameters may be used, otherwise 0.
+***************************************************************************/
+int ValidAdaptiveParams(const adapt_params_t *params)
+{
+    if ((NULL == params) || (params->policy >= ADAPT_NUM_POLICIES))
+    {
+        return 0;
+    }
+
+    if ((0 == params->step) ||
+        (params->step > (MAX_CODE_SIZE - MIN_CODE_SIZE)))
+    {
+        return 0;
+    }
+
+    if ((0 == params->emaShift) || (params->emaShift > EMA_FRACTION))
+    {
+        return 0;
+    }
+
+    if ((0 == params->windowSize) || (params->windowSize > MAX_WINDOW_SIZE))
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+/***************************************************************************
+*   Function   : ParseAdaptiveParams
+*   Description: This function converts a text description of a policy to
+*                its parameters.  The description is the policy name
+*                optionally followed by comma separated parameters:
+*                    classic
+*                    threshold[,maxOverflow[,maxUnderflow[,step]]]
+*                    ema[,emaShift]
+*                    window[,windowSize]
+*                Parameters that are left out keep their defaults.
+*   Parameters : text - the description to parse.
+*                params - pointer to the structure receiving the result.
+*   Effects    : params is filled in.
+*   Returned   : 0 for success, -1 if the description isn't valid.
+***************************************************************************/
+int ParseAdaptiveParams(const char *text, adapt_params_t *params)
+{
+    unsigned char *fields[3];
+    unsigned int policy, count, i;
+    size_t nameLength;
+    unsigned long value;
+    char *end;
+
+    if (NULL == text)
+    {
+        return -1;
+    }
+
+    nameLength = strcspn(text, ",");
+
+    for (policy = 0; policy < ADAPT_NUM_POLICIES; policy++)
+    {
+        if ((strlen(policyOps[policy].name) == nameLength) &&
+            (0 == strncmp(policyOps[policy].name, text, nameLength)))
+        {
+            break;
+        }
+    }
+
+    if (ADAPT_NUM_POLICIES == policy)
+    {
+        return -1;
+    }
+
+    DefaultAdaptiveParams(params, (adapt_policy_t)policy);
+
+    /* the parameters each policy takes, in order */
+    switch (policy)
+    {
+        case ADAPT_THRESHOLD:
+            fields[0] = &(params->maxOverflow);
+            fields[1] = &(params->maxUnderflow);
+            fields[2] = &(params->step);
+            count = 3;
+            break;
+
+        case ADAPT_EMA:
+            fields[0] = &(params->emaShift);
+            count = 1;
+            break;
+
+        case ADAPT_WINDOW:
+            fields[0] = &(params->windowSize);
+            count = 1;
+            break;
+
+        default:
+            count = 0;
+            break;
+    }
+
+    text += nameLength;
+
+    for (i = 0; ('\0' != *text); i++)
+    {
+        if ((i == count) || (',' != *text))
+        {
+            /* too many parameters or garbage */
+            return -1;
+        }
+
+        text++;
+        value = strtoul(text, &end, 10);
+
+        if ((end == text) || (value > 255))
+        {
+            return -1;
+        }
+
+        *(fields[i]) = (unsigned char)value;
+        text = end;
+    }
+
+    return ValidAdaptiveParams(params) ? 0 : -1;
+}
+
+/***************************************************************************
+*   Function   : FormatAdaptiveParams
+*   Description: This function writes the text description of a policy
+*                and its parameters in the form read by ParseAdaptiveParams.
+*   Parameters : params - the parameters to describe.
+*                text - buffer of at least ADAPT_TEXT_SIZE characters that
+*                       receives the description.
+*   Effects    : text is filled in.
+*   Returned   : None
+***************************************************************************/
+void FormatAdaptiveParams(const adapt_params_t *params, char *text)
+{
+    const char *name;
+
+    name = AdaptivePolicyName(params->policy);
+
+    switch (params->policy)
+    {
+        case ADAPT_THRESHOLD:
+            sprintf(text, "%s,%u,%u,%u", name, params->maxOverflow,
+                params->maxUnderflow, params->step);
+            break;
+
+        case ADAPT_EMA:
+            sprintf(text, "%s,%u", name, params->emaShift);
+            break;
+
+        case ADAPT_WINDOW:
+            sprintf(text, "%s,%u", name, params->windowSize);
+            break;
+
+        case ADAPT_CLASSIC:
+            sprintf(text, "%s", name);
+            break;
+
+        default:
+            text[0] = '\0';
+            break;
+    }
+}
+
+/***************************************************************************
+*   Function   : AdaptivePolicyName
+*   Description: This function returns the name of a policy as accepted by
+*                ParseAdaptiveParams.
+*   Parameters : policy - the policy
+*   Effects    : None
+*   Returned   : The name of the policy, or NULL for unknown policies.
+***************************************************************************/
+const char *AdaptivePolicyName(const adapt_policy_t policy)
+{
+    if (policy >= ADAPT_NUM_POLICIES)
+    {
+        return NULL;
+    }
+
+    return policyOps[policy].name;
+}
+
+/***************************************************************************
+*   Function   : DeltaWidth
+*   Description: This function computes the smallest code word size that
+*                can hold a delta without an overflow.  An n bit code word
+*                holds values in the range (-2^(n - 1), 2^(n - 1) - 1];
+*                -2^(n - 1) is reserved to indicate an overflow.
+*   Parameters : delta - the delta to be coded
+*   Effects    : None
+*   Returned   : The number of bits required to code delta.
+***************************************************************************/
+unsigned char DeltaWidth(const long delta)
+{
+    /* bits in each value of a nibble */
+    static const unsigned char nibbleBits[16] =
+        {0, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+    unsigned char width;
+    unsigned long magnitude;
+
+    /* count bits in the magnitude; a sign bit is added below */
+    if (delta < 0)
+    {
+        magnitude = (unsigned long)(-(delta + 1)) + 1;
+    }
+    else
+    {
+        magnitude = (unsigned long)delta;
+    }
+
+    width = 1;
+
+    while (magnitude > 0x0F)
+    {
+        width += 4;
+        magnitude >>= 4;
+    }
+
+    return width + nibbleBits[magnitude];
+}
+
+/***************************************************************************
+*   Function   : ClassifyWidth
+*   Description: This function determines how well a delta of a given
+*                width fits a code word of a given size.
+*   Parameters : width - the number of bits needed to code the delta
+*                        without an overflow.
+*                codeSize - the size of the code word.
+*   Effects    : None
+*   Returned   : CS_OVERFLOW if the delta doesn't fit, CS_UNDERFLOW if it
+*                would fit a code word one bit smaller, otherwise CS_OKAY.
+***************************************************************************/
+code_word_stat_t ClassifyWidth(const unsigned char width,
+    const unsigned char codeSize)
+{
+    if (width > codeSize)
+    {
+        return CS_OVERFLOW;
+    }
+    else if (width < codeSize)
+    {
+        return CS_UNDERFLOW;
+    }
+
+    return CS_OKAY;
+}
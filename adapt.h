@@ -33,9 +33,29 @@
 #ifndef _ADAPT_H_
 #define _ADAPT_H_
 
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <limits.h>
+
 /***************************************************************************
 *                                CONSTANTS
 ***************************************************************************/
+/* limits on code word size; a code word is never wider than the widest
+ * sample an unsigned long can hold */
+#define MIN_CODE_SIZE   2
+
+#if (ULONG_MAX > 0xFFFFFFFFUL)
+#define MAX_CODE_SIZE   64
+#else
+#define MAX_CODE_SIZE   32
+#endif
+
+/* largest window allowed for ADAPT_WINDOW */
+#define MAX_WINDOW_SIZE 64
+
+/* buffer size needed by FormatAdaptiveParams */
+#define ADAPT_TEXT_SIZE 32
 
 /***************************************************************************
 *                            TYPE DEFINITIONS
@@ -47,18 +67,76 @@ typedef enum
     CS_UNDERFLOW
 } code_word_stat_t;
 
-#ifndef _ADAPT_C_
+/* rules for adapting the code word size (values are stored in streams) */
+typedef enum
+{
+    ADAPT_CLASSIC = 0,      /* +/-1 bit after 3 overflows/underflows */
+    ADAPT_WINDOW = 1,       /* cheapest size for a window of recent deltas */
+    ADAPT_THRESHOLD = 2,    /* ADAPT_CLASSIC with configurable parameters */
+    ADAPT_EMA = 3,          /* follow moving average of delta widths */
+    ADAPT_NUM_POLICIES
+} adapt_policy_t;
+
+/* a policy and its parameters; everything here is stored in streams */
+typedef struct
+{
+    adapt_policy_t policy;
+    unsigned char maxOverflow;  /* THRESHOLD: overflows before growing */
+    unsigned char maxUnderflow; /* THRESHOLD: underflows before shrinking */
+    unsigned char step;         /* THRESHOLD: bits to grow or shrink by */
+    unsigned char emaShift;     /* EMA: new widths are weighted 2^-emaShift */
+    unsigned char windowSize;   /* WINDOW: number of deltas in window */
+} adapt_params_t;
+
+/* statistics used to pick code word sizes (contents private to adapt.c) */
+struct adaptive_data_t;
 typedef struct adaptive_data_t adaptive_data_t;
 
 /***************************************************************************
 *                               PROTOTYPES
 ***************************************************************************/
-/* create and free data structures used for adaptive code size computations */
-adaptive_data_t* CreateAdaptiveData(const unsigned char codeSize);
+
+/* create, reset, and free data structures used for adaptive code size
+ * computations.  maxSize is the largest code size the stream may use. */
+adaptive_data_t* CreateAdaptiveData(const adapt_params_t *params,
+    const unsigned char codeSize, const unsigned char maxSize);
+void ResetAdaptiveData(adaptive_data_t *data, const unsigned char codeSize);
 void FreeAdaptiveData(adaptive_data_t *data);
 
-/* returns code size for next code word based on fit of current code word */
+/* returns code size for next code word based on width of current delta */
 unsigned char UpdateAdaptiveStatistics(adaptive_data_t *data,
-    const code_word_stat_t stat);
-#endif  /* ndef _ADAPT_C_ */
+    const unsigned char width);
+
+/***************************************************************************
+* Policy specific versions of UpdateAdaptiveStatistics.  Coding loops that
+* call these directly avoid dispatching on the policy for every symbol.
+* They must only be called with data created for the matching policy
+* (UpdateThreshold handles ADAPT_CLASSIC and ADAPT_THRESHOLD).
+***************************************************************************/
+unsigned char UpdateThreshold(adaptive_data_t *data,
+    const unsigned char width);
+unsigned char UpdateWindow(adaptive_data_t *data, const unsigned char width);
+unsigned char UpdateEma(adaptive_data_t *data, const unsigned char width);
+
+/* policy parameters */
+void DefaultAdaptiveParams(adapt_params_t *params,
+    const adapt_policy_t policy);
+int ValidAdaptiveParams(const adapt_params_t *params);
+int ParseAdaptiveParams(const char *text, adapt_params_t *params);
+void FormatAdaptiveParams(const adapt_params_t *params, char *text);
+const char *AdaptivePolicyName(const adapt_policy_t policy);
+
+/* number of bits needed to code a delta without an overflow */
+unsigned char DeltaWidth(const long delta);
+
+/* code size that would code deltas with the given histogram of widths in
+ * the fewest bits.  histogram has maxSize + 2 entries, with widths above
+ * maxSize counted in the last. */
+unsigned char CheapestCodeSize(const unsigned int *histogram,
+    const unsigned long count, const unsigned char maxSize);
+
+/* fit of a delta with the given width to a code word of codeSize bits */
+code_word_stat_t ClassifyWidth(const unsigned char width,
+    const unsigned char codeSize);
+
 #endif  /* ndef _ADAPT_H_ */
@@ -0,0 +1,290 @@
+/***************************************************************************
+*                      Delta Encoding Block Checksums
+*
+*   File    : crc32c.c
+*   Purpose : Module that computes the CRC-32C (Castagnoli) checksum
+*             stored with every block, so corrupt blocks are found instead
+*             of decoded into garbage.  It's the CRC computed by SSE4.2's
+*             crc32 instruction, which is used when GCC compatible
+*             compilers build for x86 processors that have it.  Otherwise
+*             portable tables handle 8 bytes per step (slicing by 8).
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Delta: An adaptive delta encoding/decoding library
+* Copyright (C) 2026 by
+*       Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the Delta library.
+*
+* Delta is free software; you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or (at your
+* option) any later version.
+*
+* Delta is distributed in the hope that it will be useful, but WITHOUT ANY
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+* License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <string.h>
+#include "crc32c.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+/* Castagnoli polynomial, bit reversed */
+#define POLYNOMIAL      0x82F63B78UL
+
+#define CRC_MASK        0xFFFFFFFFUL
+
+/* bytes handled by each step of the table loop */
+#define SLICES          8
+
+/* the crc32 instruction needs GCC's target attribute and CPU detection;
+ * define CRC32C_NO_HARDWARE to build with the tables only */
+#if defined(__GNUC__) && !defined(CRC32C_NO_HARDWARE) && \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 8)))
+#define HARDWARE_CRC
+#endif
+
+/* CRC-32C of "123456789" (the check value from the CRC catalogs) */
+#define CHECK_TEXT      "123456789"
+#define CHECK_CRC       0xE3069283UL
+
+/***************************************************************************
+*                            GLOBAL VARIABLES
+***************************************************************************/
+/* tables[k][b] is the CRC of byte b followed by k zero bytes */
+static unsigned long tables[SLICES][256];
+static int crcReady = 0;
+
+#ifdef HARDWARE_CRC
+static int useHardware = 0;     /* non-zero if the crc32 instruction is
+                                 * used */
+#endif
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static void InitCrc(void);
+static void MakeTables(void);
+static unsigned long TableCrc(unsigned long crc, const unsigned char *buffer,
+    size_t length);
+
+#ifdef HARDWARE_CRC
+static unsigned long HardwareCrc(unsigned long crc,
+    const unsigned char *buffer, size_t length)
+    __attribute__((target("sse4.2")));
+#endif
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : Crc32c
+*   Description: This function computes the CRC-32C of a buffer, or
+*                continues one over another buffer.
+*   Parameters : crc - The CRC of the bytes before buffer, or 0 to start a
+*                      new CRC.
+*                buffer - The bytes to add to the CRC.
+*                length - The number of bytes in buffer.
+*   Effects    : The tables are built and the method is picked on the
+*                first call.
+*   Returned   : The CRC of the bytes so far.
+***************************************************************************/
+unsigned long Crc32c(unsigned long crc, const unsigned char *buffer,
+    size_t length)
+{
+    if (!crcReady)
+    {
+        InitCrc();
+    }
+
+    crc = ~crc & CRC_MASK;
+
+#ifdef HARDWARE_CRC
+    if (useHardware)
+    {
+        return ~HardwareCrc(crc, buffer, length) & CRC_MASK;
+    }
+#endif
+
+    return ~TableCrc(crc, buffer, length) & CRC_MASK;
+}
+
+/***************************************************************************
+*   Function   : InitCrc
+*   Description: This function builds the tables and uses the crc32
+*                instruction if the processor has it and it gives the
+*                same CRCs as the tables.
+*   Parameters : None
+*   Effects    : tables is filled in, useHardware is set, and crcReady is
+*                set.
+*   Returned   : None
+***************************************************************************/
+static void InitCrc(void)
+{
+#ifdef HARDWARE_CRC
+    unsigned char test[67];
+    size_t i;
+#endif
+
+    MakeTables();
+
+#ifdef HARDWARE_CRC
+    /* long enough for the 8 byte steps and an odd tail */
+    for (i = 0; i < sizeof(test); i++)
+    {
+        test[i] = (unsigned char)(i * 149 + 7);
+    }
+
+    __builtin_cpu_init();
+    useHardware = __builtin_cpu_supports("sse4.2") &&
+        (CHECK_CRC == (~HardwareCrc(CRC_MASK,
+        (const unsigned char *)CHECK_TEXT, 9) & CRC_MASK)) &&
+        (HardwareCrc(CRC_MASK, test, sizeof(test)) ==
+        TableCrc(CRC_MASK, test, sizeof(test)));
+#endif
+
+    crcReady = 1;
+}
+
+/***************************************************************************
+*   Function   : TableCrc
+*   Description: This function adds bytes to a CRC with the tables.
+*   Parameters : crc - The CRC so far, before its final inversion.
+*                buffer - The bytes to add to the CRC.
+*                length - The number of bytes in buffer.
+*   Effects    : None
+*   Returned   : The CRC with the bytes added, before its final inversion.
+***************************************************************************/
+static unsigned long TableCrc(unsigned long crc, const unsigned char *buffer,
+    size_t length)
+{
+    /* 8 independent table lookups per step instead of 8 dependent ones */
+    for (; length >= SLICES; length -= SLICES)
+    {
+        crc ^= (unsigned long)buffer[0] | ((unsigned long)buffer[1] << 8) |
+            ((unsigned long)buffer[2] << 16) |
+            ((unsigned long)buffer[3] << 24);
+        crc = tables[7][crc & 0xFF] ^ tables[6][(crc >> 8) & 0xFF] ^
+            tables[5][(crc >> 16) & 0xFF] ^ tables[4][crc >> 24] ^
+            tables[3][buffer[4]] ^ tables[2][buffer[5]] ^
+            tables[1][buffer[6]] ^ tables[0][buffer[7]];
+        buffer += SLICES;
+    }
+
+    for (; 0 != length; length--)
+    {
+        crc = tables[0][(crc ^ *buffer) & 0xFF] ^ (crc >> 8);
+        buffer++;
+    }
+
+    return crc;
+}
+
+#ifdef HARDWARE_CRC
+/***************************************************************************
+*   Function   : HardwareCrc
+*   Description: This function adds bytes to a CRC with SSE4.2's crc32
+*                instruction.  It must only be called if the processor
+*                supports SSE4.2.
+*   Parameters : crc - The CRC so far, before its final inversion.
+*                buffer - The bytes to add to the CRC.
+*                length - The number of bytes in buffer.
+*   Effects    : None
+*   Returned   : The CRC with the bytes added, before its final inversion.
+***************************************************************************/
+static unsigned long HardwareCrc(unsigned long crc,
+    const unsigned char *buffer, size_t length)
+{
+    unsigned int crc32;
+
+    crc32 = (unsigned int)crc;
+
+#ifdef __x86_64__
+    {
+        /* x86 is little endian, so this is the stream's byte order */
+        __extension__ unsigned long long word;
+        __extension__ unsigned long long crc64;
+
+        crc64 = crc32;
+
+        for (; length >= 8; length -= 8)
+        {
+            memcpy(&word, buffer, 8);
+            crc64 = __builtin_ia32_crc32di(crc64, word);
+            buffer += 8;
+        }
+
+        crc32 = (unsigned int)crc64;
+    }
+#else
+    {
+        unsigned int word;
+
+        for (; length >= 4; length -= 4)
+        {
+            memcpy(&word, buffer, 4);
+            crc32 = __builtin_ia32_crc32si(crc32, word);
+            buffer += 4;
+        }
+    }
+#endif
+
+    for (; 0 != length; length--)
+    {
+        crc32 = __builtin_ia32_crc32qi(crc32, *buffer);
+        buffer++;
+    }
+
+    return crc32;
+}
+#endif
+
+/***************************************************************************
+*   Function   : MakeTables
+*   Description: This function builds the tables used by Crc32c.
+*   Parameters : None
+*   Effects    : tables is filled in.
+*   Returned   : None
+***************************************************************************/
+static void MakeTables(void)
+{
+    unsigned long crc;
+    int b, bit, k;
+
+    for (b = 0; b < 256; b++)
+    {
+        crc = (unsigned long)b;
+
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+        }
+
+        tables[0][b] = crc;
+    }
+
+    for (k = 1; k < SLICES; k++)
+    {
+        for (b = 0; b < 256; b++)
+        {
+            crc = tables[k - 1][b];
+            tables[k][b] = (crc >> 8) ^ tables[0][crc & 0xFF];
+        }
+    }
+}
@@ -0,0 +1,48 @@
+/***************************************************************************
+*                  Header for Delta Encoding Block Checksums
+*
+*   File    : crc32c.h
+*   Purpose : Provides the prototype for the CRC-32C (Castagnoli)
+*             checksum used to detect corrupt blocks.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Delta: An adaptive delta encoding/decoding library
+* Copyright (C) 2026 by
+*       Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the Delta library.
+*
+* Delta is free software; you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or (at your
+* option) any later version.
+*
+* Delta is distributed in the hope that it will be useful, but WITHOUT ANY
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+* License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+#ifndef _CRC32C_H_
+#define _CRC32C_H_
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stddef.h>
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+/* CRC-32C of length bytes continuing from crc (0 to start) */
+unsigned long Crc32c(unsigned long crc, const unsigned char *buffer,
+    size_t length);
+
+#endif  /* ndef _CRC32C_H_ */
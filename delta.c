@@ -29,51 +29,445 @@
 *
 ***************************************************************************/
 
+
 /***************************************************************************
 *                             INCLUDED FILES
 ***************************************************************************/
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <errno.h>
+#include <time.h>
+#include "delta.h"
 #include "adapt.h"
+#include "predict.h"
+#include "rans.h"
+#include "varint.h"
+#include "pfor.h"
+#include "gorilla.h"
+#include "crc32c.h"
 #include "bitfile/bitfile.h"
 
 /***************************************************************************
 *                                CONSTANTS
 ***************************************************************************/
+/* splitting frames into channels and merging them back can use SSSE3 byte
+ * shuffles, which need GCC's target attribute and CPU detection; define
+ * DELTA_NO_SIMD to build with the byte copies only */
+#if defined(__GNUC__) && !defined(DELTA_NO_SIMD) && \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define SIMD_TRANSPOSE
+#include <tmmintrin.h>
+#endif
+
+/***************************************************************************
+***************************************************************************/
+/* largest block in bytes (rounded down to a whole number of frames) */
+#define BUFFER_SIZE     4096
+
+/* bytes in an SSE register */
+#define VECTOR_SIZE     16
+
+/* most channels coded on their own; with byte planes every byte of every
+ * channel is one */
+#define MAX_PLANES      (DELTA_MAX_CHANNELS * DELTA_MAX_SAMPLE_SIZE)
+
+/* largest block payload; rANS payloads of 1 byte samples are the largest
+ * of all the backends that code blocks in memory */
+#define PAYLOAD_SIZE    RANS_MAX_PAYLOAD(BUFFER_SIZE, 8)
+
+/* stream header: magic, format version, sample size, channels, byte
+ * planes flag, 16 bit image width, signed flag, 16 bit maximum error,
+ * backend, and adaptation policy and parameters */
+#define HEADER_MAGIC    "DLTA"
+#define MAGIC_SIZE      4
+#define FORMAT_VERSION  16
+#define HEADER_FIELDS   15
+#define HEADER_SIZE     (MAGIC_SIZE + 1 + HEADER_FIELDS)
+
+/* longest run length GetRunLength accepts; runs never cross blocks */
+#define MAX_RUN_BITS    16
+
+/* what follows an escape code word (see GetEscape) */
+#define ESCAPE_RESIDUAL 0       /* a residual that didn't fit */
+#define ESCAPE_RUN      1       /* a run of 0 residuals */
+
+/* block header: predictor, starting code size, 16 bit input length, 16
+ * bit payload length, and 32 bit CRC-32C of the block's decoded bytes.  A
+ * block with no input ends the stream.  A payload never exceeds
+ * PAYLOAD_SIZE bytes, so both lengths fit.  Each block of input frames is
+ * written as a block per channel, in channel order; a cut off last frame
+ * can leave the blocks of the later channels empty without ending the
+ * stream. */
+#define BLOCK_HEADER_SIZE   10
+
+/* block header code size of a block stored as is, because coding it
+ * wouldn't make it any smaller */
+#define STORED_BLOCK        0xFF
+
+/* resynchronization point, in place of the first channel's block header:
+ * a marker the size of a block header that no block header matches, the
+ * number of input bytes before the point (64 bit little endian), the code
+ * size, 32 bit length, and saved predictor state of every channel, and a
+ * 32 bit CRC-32C of everything after the marker.  Code size adaptation
+ * starts over in every block, so decoders only need the predictors; the
+ * code size is what an encoder carrying on from the point starts the next
+ * block with.  ReadBlockHeader returns SYNC_POINT for the marker. */
+#define SYNC_POINT          1
+#define SYNC_OFFSET_SIZE    8
+#define SYNC_FIELD_SIZE     4
 
 /***************************************************************************
 *                            TYPE DEFINITIONS
 ***************************************************************************/
 typedef struct
 {
-    signed char min;
-    signed char max;
+    long min;
+    long max;
 } range_t;
 
-/***************************************************************************
-*                            GLOBAL VARIABLES
-**************************************************************************/
+/* codes of a DELTA_BACKEND_BITS block, kept in memory until the block's
+ * payload length is known.  The bits are in the order bitfile writes
+ * them. */
+typedef struct
+{
+    unsigned char *payload;     /* buffer receiving the codes */
+    size_t size;                /* bytes payload holds */
+    size_t length;              /* whole bytes coded, counting any that
+                                 * didn't fit in payload */
+    unsigned long buffer;       /* waiting bits, last bit lowest */
+    unsigned int bits;          /* bits in buffer (always fewer than 8) */
+} code_buffer_t;
+
+/* codes of a DELTA_BACKEND_BITS block read from its payload in memory,
+ * which is much cheaper than reading them a few bits at a time from the
+ * bit file */
+typedef struct
+{
+    const unsigned char *payload;   /* the block's codes */
+    size_t length;              /* bytes in payload */
+    size_t next;                /* next byte of payload to read */
+    unsigned long buffer;       /* bits read ahead, next bit highest */
+    unsigned int bits;          /* bits in buffer (always fewer than 16) */
+} code_reader_t;
+
+/* state carried between calls to the coding kernels */
+typedef struct
+{
+    adaptive_data_t *data;      /* adaptation statistics */
+    unsigned char codeSize;     /* size of next code word */
+    unsigned char sampleBits;   /* bits per sample (overflow literal size) */
+    unsigned long mask;         /* bits used by a sample */
+    int end;                    /* decoding: EOF if the data ran out,
+                                 * otherwise 0 */
+} coder_t;
+
+/* everything needed to decode a block on its own */
+typedef struct
+{
+    predictor_t predictor;      /* predictor used for the block */
+    unsigned char codeSize;     /* code size at the start of the block
+                                 * (DELTA_BACKEND_BITS only), or
+                                 * STORED_BLOCK */
+    unsigned int length;        /* bytes of input in the block */
+    unsigned int payload;       /* bytes of codes following the header */
+    unsigned long crc;          /* CRC-32C of the bytes the block decodes
+                                 * to */
+} block_header_t;
+
+/* everything a channel carries from one of its blocks to the next */
+typedef struct
+{
+    coder_t coder;              /* code size adaptation */
+    predictor_data_t *predictor;    /* prediction history */
+    block_header_t block;       /* header of the channel's last block */
+} channel_t;
+
+/* a backend that codes whole blocks in memory (NULL functions for the
+ * bits backend, which is coded by the kernels) */
+typedef struct
+{
+    const char *name;           /* name for command lines and profiles */
+    size_t (*Encode)(const long *residuals, const size_t count,
+        const unsigned char sampleBits, unsigned char *payload);
+    int (*Decode)(const unsigned char *payload, const size_t length,
+        const unsigned char sampleBits, long *residuals, const size_t count);
+} backend_t;
+
+/* a named sample type and the options that suit it */
+typedef struct
+{
+    const char *name;           /* name for command lines */
+    unsigned char sampleSize;   /* bytes per sample */
+    unsigned char isSigned;     /* non-zero for two's complement */
+    predictor_t predictor;      /* best predictor for the type */
+    delta_backend_t backend;    /* best backend for the type */
+} sample_type_t;
+
+/* coding loops for one adaptation policy (generated from deltakern.h) */
+typedef struct
+{
+    void (*Encode)(coder_t *coder, const long *residuals,
+        const size_t count, code_buffer_t *codes);
+    unsigned long (*Cost)(coder_t *coder, const long *residuals,
+        const size_t count);
+    size_t (*Decode)(coder_t *coder, code_reader_t *codes,
+        long *residuals, const size_t count);
+} kernel_t;
+
+/* everything an encoder carries between calls (see DeltaEncoderOpen) */
+struct delta_encoder_t
+{
+    FILE *outFile;              /* file receiving the stream */
+    bit_file_t *bfp;            /* outFile as a bit file */
+    delta_options_t options;    /* options the encoder was opened with */
+    delta_options_t stream;     /* options with byte planes split out */
+    channel_t channels[MAX_PLANES];
+    predictor_data_t *scratch;  /* predictor for trial predictions */
+    predictor_data_t *rebuilt;  /* predictor for rebuilding lossy blocks */
+    unsigned char *state;       /* buffer for a channel's saved state */
+    unsigned char input[BUFFER_SIZE];   /* input not encoded yet */
+    size_t buffered;            /* number of bytes in input */
+    unsigned long bytes;        /* input bytes in the stream */
+    unsigned long syncBytes;    /* input bytes between resynchronization
+                                 * points, or 0 for none */
+    unsigned long nextSync;     /* input bytes at the next point */
+    unsigned long encoded;      /* input bytes encoded since opening */
+    clock_t start;              /* processor time when opened */
+    long trailer;               /* bytes in the end block and trailer */
+    int seekable;               /* non-zero if the end of the stream can
+                                 * be rewound after a flush */
+};
 
 /***************************************************************************
 *                               PROTOTYPES
 ***************************************************************************/
 static range_t MakeRange(const unsigned char codeSize);
+static unsigned long CodeMask(const unsigned char codeSize);
+static unsigned long EscapeCode(const unsigned char codeSize);
+static size_t ZeroRun(const long *residuals, const size_t count);
+static unsigned long RunCost(const unsigned char codeSize,
+    const unsigned char sampleBits, const size_t run);
+static unsigned long OverflowCost(const unsigned char codeSize,
+    const unsigned char sampleBits, const unsigned char width);
+static void PutCodeBits(code_buffer_t *codes, unsigned long value,
+    unsigned int count);
+static size_t EndCodes(code_buffer_t *codes);
+static int GetCodeBits(code_reader_t *codes, const unsigned int count,
+    unsigned long *value);
+static void PutOverflow(code_buffer_t *codes, const long residual,
+    const unsigned char codeSize, const unsigned char sampleBits,
+    const unsigned char width);
+static int GetEscape(code_reader_t *codes, const unsigned char codeSize,
+    const unsigned char sampleBits, long *residual);
+static void PutRunLength(code_buffer_t *codes, const size_t run);
+static int GetRunLength(code_reader_t *codes, size_t *run);
+static size_t PadSamples(unsigned char *buffer, const size_t length,
+    const unsigned char sampleSize);
+static int ValidOptions(const delta_options_t *options);
+static int InitCoder(coder_t *coder, const delta_options_t *stream);
+static int InitChannels(channel_t *channels, const delta_options_t *stream);
+static void FreeChannels(channel_t *channels, const unsigned char count);
+static void UsePlanes(delta_options_t *stream);
+static size_t BlockSize(const delta_options_t *stream);
+static size_t ChannelLength(const size_t length,
+    const delta_options_t *stream, const unsigned char channel);
+static void SplitFrames(const unsigned char *frames, const size_t length,
+    const delta_options_t *stream, unsigned char *planes,
+    const size_t stride);
+static void MergeFrames(const unsigned char *planes, const size_t stride,
+    const size_t length, const delta_options_t *stream,
+    unsigned char *frames);
+static predictor_t ChoosePredictor(coder_t *coder,
+    const predictor_data_t *predictor, predictor_data_t *scratch,
+    const delta_options_t *options, const unsigned char *samples,
+    const size_t count, long *residuals);
+static unsigned char ChooseCodeSize(const coder_t *coder,
+    const long *residuals, const size_t count);
+static delta_encoder_t *CreateEncoder(FILE *outFile,
+    const delta_options_t *options);
+static void FreeEncoder(delta_encoder_t *encoder);
+static int EncodeFile(FILE *inFile, delta_encoder_t *encoder);
+static void EncodeFrames(delta_encoder_t *encoder,
+    const unsigned char *frames, const size_t length);
+static void EndStream(delta_encoder_t *encoder);
+static void PrepareBlock(coder_t *coder, predictor_data_t *predictor,
+    predictor_data_t *scratch, const delta_options_t *options,
+    const unsigned char *samples, const size_t count, const int trial,
+    block_header_t *block, long *residuals, unsigned char *payload);
+static int DecodeBlock(bit_file_t *bfp, const delta_options_t *stream,
+    const kernel_t *kernel, channel_t *channel, const block_header_t *block,
+    long *residuals, unsigned char *payload, unsigned char *plane);
+static int BelowSpeed(const clock_t start, const unsigned long bytes,
+    const unsigned int minSpeed);
+static void WriteHeader(bit_file_t *bfp, const delta_options_t *stream);
+static int ReadHeader(bit_file_t *bfp, delta_options_t *stream);
+static void WriteBlockHeader(bit_file_t *bfp, const block_header_t *block);
+static int ReadBlockHeader(bit_file_t *bfp, const delta_options_t *stream,
+    block_header_t *block);
+static void PutPayload(bit_file_t *bfp, const unsigned char *payload,
+    const size_t length);
+static int GetPayload(bit_file_t *bfp, unsigned char *payload,
+    const size_t length);
+static size_t SyncPointSize(const channel_t *channels,
+    const unsigned char count);
+static void WriteSyncPoint(bit_file_t *bfp, const channel_t *channels,
+    const unsigned char count, const unsigned long offset,
+    unsigned char *state);
+static int ReadSyncPoint(bit_file_t *bfp, channel_t *channels,
+    const unsigned char count, unsigned char *state, unsigned long *offset);
+static int FindSyncPoint(bit_file_t *bfp, channel_t *channels,
+    const unsigned char count, unsigned char *state,
+    const unsigned long written, unsigned long *offset);
+static void PutField(unsigned char *buffer, unsigned long value,
+    const size_t size);
+static int GetField(const unsigned char *buffer, const size_t size,
+    unsigned long *value);
+static int SameStream(const delta_options_t *a, const delta_options_t *b);
+static void ResetChannels(channel_t *channels, const unsigned char count);
+static int CopyBlocks(bit_file_t *in, bit_file_t *out,
+    const delta_options_t *stream, channel_t *channels, unsigned char *state,
+    const unsigned long shift, const unsigned long stop,
+    unsigned long *position);
+static void WriteTrailer(bit_file_t *bfp, const channel_t *channels,
+    const unsigned char count, const unsigned long offset,
+    unsigned char *state);
+static int ReadTrailer(bit_file_t *bfp, const delta_options_t *stream,
+    channel_t *channels, unsigned char *state, unsigned long *offset);
+
+#ifdef SIMD_TRANSPOSE
+static int UseShuffles(void);
+static void MakeGroupMask(const unsigned char channels,
+    const unsigned char sampleSize, unsigned char *mask);
+static size_t SplitVectors(const unsigned char *frames, const size_t length,
+    const unsigned char channels, const unsigned char sampleSize,
+    unsigned char *planes, const size_t stride)
+    __attribute__((target("ssse3")));
+static size_t MergeVectors(const unsigned char *planes, const size_t stride,
+    const size_t length, const unsigned char channels,
+    const unsigned char sampleSize, unsigned char *frames)
+    __attribute__((target("ssse3")));
+static void TransposeChannels(__m128i *vectors,
+    const unsigned char channels) __attribute__((target("ssse3")));
+static void TransposeVectors(__m128i *vectors, const unsigned char count,
+    size_t width) __attribute__((target("ssse3")));
+static __m128i Interleave(const __m128i a, const __m128i b,
+    const size_t width, const int high) __attribute__((target("ssse3")));
+#endif
+
+/***************************************************************************
+*                                 KERNELS
+***************************************************************************/
+#define KERNEL_SUFFIX   Threshold
+#define KERNEL_UPDATE   UpdateThreshold
+#include "deltakern.h"
+
+#define KERNEL_SUFFIX   Window
+#define KERNEL_UPDATE   UpdateWindow
+#include "deltakern.h"
+
+#define KERNEL_SUFFIX   Ema
+#define KERNEL_UPDATE   UpdateEma
+#include "deltakern.h"
+
+/***************************************************************************
+*                            GLOBAL VARIABLES
+***************************************************************************/
+/* indexed by adapt_policy_t */
+static const kernel_t kernels[ADAPT_NUM_POLICIES] =
+{
+    {EncodeThreshold, CostThreshold, DecodeThreshold},  /* ADAPT_CLASSIC */
+    {EncodeWindow, CostWindow, DecodeWindow},           /* ADAPT_WINDOW */
+    {EncodeThreshold, CostThreshold, DecodeThreshold},  /* ADAPT_THRESHOLD */
+    {EncodeEma, CostEma, DecodeEma}                     /* ADAPT_EMA */
+};
+
+/* indexed by delta_backend_t */
+static const backend_t backends[DELTA_NUM_BACKENDS] =
+{
+    {"bits", NULL, NULL},                               /* BITS */
+    {"rans", RansEncode, RansDecode},                   /* RANS */
+    {"varint", VarintEncode, VarintDecode},             /* VARINT */
+    {"pfor", PforEncode, PforDecode},                   /* PFOR */
+    {"gorilla", GorillaEncode, GorillaDecode}           /* GORILLA */
+};
+
+/* header of a block with no input; in the first channel's place it ends
+ * the stream */
+static const block_header_t emptyBlock = {PREDICT_PREVIOUS, 0, 0, 0, 0};
+
+/* predictor 0xFE isn't valid, so no block header starts like this */
+static const unsigned char syncMarker[BLOCK_HEADER_SIZE] =
+    {0xFE, 'D', 'L', 'T', 'A', 'S', 'Y', 'N', 'C', 0xFE};
+
+/* integers keep the predictor and backend they have; IEEE 754 floating
+ * point values are XORed with the last one and coded Gorilla style, and
+ * timestamps are predicted from their period and coded in frames, which
+ * shrink to nothing for exactly periodic stretches */
+static const sample_type_t sampleTypes[] =
+{
+    {"int8", 1, 1, PREDICT_NUM_PREDICTORS, DELTA_NUM_BACKENDS},
+    {"int16", 2, 1, PREDICT_NUM_PREDICTORS, DELTA_NUM_BACKENDS},
+    {"int32", 4, 1, PREDICT_NUM_PREDICTORS, DELTA_NUM_BACKENDS},
+    {"int64", 8, 1, PREDICT_NUM_PREDICTORS, DELTA_NUM_BACKENDS},
+    {"uint8", 1, 0, PREDICT_NUM_PREDICTORS, DELTA_NUM_BACKENDS},
+    {"uint16", 2, 0, PREDICT_NUM_PREDICTORS, DELTA_NUM_BACKENDS},
+    {"uint32", 4, 0, PREDICT_NUM_PREDICTORS, DELTA_NUM_BACKENDS},
+    {"uint64", 8, 0, PREDICT_NUM_PREDICTORS, DELTA_NUM_BACKENDS},
+    {"float", 4, 1, PREDICT_XOR, DELTA_BACKEND_GORILLA},
+    {"double", 8, 1, PREDICT_XOR, DELTA_BACKEND_GORILLA},
+    {"time32", 4, 0, PREDICT_PERIOD, DELTA_BACKEND_PFOR},
+    {"time64", 8, 0, PREDICT_PERIOD, DELTA_BACKEND_PFOR},
+    {NULL, 0, 0, PREDICT_NUM_PREDICTORS, DELTA_NUM_BACKENDS}
+};
+
+#ifdef SIMD_TRANSPOSE
+static int shuffleReady = 0;
+static int haveShuffles = 0;    /* non-zero if SSSE3 shuffles are used */
+#endif
 
 /***************************************************************************
 *                                FUNCTIONS
 ***************************************************************************/
 
+/***************************************************************************
+*   Function   : DeltaDefaultOptions
+*   Description: This function fills in an options structure with the
+*                default encoding options.
+*   Parameters : options - Pointer to the options structure to fill in.
+*   Effects    : options is set to the defaults.
+*   Returned   : None
+***************************************************************************/
+void DeltaDefaultOptions(delta_options_t *options)
+{
+    options->codeSize = DELTA_DEFAULT_SIZE;
+    options->sampleSize = 1;
+    options->predictor = PREDICT_PREVIOUS;
+    options->minSpeed = 0;
+    options->backend = DELTA_BACKEND_BITS;
+    options->channels = 1;
+    options->planes = 0;
+    options->width = 0;
+    options->maxError = 0;
+    options->isSigned = 0;
+    options->syncInterval = 0;
+    DefaultAdaptiveParams(&(options->adapt), ADAPT_CLASSIC);
+}
+
 /***************************************************************************
 *   Function   : DeltaEncodeFile
 *   Description: This function reads from the specified input stream and
 *                writes an adaptive delta encoded version to the specified
-*                output stream.  If input/output streams are NULL, this
-*                function exits with a failure.
+*                output stream using the default options and the specified
+*                starting code size.
 *   Parameters : inFile - Pointer to a file stream to be encoded.
 *                outFile - Pointer to a file where the encoded output should
 *                          be written.
 *                codeSize - The number of bits used for code words at the
-*                           start of coding.
+*                           start of coding, or DELTA_AUTO_SIZE to pick a
+*                           size by sampling the start of the input.
 *   Effects    : Data from the inFile stream will be encoded and written to
 *                the outFile stream.
 *   Returned   : 0 for success, -1 for failure.  errno will be set in the
@@ -81,17 +475,43 @@ static range_t MakeRange(const unsigned char codeSize);
 ***************************************************************************/
 int DeltaEncodeFile(FILE *inFile, FILE *outFile, unsigned char codeSize)
 {
-    bit_file_t *bOutFile;
-    int c;
-    unsigned char buffer;
-    signed char prev, delta;
-    range_t range;
-    adaptive_data_t *data;
+    delta_options_t options;
+
+    DeltaDefaultOptions(&options);
+    options.codeSize = codeSize;
+    return DeltaEncodeFileOpt(inFile, outFile, &options);
+}
+
+/***************************************************************************
+*   Function   : DeltaEncodeFileOpt
+*   Description: This function reads from the specified input stream and
+*                writes an adaptive delta encoded version to the specified
+*                output stream.  If input/output streams are NULL, this
+*                function exits with a failure.
+*   Parameters : inFile - Pointer to a file stream to be encoded.
+*                outFile - Pointer to a file where the encoded output should
+*                          be written.
+*                options - Pointer to the encoding options.
+*   Effects    : Data from the inFile stream will be encoded and written to
+*                the outFile stream.  The options needed for decoding are
+*                written to a header at the start of the stream and to a
+*                header at the start of every block.  With a sync interval,
+*                a resynchronization point is written before the first
+*                block of frames at or past each interval.  The stream ends
+*                with a trailer holding the encoder's final state, so that
+*                DeltaEncodeAppend can add to it.  The files aren't closed,
+*                even on failure.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+int DeltaEncodeFileOpt(FILE *inFile, FILE *outFile,
+    const delta_options_t *options)
+{
+    delta_encoder_t *encoder;
 
     /* verify parameters */
-    if ((codeSize < 2) || (codeSize > 8))
+    if (!ValidOptions(options))
     {
-        /* code size is out of range */
         errno = EINVAL;
         return -1;
     }
@@ -108,88 +528,350 @@ int DeltaEncodeFile(FILE *inFile, FILE *outFile, unsigned char codeSize)
         return -1;
     }
 
-    bOutFile = MakeBitFile(outFile, BF_WRITE);
+    if (NULL == (encoder = DeltaEncoderOpen(outFile, options)))
+    {
+        /* the caller's files are left for the caller to close */
+        return -1;
+    }
 
-    if (NULL == bOutFile)
+    return EncodeFile(inFile, encoder);
+}
+
+/***************************************************************************
+*   Function   : DeltaEncodeAppend
+*   Description: This function reads from the specified input stream and
+*                adds an adaptive delta encoded version of it to the end of
+*                an existing encoded stream, without decoding the existing
+*                stream.
+*   Parameters : inFile - Pointer to a file stream to be encoded.
+*                outFile - Pointer to the encoded file stream to add to.  It
+*                          must be opened for reading and writing ("r+b").
+*                options - Pointer to the encoding options.  The settings
+*                          kept in the stream header must match the
+*                          existing stream's.
+*   Effects    : The trailer of the outFile stream is replaced by the
+*                encoded inFile stream, followed by a new end block and
+*                trailer.  The files aren't closed.  On failure outFile may
+*                be left holding part of a stream.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure (see DeltaEncoderOpenAppend).
+***************************************************************************/
+int DeltaEncodeAppend(FILE *inFile, FILE *outFile,
+    const delta_options_t *options)
+{
+    delta_encoder_t *encoder;
+
+    if (NULL == inFile)
+    {
+        errno = ENOENT;
+        return -1;
+    }
+
+    if (NULL == (encoder = DeltaEncoderOpenAppend(outFile, options)))
     {
-        perror("Making Output File a BitFile");
-        fclose(outFile);
-        fclose(inFile);
         return -1;
     }
 
-    /* get first value */
-    if ((c = fgetc(inFile)) != EOF)
+    return EncodeFile(inFile, encoder);
+}
+
+/***************************************************************************
+*   Function   : DeltaEncoderOpen
+*   Description: This function starts an encoded stream that's fed input
+*                as it arrives, instead of reading it from a file.
+*   Parameters : outFile - Pointer to a file where the encoded output should
+*                          be written.
+*                options - Pointer to the encoding options.
+*   Effects    : The stream header is written to outFile.
+*   Returned   : Pointer to the encoder, to be passed to DeltaEncoderWrite,
+*                DeltaEncoderFlush, and DeltaEncoderClose, or NULL for
+*                failure.  errno will be set in the event of a failure.
+***************************************************************************/
+delta_encoder_t *DeltaEncoderOpen(FILE *outFile,
+    const delta_options_t *options)
+{
+    delta_encoder_t *encoder;
+
+    /* verify parameters */
+    if (!ValidOptions(options))
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (NULL == outFile)
+    {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    if (NULL == (encoder = CreateEncoder(outFile, options)))
+    {
+        return NULL;
+    }
+
+    if (NULL == (encoder->bfp = MakeBitFile(outFile, BF_WRITE)))
+    {
+        FreeEncoder(encoder);
+        return NULL;
+    }
+
+    WriteHeader(encoder->bfp, options);
+    return encoder;
+}
+
+/***************************************************************************
+*   Function   : DeltaEncoderOpenAppend
+*   Description: This function opens an existing encoded stream to be fed
+*                more input.  The stream's trailer holds the state its
+*                encoder finished in, so encoding carries on from there
+*                without decoding the stream.
+*   Parameters : outFile - Pointer to the encoded file stream to add to.  It
+*                          must be opened for reading and writing ("r+b").
+*                options - Pointer to the encoding options.  The settings
+*                          kept in the stream header must match the
+*                          existing stream's.
+*   Effects    : The header and trailer of the outFile stream are read, and
+*                outFile is positioned to overwrite the end of the stream.
+*   Returned   : Pointer to the encoder, or NULL for failure.  errno will be
+*                set in the event of a failure; it's EINVAL if the options
+*                don't match the existing stream or it ends part way
+*                through a frame, and EILSEQ if it isn't a valid stream.
+***************************************************************************/
+delta_encoder_t *DeltaEncoderOpenAppend(FILE *outFile,
+    const delta_options_t *options)
+{
+    delta_encoder_t *encoder;
+    bit_file_t *bfp;
+    unsigned long offset, interval;
+    int result;
+    delta_options_t existing;
+    block_header_t block;
+
+    /* verify parameters */
+    if (!ValidOptions(options))
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (NULL == outFile)
+    {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    if (NULL == (encoder = CreateEncoder(outFile, options)))
     {
-        /* initialize program data */
-        if (NULL == (data = CreateAdaptiveData(codeSize)))
+        return NULL;
+    }
+
+    result = -1;
+    errno = EILSEQ;
+    rewind(outFile);
+
+    if (NULL == (bfp = MakeBitFile(outFile, BF_READ)))
+    {
+        /* nothing to do but clean up */
+    }
+    else if (0 != ReadHeader(bfp, &existing))
+    {
+        BitFileToFILE(bfp);
+    }
+    else if (!SameStream(options, &existing))
+    {
+        BitFileToFILE(bfp);
+        errno = EINVAL;
+    }
+    else if ((NULL == BitFileToFILE(bfp)) ||
+        (0 != fseek(outFile, -encoder->trailer, SEEK_END)) ||
+        (ftell(outFile) < HEADER_SIZE) ||
+        (NULL == (bfp = MakeBitFile(outFile, BF_READ))))
+    {
+        /* too short to hold a trailer */
+    }
+    else
+    {
+        if ((0 == ReadBlockHeader(bfp, &(encoder->stream), &block)) &&
+            (0 == block.length) &&
+            (0 == ReadTrailer(bfp, &(encoder->stream), encoder->channels,
+            encoder->state, &offset)) &&
+            (EOF == BitFileGetChar(bfp)))
         {
-            perror("Creating Data Structures");
-            fclose(outFile);
-            fclose(inFile);
-            return -1;
+            result = 0;
         }
 
-        range = MakeRange(codeSize);
-        BitFilePutChar(c, bOutFile);
-        prev = c;
+        BitFileToFILE(bfp);
     }
-    else
+
+    if ((0 == result) &&
+        (0 != offset % ((unsigned long)options->channels *
+        options->sampleSize)))
     {
-        /* empty input file */
-        fclose(inFile);
-        BitFileClose(bOutFile);
-        return 0;
+        /* the cut off frame's samples were padded and can't be finished */
+        errno = EINVAL;
+        result = -1;
+    }
+
+    /* switching from reading to writing takes a seek */
+    if ((0 != result) ||
+        (0 != fseek(outFile, -encoder->trailer, SEEK_END)) ||
+        (NULL == (encoder->bfp = MakeBitFile(outFile, BF_WRITE))))
+    {
+        FreeEncoder(encoder);
+        return NULL;
     }
 
-    while ((c = fgetc(inFile)) != EOF)
+    encoder->bytes = offset;
+
+    if (0 != encoder->syncBytes)
     {
-        if (EOF == c)
+        /* points fall every interval rounded up to whole blocks, so the
+         * next one goes where encoding everything at once would put it */
+        interval = BlockSize(&(encoder->stream));
+        interval *= (encoder->syncBytes + interval - 1) / interval;
+        encoder->nextSync = ((offset + interval - 1) / interval) * interval;
+
+        if (0 == encoder->nextSync)
         {
-            break;
+            encoder->nextSync = encoder->syncBytes;
         }
+    }
+
+    return encoder;
+}
+
+/***************************************************************************
+*   Function   : DeltaEncoderWrite
+*   Description: This function feeds input to an encoder.  Input is coded
+*                a block of frames at a time, so some of it may be held
+*                until there's a whole block or the encoder is flushed.
+*   Parameters : encoder - Pointer to the encoder.
+*                buffer - The input bytes.
+*                length - The number of bytes in buffer.
+*   Effects    : Every whole block of input is encoded and written to the
+*                encoder's file.  The rest is kept by the encoder.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+int DeltaEncoderWrite(delta_encoder_t *encoder, const unsigned char *buffer,
+    size_t length)
+{
+    size_t size, block;
+
+    if ((NULL == encoder) || ((NULL == buffer) && (0 != length)))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    block = BlockSize(&(encoder->stream));
 
-        delta = (signed char)c - prev;
-        prev = c;
+    while (0 != length)
+    {
+        size = block - encoder->buffered;
+        size = (size > length) ? length : size;
+        memcpy(encoder->input + encoder->buffered, buffer, size);
+        encoder->buffered += size;
+        buffer += size;
+        length -= size;
 
-        if ((delta > range.max) || (delta <= range.min))
+        if (block == encoder->buffered)
         {
-            /* overflow write min (right justified) followed by the character */
-            buffer = (unsigned char)range.min << (8 - codeSize);
-            BitFilePutBits(bOutFile, &buffer, codeSize);
-            BitFilePutChar(c, bOutFile);
-            codeSize = UpdateAdaptiveStatistics(data, CS_OVERFLOW);
+            EncodeFrames(encoder, encoder->input, block);
+            encoder->buffered = 0;
         }
-        else
-        {
-            /* not an overflow.  right justify and output. */
-            buffer = (unsigned char)delta << (8 - codeSize);
-            BitFilePutBits(bOutFile, &buffer, codeSize);
+    }
 
-            /* check for underflow */
-            if ((delta <= (range.max / 2)) && (delta > (range.min / 2)))
-            {
-                /* underflow */
-                codeSize = UpdateAdaptiveStatistics(data, CS_UNDERFLOW);
-            }
-            else
-            {
-                codeSize = UpdateAdaptiveStatistics(data, CS_OKAY);
-            }
+    return ferror(encoder->outFile) ? -1 : 0;
+}
+
+/***************************************************************************
+*   Function   : DeltaEncoderFlush
+*   Description: This function encodes all the whole frames an encoder is
+*                holding and pushes them out to its file, so that a decoder
+*                reading the file sees every frame fed in so far.
+*   Parameters : encoder - Pointer to the encoder.
+*   Effects    : The whole frames held by the encoder are encoded as a
+*                short block and the encoder's file is flushed.  If the
+*                file can seek, the stream is also ended and the end
+*                rewound, so the file is a complete stream (that can be
+*                decoded or added to) until more is written.  Part of a
+*                frame is kept until the rest arrives.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+int DeltaEncoderFlush(delta_encoder_t *encoder)
+{
+    size_t whole;
+
+    if (NULL == encoder)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    whole = encoder->buffered - encoder->buffered %
+        ((size_t)encoder->stream.channels * encoder->stream.sampleSize);
+
+    if (0 != whole)
+    {
+        EncodeFrames(encoder, encoder->input, whole);
+        encoder->buffered -= whole;
+        memmove(encoder->input, encoder->input + whole, encoder->buffered);
+    }
+
+    /* blocks are byte aligned, so this only resets the bit buffer */
+    BitFileFlushOutput(encoder->bfp, 0);
+
+    if (encoder->seekable)
+    {
+        EndStream(encoder);
+
+        if ((0 != fflush(encoder->outFile)) ||
+            (0 != fseek(encoder->outFile, -encoder->trailer, SEEK_CUR)))
+        {
+            return -1;
         }
+    }
+
+    return ((0 != fflush(encoder->outFile)) || ferror(encoder->outFile)) ?
+        -1 : 0;
+}
+
+/***************************************************************************
+*   Function   : DeltaEncoderClose
+*   Description: This function encodes whatever input an encoder is still
+*                holding, ends its stream, and frees the encoder.
+*   Parameters : encoder - Pointer to the encoder.
+*   Effects    : The rest of the stream is written to the encoder's file and
+*                the encoder is freed.  The file isn't closed.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+int DeltaEncoderClose(delta_encoder_t *encoder)
+{
+    FILE *outFile;
+    int result;
 
-        /* update range in case of code size change */
-        range = MakeRange(codeSize);
+    if (NULL == encoder)
+    {
+        errno = EINVAL;
+        return -1;
     }
 
-    /* indicate end of stream with an overflow and previous value (EOF) */
-    buffer = (unsigned char)range.min << (8 - codeSize);
-    BitFilePutBits(bOutFile, &buffer, codeSize);
-    BitFilePutChar(prev, bOutFile);
+    if (0 != encoder->buffered)
+    {
+        /* this may end with a cut off frame */
+        EncodeFrames(encoder, encoder->input, encoder->buffered);
+    }
 
-    outFile = BitFileToFILE(bOutFile);          /* make file normal again */
-    FreeAdaptiveData(data);
-    return 0;
+    EndStream(encoder);
+    outFile = BitFileToFILE(encoder->bfp);      /* make file normal again */
+    encoder->bfp = NULL;
+    result = ((0 != fflush(outFile)) || ferror(outFile)) ? -1 : 0;
+    FreeEncoder(encoder);
+    return result;
 }
 
 /***************************************************************************
@@ -202,30 +884,64 @@ int DeltaEncodeFile(FILE *inFile, FILE *outFile, unsigned char codeSize)
 *                         to be encoded.
 *                outFile - Pointer to a file where the decoded output should
 *                          be written.
-*                codeSize - The number of bits used for code words at the
-*                           start of coding.
 *   Effects    : Data from the inFile stream will be decoded and written to
-*                the outFile stream.
+*                the outFile stream.  The sample size, channels, and
+*                adaptation policy are read from the stream header, and the
+*                predictor and starting code size are read from each block
+*                header.
 *   Returned   : 0 for success, -1 for failure.  errno will be set in the
 *                event of a failure.
 ***************************************************************************/
-int DeltaDecodeFile(FILE *inFile, FILE *outFile, unsigned char codeSize)
+int DeltaDecodeFile(FILE *inFile, FILE *outFile)
+{
+    return DeltaDecodeFileOpt(inFile, outFile, 0);
+}
+
+/***************************************************************************
+*   Function   : DeltaDecodeFileOpt
+*   Description: This function decodes an adaptive delta encoded input
+*                stream like DeltaDecodeFile, checking every block against
+*                the CRC-32C in its header unless told not to.
+*   Parameters : inFile - Pointer to the adaptive delta encoded file stream
+*                         to be decoded.
+*                outFile - Pointer to a file where the decoded output should
+*                          be written.
+*                flags - DELTA_DECODE_NO_VERIFY to skip the CRC checks,
+*                        DELTA_DECODE_RESYNC to carry on past damage, both,
+*                        or 0.
+*   Effects    : Data from the inFile stream will be decoded and written to
+*                the outFile stream.  Decoding stops before the first block
+*                of frames with a block that fails its check, so nothing
+*                from a corrupt block is written.  With DELTA_DECODE_RESYNC
+*                it starts again from the next resynchronization point
+*                instead, and the bytes that were lost are written as 0s,
+*                so everything after them is where it belongs.  The files
+*                aren't closed, even on failure.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure; it's EILSEQ for a corrupt stream, even
+*                if decoding carried on past the damage.
+***************************************************************************/
+int DeltaDecodeFileOpt(FILE *inFile, FILE *outFile,
+    const unsigned int flags)
 {
     bit_file_t *bInFile;
-    int c;
-    unsigned char buffer;
-    signed char prev, delta;
-    range_t range;
-    adaptive_data_t *data;
+    unsigned char c;
+    unsigned char outBuffer[BUFFER_SIZE];
+    unsigned char planes[BUFFER_SIZE];
+    long residuals[BUFFER_SIZE];
+    unsigned char payload[PAYLOAD_SIZE];
+    unsigned char *state;
+    unsigned int lengths[MAX_PLANES];
+    size_t length, planeSize;
+    unsigned long written, offset;
+    long start;
+    int result, damaged;
+    delta_options_t stream;
+    block_header_t block;
+    channel_t channels[MAX_PLANES];
+    const kernel_t *kernel;
 
     /* verify parameters */
-    if ((codeSize < 2) || (codeSize > 8))
-    {
-        /* code size is out of range */
-        errno = EINVAL;
-        return -1;
-    }
-
     if (NULL == inFile)
     {
         errno = ENOENT;
@@ -238,112 +954,2981 @@ int DeltaDecodeFile(FILE *inFile, FILE *outFile, unsigned char codeSize)
         return -1;
     }
 
-    bInFile = MakeBitFile(inFile, BF_WRITE);
+    bInFile = MakeBitFile(inFile, BF_READ);
 
     if (NULL == bInFile)
     {
-        perror("Making Input File a BitFile");
-        fclose(outFile);
-        fclose(inFile);
+        /* the caller's files are left for the caller to close */
         return -1;
     }
 
-    /* get first value */
-    if ((c = BitFileGetChar(bInFile)) != EOF)
+    if (0 != ReadHeader(bInFile, &stream))
     {
-        /* initialize program data */
-        if (NULL == (data = CreateAdaptiveData(codeSize)))
-        {
-            perror("Creating Data Structures");
-            fclose(outFile);
-            fclose(inFile);
-            return -1;
-        }
-
-        range = MakeRange(codeSize);
-        fputc(c, outFile);
-        prev = (signed char)c;
+        /* not a stream we know how to decode */
+        inFile = BitFileToFILE(bInFile);
+        errno = EILSEQ;
+        return -1;
     }
-    else
+
+    /* initialize program data */
+    UsePlanes(&stream);
+
+    if (0 != InitChannels(channels, &stream))
     {
-        /* empty input file */
-        BitFileClose(bInFile);
-        fclose(outFile);
-        return 0;
+        inFile = BitFileToFILE(bInFile);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (NULL == (state = malloc(PredictorStateSize(channels[0].predictor))))
+    {
+        inFile = BitFileToFILE(bInFile);
+        FreeChannels(channels, stream.channels);
+        errno = ENOMEM;
+        return -1;
     }
 
-    while (BitFileGetBits(bInFile, &buffer, codeSize) != EOF)
+    kernel = &kernels[stream.adapt.policy];
+
+    /* each channel is decoded into its own part of planes */
+    planeSize = ChannelLength(BlockSize(&stream), &stream, 0);
+    written = 0;
+    damaged = 0;
+
+    for (;;)
     {
-        /* right justify buffer */
-        if (buffer & 0x80)
+        /* blocks end byte aligned, so this is where the block starts */
+        start = ftell(inFile);
+        result = ReadBlockHeader(bInFile, &stream, &block);
+        length = 0;
+
+        if (SYNC_POINT == result)
         {
-            /* buffer is negative */
-            buffer >>= (8 - codeSize);
-            buffer |= 0xFF << (codeSize);
+            /* in a stream as it was encoded, this is the state the
+             * decoder is already in; joined streams start over here */
+            if ((0 == ReadSyncPoint(bInFile, channels, stream.channels,
+                state, &offset)) && (offset == written))
+            {
+                continue;
+            }
+
+            result = -1;
         }
-        else
+        else if ((0 == result) && (0 == block.length))
         {
-            /* buffer is possitive */
-            buffer >>= (8 - codeSize);
+            /* a block without any input ends the stream */
+            break;
         }
 
-        if ((signed char)buffer == range.min)
+        for (c = 0; (0 == result) && (c < stream.channels); c++)
         {
-            /* overflow character */
-            c = BitFileGetChar(bInFile);
+            if ((0 != c) &&
+                (0 != ReadBlockHeader(bInFile, &stream, &block)))
+            {
+                result = -1;
+                break;
+            }
+
+            lengths[c] = block.length;
+            length += block.length;
+
+            if (0 == block.length)
+            {
+                continue;
+            }
 
-            if ((EOF == c) || (prev == c))
+            if (0 != DecodeBlock(bInFile, &stream, kernel, &channels[c],
+                &block, residuals, payload, planes + c * planeSize))
             {
-                /* overflow without change signals EOF as does real EOF */
+                result = -1;
                 break;
             }
 
-            fputc(c, outFile);
-            prev = (signed char)c;
-            codeSize = UpdateAdaptiveStatistics(data, CS_OVERFLOW);
+            if (!(flags & DELTA_DECODE_NO_VERIFY) &&
+                (Crc32c(0, planes + c * planeSize, block.length) !=
+                block.crc))
+            {
+                result = -1;
+                break;
+            }
         }
-        else
+
+        /* the channels must split whole frames the way the encoder does */
+        for (c = 0; (0 == result) && (c < stream.channels); c++)
+        {
+            if (lengths[c] != ChannelLength(length, &stream, c))
+            {
+                result = -1;
+            }
+        }
+
+        if (0 != result)
         {
-            /* not an overflow */
-            delta = (signed char)buffer;
-            prev = prev + delta;
-            fputc(prev, outFile);
+            if (flags & DELTA_DECODE_RESYNC)
+            {
+                /* a damaged length may have sent the reads past the next
+                 * point, so look again from just after the block's start.
+                 * Streams that can't seek are searched from here. */
+                BitFileByteAlign(bInFile);
 
-            /* check for underflow */
-            if ((delta <= (range.max / 2)) && (delta > (range.min / 2)))
+                if (-1L != start)
+                {
+                    fseek(inFile, start + 1, SEEK_SET);
+                }
+            }
+
+            if (!(flags & DELTA_DECODE_RESYNC) ||
+                (0 != FindSyncPoint(bInFile, channels, stream.channels,
+                state, written, &offset)))
             {
-                codeSize = UpdateAdaptiveStatistics(data, CS_UNDERFLOW);
+                break;
             }
-            else
+
+            /* fill in what was lost so later samples keep their place */
+            damaged = 1;
+            result = 0;
+
+            for (; written < offset; written++)
             {
-                codeSize = UpdateAdaptiveStatistics(data, CS_OKAY);
+                fputc(0, outFile);
             }
+
+            continue;
         }
 
-        /* update range in case of code size change */
-        range = MakeRange(codeSize);
+        MergeFrames(planes, planeSize, length, &stream, outBuffer);
+        fwrite(outBuffer, sizeof(unsigned char), length, outFile);
+        written += length;
     }
 
     inFile = BitFileToFILE(bInFile);            /* make file normal again */
-    FreeAdaptiveData(data);
+    FreeChannels(channels, stream.channels);
+    free(state);
+
+    if ((0 != result) || damaged)
+    {
+        errno = EILSEQ;
+        return -1;
+    }
+
     return 0;
 }
 
 /***************************************************************************
-*   Function   : MakeRange
-*   Description: This function computes the minimum and maximum range
-*                limits for a codeSize bit delta encoded symbol.
-*   Parameters : codeSize - The number of bits used for code words at the
-*                           start of coding.
+*   Function   : DeltaConcatFiles
+*   Description: This function joins encoded streams into one stream that
+*                decodes to their decoded contents, one after the other,
+*                without decoding them.  Blocks are copied as they are; a
+*                resynchronization point holding the starting state is
+*                put in front of every stream after the first, and the
+*                offsets in the streams' own points are moved along.
+*   Parameters : inFiles - Array of pointers to the encoded file streams to
+*                          join, in order.  Every stream must have the same
+*                          stream header settings.
+*                count - The number of streams in inFiles.
+*                outFile - Pointer to a file where the joined stream should
+*                          be written.
+*   Effects    : The inFiles streams are read and the joined stream is
+*                written to outFile.  The files aren't closed.  On failure
+*                outFile is left holding part of a stream.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure; it's EINVAL if the streams' settings
+*                don't match and EILSEQ if one isn't a valid stream.
+***************************************************************************/
+int DeltaConcatFiles(FILE *const *inFiles, const unsigned int count,
+    FILE *outFile)
+{
+    bit_file_t *bInFile, *bOutFile;
+    unsigned char *state;
+    unsigned long total, position, offset;
+    unsigned int i;
+    int result;
+    delta_options_t first, stream, layout;
+    channel_t channels[MAX_PLANES];
+
+    /* verify parameters */
+    if ((NULL == inFiles) || (0 == count))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (NULL == inFiles[i])
+        {
+            errno = ENOENT;
+            return -1;
+        }
+    }
+
+    if (NULL == outFile)
+    {
+        errno = ENOENT;
+        return -1;
+    }
+
+    bOutFile = MakeBitFile(outFile, BF_WRITE);
+
+    if (NULL == bOutFile)
+    {
+        return -1;
+    }
+
+    state = NULL;
+    total = 0;
+    result = 0;
+
+    for (i = 0; (0 == result) && (i < count); i++)
+    {
+        if (NULL == (bInFile = MakeBitFile(inFiles[i], BF_READ)))
+        {
+            result = -1;
+            break;
+        }
+
+        if (0 != ReadHeader(bInFile, &stream))
+        {
+            errno = EILSEQ;
+            result = -1;
+        }
+        else if (0 == i)
+        {
+            first = stream;
+            layout = stream;
+            UsePlanes(&layout);
+            WriteHeader(bOutFile, &first);
+
+            if (0 != InitChannels(channels, &layout))
+            {
+                errno = ENOMEM;
+                result = -1;
+            }
+            else if (NULL == (state =
+                malloc(PredictorStateSize(channels[0].predictor))))
+            {
+                FreeChannels(channels, layout.channels);
+                errno = ENOMEM;
+                result = -1;
+            }
+        }
+        else if (!SameStream(&first, &stream))
+        {
+            errno = EINVAL;
+            result = -1;
+        }
+        else
+        {
+            /* the stream was encoded from the starting state */
+            ResetChannels(channels, layout.channels);
+            WriteSyncPoint(bOutFile, channels, layout.channels, total,
+                state);
+        }
+
+        if (0 == result)
+        {
+            position = 0;
+
+            /* the last stream's trailer is the joined stream's */
+            if ((0 != CopyBlocks(bInFile, bOutFile, &layout, channels,
+                state, total, ULONG_MAX, &position)) ||
+                (0 != ReadTrailer(bInFile, &layout, channels, state,
+                &offset)) || (offset != position))
+            {
+                errno = EILSEQ;
+                result = -1;
+            }
+
+            total += position;
+        }
+
+        BitFileToFILE(bInFile);
+    }
+
+    if (0 == result)
+    {
+        /* a block without any input ends the stream */
+        WriteBlockHeader(bOutFile, &emptyBlock);
+        WriteTrailer(bOutFile, channels, layout.channels, total, state);
+    }
+
+    if (NULL != state)
+    {
+        FreeChannels(channels, layout.channels);
+        free(state);
+    }
+
+    outFile = BitFileToFILE(bOutFile);          /* make file normal again */
+    return result;
+}
+
+/***************************************************************************
+*   Function   : DeltaSplitFile
+*   Description: This function splits an encoded stream in two at a
+*                resynchronization point, without decoding it.  Blocks
+*                are copied as they are.  The second stream starts with
+*                the point, and the offsets in it and the points after it
+*                are moved back to the start of the stream.
+*   Parameters : inFile - Pointer to the encoded file stream to split.
+*                headFile - Pointer to a file where the stream before the
+*                           split should be written.
+*                tailFile - Pointer to a file where the stream from the
+*                           split on should be written.
+*                offset - Pointer to the number of decoded bytes to split
+*                         after.  The stream is split at the first point at
+*                         or past it.
+*   Effects    : inFile is read and the two streams are written to headFile
+*                and tailFile.  *offset is set to the number of decoded
+*                bytes in headFile's stream.  The files aren't closed.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure; it's ERANGE if no point is at or past
+*                *offset and EILSEQ for a corrupt stream.
+***************************************************************************/
+int DeltaSplitFile(FILE *inFile, FILE *headFile, FILE *tailFile,
+    unsigned long *offset)
+{
+    bit_file_t *bInFile, *bHeadFile, *bTailFile;
+    unsigned char *state;
+    unsigned long position, split, trailer;
+    int result, error;
+    delta_options_t stream;
+    channel_t channels[MAX_PLANES];
+
+    /* verify parameters */
+    if ((NULL == inFile) || (NULL == headFile) || (NULL == tailFile))
+    {
+        errno = ENOENT;
+        return -1;
+    }
+
+    if (NULL == offset)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    bInFile = MakeBitFile(inFile, BF_READ);
+    bHeadFile = MakeBitFile(headFile, BF_WRITE);
+    bTailFile = MakeBitFile(tailFile, BF_WRITE);
+    state = NULL;
+    result = -1;
+
+    if ((NULL == bInFile) || (NULL == bHeadFile) || (NULL == bTailFile))
+    {
+        /* nothing to do but clean up */
+    }
+    else if (0 != ReadHeader(bInFile, &stream))
+    {
+        errno = EILSEQ;
+    }
+    else
+    {
+        WriteHeader(bHeadFile, &stream);
+        WriteHeader(bTailFile, &stream);
+        UsePlanes(&stream);
+
+        if (0 != InitChannels(channels, &stream))
+        {
+            errno = ENOMEM;
+        }
+        else if (NULL == (state =
+            malloc(PredictorStateSize(channels[0].predictor))))
+        {
+            FreeChannels(channels, stream.channels);
+            errno = ENOMEM;
+        }
+        else
+        {
+            position = 0;
+            error = EILSEQ;
+            result = CopyBlocks(bInFile, bHeadFile, &stream, channels, state,
+                0, *offset, &position);
+            split = position;
+
+            if (SYNC_POINT == result)
+            {
+                /* the point CopyBlocks stopped at ends the head and starts
+                 * the tail */
+                WriteBlockHeader(bHeadFile, &emptyBlock);
+                WriteTrailer(bHeadFile, channels, stream.channels, split,
+                    state);
+                WriteSyncPoint(bTailFile, channels, stream.channels, 0,
+                    state);
+                result = CopyBlocks(bInFile, bTailFile, &stream, channels,
+                    state, 0 - split, ULONG_MAX, &position);
+
+                if ((0 == result) && ((0 != ReadTrailer(bInFile, &stream,
+                    channels, state, &trailer)) || (trailer != position)))
+                {
+                    result = -1;
+                }
+            }
+            else if (0 == result)
+            {
+                /* the stream ended without a point far enough to split at */
+                if ((0 == ReadTrailer(bInFile, &stream, channels, state,
+                    &trailer)) && (trailer == position))
+                {
+                    error = ERANGE;
+                }
+
+                result = -1;
+            }
+
+            if (0 == result)
+            {
+                WriteBlockHeader(bTailFile, &emptyBlock);
+                WriteTrailer(bTailFile, channels, stream.channels,
+                    position - split, state);
+                *offset = split;
+            }
+            else
+            {
+                errno = error;
+            }
+
+            FreeChannels(channels, stream.channels);
+            free(state);
+        }
+    }
+
+    if (NULL != bInFile)
+    {
+        inFile = BitFileToFILE(bInFile);
+    }
+
+    if (NULL != bHeadFile)
+    {
+        headFile = BitFileToFILE(bHeadFile);
+    }
+
+    if (NULL != bTailFile)
+    {
+        tailFile = BitFileToFILE(bTailFile);
+    }
+
+    return (0 == result) ? 0 : -1;
+}
+
+/***************************************************************************
+*   Function   : DeltaCostBuffer
+*   Description: This function computes the size of the stream that
+*                DeltaEncodeFileOpt would write for a buffer of data,
+*                without writing anything.  It's intended for tuning
+*                encoding options against sample data.
+*   Parameters : buffer - The data to be costed.
+*                length - The number of bytes in buffer.
+*                options - Pointer to the encoding options.  minSpeed is
+*                          ignored; every block is costed as if it were
+*                          met.
 *   Effects    : None
-*   Returned   : Range minimum and maximum data values for delta codes of
-*                codeSize bits.
+*   Returned   : The number of bits in the encoded stream, including the
+*                stream header and all block headers.  (unsigned long)(-1)
+*                is returned and errno is set in the event of a failure.
 ***************************************************************************/
-static range_t MakeRange(const unsigned char codeSize)
+unsigned long DeltaCostBuffer(const unsigned char *buffer,
+    const size_t length, const delta_options_t *options)
 {
-    range_t range;
-    range.min = (signed char)(0 - (1 << (codeSize - 1)));   /* -2^(n - 1) */
-    range.max = (signed char)((1 << (codeSize - 1)) - 1);   /* 2^(n  - 1) - 1 */
+    unsigned char sampleSize, c;
+    unsigned char planes[BUFFER_SIZE];
+    long residuals[BUFFER_SIZE];
+    unsigned char payload[PAYLOAD_SIZE];
+    unsigned long cost, nextSync, syncBytes;
+    size_t chunk, used, size, planeSize, planeLength, count;
+    delta_options_t stream;
+    channel_t channels[MAX_PLANES];
+    channel_t *channel;
+    predictor_data_t *scratch;
+    unsigned char *plane;
 
-    return range;
+    if (!ValidOptions(options) || ((NULL == buffer) && (0 != length)))
+    {
+        errno = EINVAL;
+        return (unsigned long)(-1);
+    }
+
+    stream = *options;
+
+    /* stream header and the block that ends the stream */
+    cost = 8 * (HEADER_SIZE + BLOCK_HEADER_SIZE);
+
+    if (DELTA_AUTO_SIZE == stream.codeSize)
+    {
+        stream.codeSize = DELTA_DEFAULT_SIZE;
+    }
+
+    UsePlanes(&stream);
+    sampleSize = stream.sampleSize;
+    scratch = CreatePredictorData(PREDICT_PREVIOUS, sampleSize);
+
+    if ((NULL == scratch) || (0 != SetPredictorWidth(scratch, stream.width)) ||
+        (0 != InitChannels(channels, &stream)))
+    {
+        FreePredictorData(scratch);
+        errno = ENOMEM;
+        return (unsigned long)(-1);
+    }
+
+    /* the trailer that follows the end block */
+    cost += 8 * (unsigned long)SyncPointSize(channels, stream.channels);
+
+    /* work through the same blocks the encoder would read */
+    chunk = BlockSize(&stream);
+    planeSize = ChannelLength(chunk, &stream, 0);
+    syncBytes = stream.syncInterval * stream.channels * sampleSize;
+    nextSync = syncBytes;
+
+    for (used = 0; used < length; used += size)
+    {
+        size = (length - used < chunk) ? (length - used) : chunk;
+
+        if ((0 != syncBytes) && (used >= nextSync))
+        {
+            cost += 8 * (unsigned long)SyncPointSize(channels,
+                stream.channels);
+            nextSync = used + syncBytes;
+        }
+
+        SplitFrames(buffer + used, size, &stream, planes, planeSize);
+
+        for (c = 0; c < stream.channels; c++)
+        {
+            channel = &channels[c];
+            plane = planes + c * planeSize;
+            planeLength = ChannelLength(size, &stream, c);
+            cost += 8 * BLOCK_HEADER_SIZE;
+
+            if (0 == planeLength)
+            {
+                continue;
+            }
+
+            count = PadSamples(plane, planeLength, sampleSize) / sampleSize;
+            channel->block.length = planeLength;
+            PrepareBlock(&(channel->coder), channel->predictor, scratch,
+                options, plane, count, 1, &(channel->block), residuals,
+                payload);
+            cost += 8 * (unsigned long)channel->block.payload;
+        }
+    }
+
+    FreeChannels(channels, stream.channels);
+    FreePredictorData(scratch);
+    return cost;
+}
+
+/***************************************************************************
+*   Function   : DeltaBackendName
+*   Description: This function returns the name of a backend as accepted
+*                by DeltaParseBackend.
+*   Parameters : backend - the backend to name.
+*   Effects    : None
+*   Returned   : The backend's name, or NULL if there's no such backend.
+***************************************************************************/
+const char *DeltaBackendName(const delta_backend_t backend)
+{
+    if ((unsigned int)backend >= DELTA_NUM_BACKENDS)
+    {
+        return NULL;
+    }
+
+    return backends[backend].name;
+}
+
+/***************************************************************************
+*   Function   : DeltaParseBackend
+*   Description: This function looks up a backend by name.
+*   Parameters : text - the name of the backend.
+*                backend - pointer to storage for the backend.
+*   Effects    : backend is set if the name is found.
+*   Returned   : 0 for success, -1 if the name isn't a backend.
+***************************************************************************/
+int DeltaParseBackend(const char *text, delta_backend_t *backend)
+{
+    int i;
+
+    if (NULL == text)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < DELTA_NUM_BACKENDS; i++)
+    {
+        if (0 == strcmp(text, backends[i].name))
+        {
+            *backend = (delta_backend_t)i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/***************************************************************************
+*   Function   : DeltaSampleType
+*   Description: This function sets the options that suit a type of
+*                sample: the sample size and signedness, for floating
+*                point types the xor predictor and gorilla backend, and
+*                for timestamps the period predictor and pfor backend.
+*   Parameters : text - the name of the sample type (int8, int16, int32,
+*                       int64, their unsigned uint versions, float,
+*                       double, time32, or time64).
+*                options - the options to set.
+*   Effects    : options is updated if the name is found.  Options the
+*                type doesn't care about are left alone.
+*   Returned   : 0 for success, -1 if the name isn't a sample type.
+***************************************************************************/
+int DeltaSampleType(const char *text, delta_options_t *options)
+{
+    const sample_type_t *type;
+
+    if (NULL == text)
+    {
+        return -1;
+    }
+
+    for (type = sampleTypes; NULL != type->name; type++)
+    {
+        if (0 == strcmp(text, type->name))
+        {
+            options->sampleSize = type->sampleSize;
+            options->isSigned = type->isSigned;
+
+            if (PREDICT_NUM_PREDICTORS != type->predictor)
+            {
+                options->predictor = type->predictor;
+            }
+
+            if (DELTA_NUM_BACKENDS != type->backend)
+            {
+                options->backend = type->backend;
+            }
+
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/***************************************************************************
+*   Function   : MakeRange
+*   Description: This function computes the minimum and maximum range
+*                limits for a codeSize bit delta encoded symbol.
+*   Parameters : codeSize - The number of bits used for code words at the
+*                           start of coding.
+*   Effects    : None
+*   Returned   : Range minimum and maximum data values for delta codes of
+*                codeSize bits.
+***************************************************************************/
+static range_t MakeRange(const unsigned char codeSize)
+{
+    range_t range;
+
+    /* 2^(n  - 1) - 1 computed without overflowing for n = MAX_CODE_SIZE */
+    range.max = (long)((1UL << (codeSize - 1)) - 1);
+    range.min = -range.max - 1;                             /* -2^(n - 1) */
+
+    return range;
+}
+
+/***************************************************************************
+*   Function   : CodeMask
+*   Description: This function computes a mask of the bits used by a code
+*                word.
+*   Parameters : codeSize - The number of bits in the code word.
+*   Effects    : None
+*   Returned   : A value with the low codeSize bits set.
+***************************************************************************/
+static unsigned long CodeMask(const unsigned char codeSize)
+{
+    if (codeSize >= MAX_CODE_SIZE)
+    {
+        return ~0UL;
+    }
+
+    return (1UL << codeSize) - 1;
+}
+
+/***************************************************************************
+*   Function   : EscapeCode
+*   Description: This function computes the code word used to indicate an
+*                overflow.  It's the codeSize bit two's complement form of
+*                the range minimum.
+*   Parameters : codeSize - The number of bits in the code word.
+*   Effects    : None
+*   Returned   : The overflow code word in the low codeSize bits.
+***************************************************************************/
+static unsigned long EscapeCode(const unsigned char codeSize)
+{
+    return 1UL << (codeSize - 1);
+}
+
+/***************************************************************************
+*   Function   : ZeroRun
+*   Description: This function counts the 0 residuals at the start of a
+*                buffer.
+*   Parameters : residuals - The residuals to count.
+*                count - The number of residuals in the buffer.
+*   Effects    : None
+*   Returned   : The number of residuals before the first non-zero one.
+***************************************************************************/
+static size_t ZeroRun(const long *residuals, const size_t count)
+{
+    size_t run;
+
+    for (run = 0; (run < count) && (0 == residuals[run]); run++)
+    {
+    }
+
+    return run;
+}
+
+/***************************************************************************
+*   Function   : RunCost
+*   Description: This function computes the number of bits used to code a
+*                run of 0 residuals as an escape, a 0 literal, and the run
+*                length.
+*   Parameters : codeSize - The number of bits in the escape code word.
+*                sampleBits - The number of bits in a literal.
+*                run - The number of 0 residuals in the run.
+*   Effects    : None
+*   Returned   : The number of bits in the coded run.
+***************************************************************************/
+static unsigned long RunCost(const unsigned char codeSize,
+    const unsigned char sampleBits, const size_t run)
+{
+    unsigned long cost;
+    size_t rest;
+
+    /* Elias gamma: one bit for the leading 1 and two for each bit after */
+    cost = codeSize + 1 + sampleBits + 1;
+
+    for (rest = run >> 1; 0 != rest; rest >>= 1)
+    {
+        cost += 2;
+    }
+
+    return cost;
+}
+
+/***************************************************************************
+*   Function   : OverflowCost
+*   Description: This function computes the number of bits used to code a
+*                residual that doesn't fit in a code word (see
+*                PutOverflow).
+*   Parameters : codeSize - The number of bits in the escape code word.
+*                sampleBits - The number of bits in a literal.
+*                width - The width of the residual (see DeltaWidth).  It
+*                        must be larger than codeSize.
+*   Effects    : None
+*   Returned   : The number of bits in the escape and the coded residual.
+***************************************************************************/
+static unsigned long OverflowCost(const unsigned char codeSize,
+    const unsigned char sampleBits, const unsigned char width)
+{
+    unsigned long grown, literal;
+
+    literal = 1 + sampleBits;
+
+    if (width > sampleBits)
+    {
+        /* only the most negative sample is this wide */
+        return codeSize + literal;
+    }
+
+    /* the increment in unary, then the residual less its top bit */
+    grown = (width - codeSize) + (width - 1);
+
+    if (width < sampleBits)
+    {
+        /* the unary code is cut short at the widest width */
+        grown++;
+    }
+
+    return codeSize + ((grown < literal) ? grown : literal);
+}
+
+/***************************************************************************
+*   Function   : PutCodeBits
+*   Description: This function adds the low bits of a value to a block's
+*                codes in the order BitFilePutBitsNum writes them: whole
+*                bytes from the least significant, then the bits left
+*                over, each from its most significant bit.  Bytes that
+*                don't fit in the payload are counted but not kept.
+*   Parameters : codes - Pointer to the codes receiving the bits.
+*                value - The value to add.
+*                count - The number of low bits of value to add.
+*   Effects    : Whole bytes are added to codes' payload and the rest are
+*                kept in codes.
+*   Returned   : None
+***************************************************************************/
+static void PutCodeBits(code_buffer_t *codes, unsigned long value,
+    unsigned int count)
+{
+    unsigned int chunk;
+
+    for (; 0 != count; count -= chunk)
+    {
+        chunk = (count > 8) ? 8 : count;
+        codes->buffer = (codes->buffer << chunk) |
+            (value & ((1UL << chunk) - 1));
+        codes->bits += chunk;
+        value >>= chunk;
+
+        if (codes->bits >= 8)
+        {
+            codes->bits -= 8;
+
+            if (codes->length < codes->size)
+            {
+                codes->payload[codes->length] =
+                    (unsigned char)((codes->buffer >> codes->bits) & 0xFF);
+            }
+
+            codes->length++;
+        }
+    }
+}
+
+/***************************************************************************
+*   Function   : EndCodes
+*   Description: This function fills out the last byte of a block's codes
+*                with 0s, like BitFileByteAlign does.
+*   Parameters : codes - Pointer to the codes to end.
+*   Effects    : Any waiting bits are added to codes' payload.
+*   Returned   : The number of bytes in the coded block, counting any
+*                that didn't fit in the payload.
+***************************************************************************/
+static size_t EndCodes(code_buffer_t *codes)
+{
+    if (0 != codes->bits)
+    {
+        PutCodeBits(codes, 0, 8 - codes->bits);
+    }
+
+    return codes->length;
+}
+
+/***************************************************************************
+*   Function   : GetCodeBits
+*   Description: This function reverses PutCodeBits, reading a value from
+*                a block's codes in the order BitFileGetBitsNum reads it.
+*   Parameters : codes - Pointer to the codes to read.
+*                count - The number of bits in the value.
+*                value - Pointer to storage for the value.
+*   Effects    : The bits are read from codes.
+*   Returned   : 0 for success, EOF if the codes end first.
+***************************************************************************/
+static int GetCodeBits(code_reader_t *codes, const unsigned int count,
+    unsigned long *value)
+{
+    unsigned long result;
+    unsigned int chunk, shift;
+
+    result = 0;
+
+    for (shift = 0; shift < count; shift += chunk)
+    {
+        chunk = (count - shift > 8) ? 8 : count - shift;
+
+        if (codes->bits < chunk)
+        {
+            if (codes->next >= codes->length)
+            {
+                return EOF;
+            }
+
+            codes->buffer = (codes->buffer << 8) |
+                codes->payload[codes->next++];
+            codes->bits += 8;
+        }
+
+        codes->bits -= chunk;
+        result |= ((codes->buffer >> codes->bits) & ((1UL << chunk) - 1)) <<
+            shift;
+    }
+
+    *value = result;
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : PutOverflow
+*   Description: This function writes a residual that doesn't fit in a
+*                code word, following the escape code word.  It's written
+*                one of two ways, whichever is shorter:
+*                  0 and the residual as a sampleBits literal
+*                  (width - codeSize) 1s, a 0 unless width is sampleBits,
+*                  the sign, and the magnitude less its leading 1 in
+*                  width - 2 bits
+*                The second costs about twice the width, so a residual that
+*                only just doesn't fit is much cheaper than a literal.
+*                A 0 never needs a literal, so a 0 literal starts a run.
+*   Parameters : codes - Pointer to the codes receiving the residual.
+*                residual - The residual to write.
+*                codeSize - The number of bits in the escape code word.
+*                sampleBits - The number of bits in a sample.
+*                width - The width of the residual (see DeltaWidth).  It
+*                        must be larger than codeSize.
+*   Effects    : The coded residual is added to codes.
+*   Returned   : None
+***************************************************************************/
+static void PutOverflow(code_buffer_t *codes, const long residual,
+    const unsigned char codeSize, const unsigned char sampleBits,
+    const unsigned char width)
+{
+    unsigned long code;
+
+    if (OverflowCost(codeSize, sampleBits, width) ==
+        codeSize + 1UL + sampleBits)
+    {
+        /* too wide for the unary form to pay off */
+        code = (unsigned long)residual & CodeMask(sampleBits);
+        PutCodeBits(codes, 0, 1);
+        PutCodeBits(codes, code, sampleBits);
+        return;
+    }
+
+    PutCodeBits(codes, CodeMask(width - codeSize), width - codeSize);
+
+    if (width < sampleBits)
+    {
+        PutCodeBits(codes, 0, 1);
+    }
+
+    /* the width is exact, so the magnitude's leading 1 is implied */
+    if (residual < 0)
+    {
+        PutCodeBits(codes, 1, 1);
+        code = (unsigned long)(-(residual + 1)) + 1;
+    }
+    else
+    {
+        PutCodeBits(codes, 0, 1);
+        code = (unsigned long)residual;
+    }
+
+    code -= 1UL << (width - 2);
+    PutCodeBits(codes, code, width - 2);
+}
+
+/***************************************************************************
+*   Function   : GetEscape
+*   Description: This function reads what follows an escape code word: a
+*                residual written by PutOverflow or a 0 literal starting
+*                a run of 0 residuals.
+*   Parameters : codes - Pointer to the codes containing the escape.
+*                codeSize - The number of bits in the escape code word.
+*                sampleBits - The number of bits in a sample.
+*                residual - Pointer to storage for the residual.
+*   Effects    : The escape is read from codes.
+*   Returned   : ESCAPE_RESIDUAL if residual was read, ESCAPE_RUN if a run
+*                length follows, or EOF if the data ran out or is invalid.
+***************************************************************************/
+static int GetEscape(code_reader_t *codes, const unsigned char codeSize,
+    const unsigned char sampleBits, long *residual)
+{
+    unsigned long code, bit;
+    unsigned char width;
+
+    if (EOF == GetCodeBits(codes, 1, &bit))
+    {
+        return EOF;
+    }
+
+    if (0 == bit)
+    {
+        if (EOF == GetCodeBits(codes, sampleBits, &code))
+        {
+            return EOF;
+        }
+
+        *residual = SignExtend(code, sampleBits);
+        return (0 == code) ? ESCAPE_RUN : ESCAPE_RESIDUAL;
+    }
+
+    /* the width grows by one for the first 1 and each 1 after it */
+    width = codeSize + 1;
+
+    if (width > sampleBits)
+    {
+        return EOF;
+    }
+
+    bit = 1;
+
+    while (width < sampleBits)
+    {
+        if (EOF == GetCodeBits(codes, 1, &bit))
+        {
+            return EOF;
+        }
+
+        if (0 == bit)
+        {
+            break;
+        }
+
+        width++;
+    }
+
+    if ((EOF == GetCodeBits(codes, 1, &bit)) ||
+        (EOF == GetCodeBits(codes, width - 2, &code)))
+    {
+        return EOF;
+    }
+
+    code += 1UL << (width - 2);
+    *residual = bit ? -(long)code : (long)code;
+    return ESCAPE_RESIDUAL;
+}
+
+/***************************************************************************
+*   Function   : PutRunLength
+*   Description: This function writes the length of a run of 0 residuals
+*                as an Elias gamma code: one 0 bit for every bit after the
+*                leading 1 of the length, then the length with its leading 1.
+*   Parameters : codes - Pointer to the codes receiving the length.
+*                run - The run length.  It must not be 0.
+*   Effects    : The run length is added to codes.
+*   Returned   : None
+***************************************************************************/
+static void PutRunLength(code_buffer_t *codes, const size_t run)
+{
+    unsigned long rest;
+    unsigned int bits;
+
+    bits = 0;
+
+    for (rest = run >> 1; 0 != rest; rest >>= 1)
+    {
+        bits++;
+    }
+
+    PutCodeBits(codes, 0, bits);
+    PutCodeBits(codes, 1, 1);
+    rest = run - (1UL << bits);
+    PutCodeBits(codes, rest, bits);
+}
+
+/***************************************************************************
+*   Function   : GetRunLength
+*   Description: This function reads a run length written by PutRunLength.
+*   Parameters : codes - Pointer to the codes containing the length.
+*                run - Pointer to storage for the run length.
+*   Effects    : The run length is read from codes.
+*   Returned   : 0 for success, EOF if the codes end or the length is
+*                longer than any block.
+***************************************************************************/
+static int GetRunLength(code_reader_t *codes, size_t *run)
+{
+    unsigned long rest, bit;
+    unsigned int bits;
+
+    bits = 0;
+
+    do
+    {
+        if (EOF == GetCodeBits(codes, 1, &bit))
+        {
+            return EOF;
+        }
+    } while ((0 == bit) && (++bits <= MAX_RUN_BITS));
+
+    if ((0 == bit) || (EOF == GetCodeBits(codes, bits, &rest)))
+    {
+        return EOF;
+    }
+
+    *run = (size_t)((1UL << bits) + rest);
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : PadSamples
+*   Description: This function pads a buffer with zeros so that it holds a
+*                whole number of samples.  Only the last block of a stream
+*                can need padding.
+*   Parameters : buffer - The buffer to pad.  It must have room for the
+*                         padding.
+*                length - The number of bytes in buffer.
+*                sampleSize - The number of bytes in a sample.
+*   Effects    : Zeros are appended to buffer.
+*   Returned   : The length of the padded buffer.
+***************************************************************************/
+static size_t PadSamples(unsigned char *buffer, const size_t length,
+    const unsigned char sampleSize)
+{
+    size_t partial;
+
+    partial = length % sampleSize;
+
+    if (0 == partial)
+    {
+        return length;
+    }
+
+    memset(buffer + length, 0, sampleSize - partial);
+    return length + sampleSize - partial;
+}
+
+/***************************************************************************
+*   Function   : ValidOptions
+*   Description: This function checks that encoding options are in range.
+*   Parameters : options - Pointer to the options to check.
+*   Effects    : None
+*   Returned   : Non-zero if the options may be used, otherwise 0.
+***************************************************************************/
+static int ValidOptions(const delta_options_t *options)
+{
+    if ((NULL == options) || !ValidAdaptiveParams(&(options->adapt)))
+    {
+        return 0;
+    }
+
+    if ((options->sampleSize < 1) ||
+        (options->sampleSize > DELTA_MAX_SAMPLE_SIZE) ||
+        (options->channels < 1) ||
+        (options->channels > DELTA_MAX_CHANNELS) ||
+        (options->planes > 1) ||
+        (options->width > DELTA_MAX_WIDTH) ||
+        (options->isSigned > 1) ||
+        (options->maxError > DELTA_MAX_ERROR) ||
+        (options->syncInterval > ULONG_MAX / DELTA_MAX_CHANNELS /
+        DELTA_MAX_SAMPLE_SIZE) ||
+        ((0 == options->width) && PredictorUsesRows(options->predictor)) ||
+        (options->predictor > PREDICT_AUTO) ||
+        ((unsigned int)options->backend >= DELTA_NUM_BACKENDS))
+    {
+        return 0;
+    }
+
+    if ((DELTA_AUTO_SIZE != options->codeSize) &&
+        ((options->codeSize < MIN_CODE_SIZE) ||
+        (options->codeSize > 8 * options->sampleSize)))
+    {
+        /* code size is out of range */
+        return 0;
+    }
+
+    if ((0 != options->maxError) && ((0 != options->planes) ||
+        (options->sampleSize >= sizeof(long))))
+    {
+        /* lossy coding needs whole samples that fit in a long */
+        return 0;
+    }
+
+    return 1;
+}
+
+/***************************************************************************
+*   Function   : InitCoder
+*   Description: This function initializes the coding state for a stream.
+*   Parameters : coder - Pointer to the coding state to initialize.
+*                stream - The settings for the stream.  codeSize must not
+*                         be DELTA_AUTO_SIZE.
+*   Effects    : Adaptation statistics are allocated.
+*   Returned   : 0 for success, -1 for failure.
+***************************************************************************/
+static int InitCoder(coder_t *coder, const delta_options_t *stream)
+{
+    coder->data = CreateAdaptiveData(&(stream->adapt), stream->codeSize,
+        8 * stream->sampleSize);
+
+    if (NULL == coder->data)
+    {
+        return -1;
+    }
+
+    coder->codeSize = stream->codeSize;
+    coder->sampleBits = 8 * stream->sampleSize;
+    coder->mask = CodeMask(coder->sampleBits);
+    coder->end = 0;
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : InitChannels
+*   Description: This function initializes the prediction and coding
+*                state of every channel in a stream.
+*   Parameters : channels - Array of MAX_PLANES channel states.
+*                stream - The settings for the stream.  codeSize must not
+*                         be DELTA_AUTO_SIZE.
+*   Effects    : The first stream->channels channel states are allocated
+*                and initialized.  Nothing is left allocated on failure.
+*   Returned   : 0 for success, -1 for failure.
+***************************************************************************/
+static int InitChannels(channel_t *channels, const delta_options_t *stream)
+{
+    unsigned char c;
+
+    for (c = 0; c < stream->channels; c++)
+    {
+        channels[c].block.predictor = PREDICT_PREVIOUS;
+        channels[c].predictor = CreatePredictorData(PREDICT_PREVIOUS,
+            stream->sampleSize);
+
+        if ((NULL == channels[c].predictor) ||
+            (0 != SetPredictorWidth(channels[c].predictor, stream->width)) ||
+            (0 != SetPredictorError(channels[c].predictor, stream->maxError,
+            stream->isSigned)) ||
+            (0 != InitCoder(&(channels[c].coder), stream)))
+        {
+            FreePredictorData(channels[c].predictor);
+            FreeChannels(channels, c);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : FreeChannels
+*   Description: This function frees the channel states allocated by
+*                InitChannels.
+*   Parameters : channels - Array of channel states.
+*                count - The number of initialized channel states.
+*   Effects    : The channels' prediction and adaptation data is freed.
+*   Returned   : None
+***************************************************************************/
+static void FreeChannels(channel_t *channels, const unsigned char count)
+{
+    unsigned char c;
+
+    for (c = 0; c < count; c++)
+    {
+        FreeAdaptiveData(channels[c].coder.data);
+        FreePredictorData(channels[c].predictor);
+    }
+}
+
+/***************************************************************************
+*   Function   : UsePlanes
+*   Description: This function changes the sample layout of a stream that
+*                uses byte planes, so that every byte of a sample is split
+*                out and coded as a channel of its own.  High order bytes
+*                that change slowly then get small code words of their
+*                own instead of sharing the size needed by the low order
+*                bytes.
+*   Parameters : stream - The settings for the stream.  codeSize must not
+*                         be DELTA_AUTO_SIZE.
+*   Effects    : With byte planes, stream becomes a stream of 1 byte
+*                samples with a channel for every byte of a frame.
+*                Otherwise stream isn't changed.
+*   Returned   : None
+***************************************************************************/
+static void UsePlanes(delta_options_t *stream)
+{
+    if (!stream->planes)
+    {
+        return;
+    }
+
+    stream->channels *= stream->sampleSize;
+    stream->sampleSize = 1;
+    stream->planes = 0;
+
+    if (stream->codeSize > 8)
+    {
+        stream->codeSize = 8;
+    }
+}
+
+/***************************************************************************
+*   Function   : BlockSize
+*   Description: This function computes the number of input bytes the
+*                encoder reads for each block of a stream.
+*   Parameters : stream - The settings for the stream.
+*   Effects    : None
+*   Returned   : BUFFER_SIZE rounded down to a whole number of frames.
+***************************************************************************/
+static size_t BlockSize(const delta_options_t *stream)
+{
+    size_t frameSize;
+
+    frameSize = (size_t)stream->channels * stream->sampleSize;
+    return BUFFER_SIZE - (BUFFER_SIZE % frameSize);
+}
+
+/***************************************************************************
+*   Function   : ChannelLength
+*   Description: This function computes how many bytes of a block of
+*                interleaved frames belong to one channel.  Only the last
+*                frame of a stream can be cut short.
+*   Parameters : length - The number of bytes in the block.
+*                stream - The settings for the stream.
+*                channel - The channel to measure.
+*   Effects    : None
+*   Returned   : The number of bytes SplitFrames writes for channel.
+***************************************************************************/
+static size_t ChannelLength(const size_t length,
+    const delta_options_t *stream, const unsigned char channel)
+{
+    size_t frameSize, partial, start, size;
+
+    frameSize = (size_t)stream->channels * stream->sampleSize;
+    size = (length / frameSize) * stream->sampleSize;
+    partial = length % frameSize;
+    start = (size_t)channel * stream->sampleSize;
+
+    if (partial > start)
+    {
+        partial -= start;
+        size += (partial < stream->sampleSize) ? partial :
+            stream->sampleSize;
+    }
+
+    return size;
+}
+
+/***************************************************************************
+*   Function   : SplitFrames
+*   Description: This function copies the samples of each channel out of a
+*                block of interleaved frames, so that every channel can be
+*                predicted from its own earlier samples.
+*   Parameters : frames - The block of interleaved frames.
+*                length - The number of bytes in frames.
+*                stream - The settings for the stream.
+*                planes - Buffer receiving the channels' samples.  Channel
+*                         c's samples start at planes + c * stride.
+*                stride - The number of bytes ChannelLength gives channel
+*                         0 for a whole block, which leaves room for a
+*                         padded last sample.
+*   Effects    : The samples of every channel are written to planes.
+*                ChannelLength gives the number written for each channel.
+*   Returned   : None
+***************************************************************************/
+static void SplitFrames(const unsigned char *frames, const size_t length,
+    const delta_options_t *stream, unsigned char *planes,
+    const size_t stride)
+{
+    size_t frameSize, done, offset, size, i;
+    unsigned char sampleSize, c;
+    unsigned char *plane;
+
+    if (1 == stream->channels)
+    {
+        memcpy(planes, frames, length);
+        return;
+    }
+
+    sampleSize = stream->sampleSize;
+    frameSize = (size_t)stream->channels * sampleSize;
+    done = 0;
+
+#ifdef SIMD_TRANSPOSE
+    if ((0 == VECTOR_SIZE % frameSize) && UseShuffles())
+    {
+        done = SplitVectors(frames, length, stream->channels, sampleSize,
+            planes, stride);
+    }
+#endif
+
+    /* whatever the shuffles left, a byte at a time */
+    for (c = 0; c < stream->channels; c++)
+    {
+        plane = planes + c * stride;
+        size = done / stream->channels;
+
+        for (offset = done + (size_t)c * sampleSize; offset < length;
+            offset += frameSize)
+        {
+            /* the last frame may be cut short */
+            for (i = 0; (i < sampleSize) && (offset + i < length); i++)
+            {
+                plane[size++] = frames[offset + i];
+            }
+        }
+    }
+}
+
+/***************************************************************************
+*   Function   : MergeFrames
+*   Description: This function reverses SplitFrames, copying the samples
+*                of every channel back into a block of interleaved frames.
+*   Parameters : planes - The channels' samples, channel c's starting at
+*                         planes + c * stride.
+*                stride - The number of bytes between channels in planes.
+*                length - The number of bytes in the block of frames.
+*                stream - The settings for the stream.
+*                frames - Buffer receiving the interleaved frames.
+*   Effects    : length bytes of frames are written.
+*   Returned   : None
+***************************************************************************/
+static void MergeFrames(const unsigned char *planes, const size_t stride,
+    const size_t length, const delta_options_t *stream,
+    unsigned char *frames)
+{
+    size_t frameSize, done, offset, size, i;
+    unsigned char sampleSize, c;
+    const unsigned char *plane;
+
+    if (1 == stream->channels)
+    {
+        memcpy(frames, planes, length);
+        return;
+    }
+
+    sampleSize = stream->sampleSize;
+    frameSize = (size_t)stream->channels * sampleSize;
+    done = 0;
+
+#ifdef SIMD_TRANSPOSE
+    if ((0 == VECTOR_SIZE % frameSize) && UseShuffles())
+    {
+        done = MergeVectors(planes, stride, length, stream->channels,
+            sampleSize, frames);
+    }
+#endif
+
+    for (c = 0; c < stream->channels; c++)
+    {
+        plane = planes + c * stride;
+        size = done / stream->channels;
+
+        for (offset = done + (size_t)c * sampleSize; offset < length;
+            offset += frameSize)
+        {
+            for (i = 0; (i < sampleSize) && (offset + i < length); i++)
+            {
+                frames[offset + i] = plane[size++];
+            }
+        }
+    }
+}
+
+#ifdef SIMD_TRANSPOSE
+/***************************************************************************
+*   Function   : UseShuffles
+*   Description: This function checks whether the processor has SSSE3's
+*                byte shuffles, which SplitVectors and MergeVectors need.
+*   Parameters : None
+*   Effects    : The processor is checked on the first call.
+*   Returned   : Non-zero if SplitVectors and MergeVectors may be used.
+***************************************************************************/
+static int UseShuffles(void)
+{
+    if (!shuffleReady)
+    {
+        __builtin_cpu_init();
+        haveShuffles = __builtin_cpu_supports("ssse3");
+        shuffleReady = 1;
+    }
+
+    return haveShuffles;
+}
+
+/***************************************************************************
+*   Function   : MakeGroupMask
+*   Description: This function makes the byte shuffle that groups the
+*                bytes of each channel in VECTOR_SIZE bytes of frames.
+*                Every channel gets VECTOR_SIZE / channels bytes, channel
+*                0's first.
+*   Parameters : channels - The number of channels in a frame.
+*                sampleSize - The number of bytes in a sample.  A frame
+*                             must divide VECTOR_SIZE.
+*                mask - Buffer receiving the VECTOR_SIZE byte shuffle.
+*                       Byte k of the grouped bytes is byte mask[k] of the
+*                       frames.
+*   Effects    : mask is written.
+*   Returned   : None
+***************************************************************************/
+static void MakeGroupMask(const unsigned char channels,
+    const unsigned char sampleSize, unsigned char *mask)
+{
+    size_t segment, frameSize, c, i, k;
+
+    segment = VECTOR_SIZE / channels;
+    frameSize = (size_t)channels * sampleSize;
+
+    for (k = 0; k < VECTOR_SIZE; k++)
+    {
+        /* byte i of channel c's segment */
+        c = k / segment;
+        i = k % segment;
+        mask[k] = (unsigned char)((i / sampleSize) * frameSize +
+            c * sampleSize + (i % sampleSize));
+    }
+}
+
+/***************************************************************************
+*   Function   : SplitVectors
+*   Description: This function does the work of SplitFrames for as many
+*                runs of VECTOR_SIZE frames bytes per channel as length
+*                holds.  Each register of frames has its bytes grouped by
+*                channel, and then the registers are transposed, so that
+*                register c holds the next VECTOR_SIZE bytes of channel c.
+*                It must only be called if UseShuffles returns non-zero.
+*   Parameters : frames - The block of interleaved frames.
+*                length - The number of bytes in frames.
+*                channels - The number of channels in a frame (2 - 16).
+*                sampleSize - The number of bytes in a sample.  A frame
+*                             must divide VECTOR_SIZE.
+*                planes - Buffer receiving the channels' samples.
+*                stride - The number of bytes between channels in planes.
+*   Effects    : The first samples of every channel are written to
+*                planes.
+*   Returned   : The number of bytes of frames split.
+***************************************************************************/
+static size_t SplitVectors(const unsigned char *frames, const size_t length,
+    const unsigned char channels, const unsigned char sampleSize,
+    unsigned char *planes, const size_t stride)
+{
+    __m128i vectors[VECTOR_SIZE];
+    __m128i group;
+    unsigned char mask[VECTOR_SIZE];
+    size_t done, run;
+    unsigned char c;
+
+    MakeGroupMask(channels, sampleSize, mask);
+    group = _mm_loadu_si128((const __m128i *)mask);
+    run = (size_t)VECTOR_SIZE * channels;
+
+    for (done = 0; done + run <= length; done += run)
+    {
+        for (c = 0; c < channels; c++)
+        {
+            vectors[c] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)
+                (frames + done + c * VECTOR_SIZE)), group);
+        }
+
+        TransposeChannels(vectors, channels);
+
+        for (c = 0; c < channels; c++)
+        {
+            _mm_storeu_si128((__m128i *)(planes + c * stride +
+                done / channels), vectors[c]);
+        }
+    }
+
+    return done;
+}
+
+/***************************************************************************
+*   Function   : MergeVectors
+*   Description: This function does the work of MergeFrames for as many
+*                runs of VECTOR_SIZE bytes per channel as length holds, by
+*                undoing the steps of SplitVectors in reverse order.  It
+*                must only be called if UseShuffles returns non-zero.
+*   Parameters : planes - The channels' samples.
+*                stride - The number of bytes between channels in planes.
+*                length - The number of bytes in the block of frames.
+*                channels - The number of channels in a frame (2 - 16).
+*                sampleSize - The number of bytes in a sample.  A frame
+*                             must divide VECTOR_SIZE.
+*                frames - Buffer receiving the interleaved frames.
+*   Effects    : The first bytes of frames are written.
+*   Returned   : The number of bytes of frames written.
+***************************************************************************/
+static size_t MergeVectors(const unsigned char *planes, const size_t stride,
+    const size_t length, const unsigned char channels,
+    const unsigned char sampleSize, unsigned char *frames)
+{
+    __m128i vectors[VECTOR_SIZE];
+    __m128i ungroup;
+    unsigned char mask[VECTOR_SIZE], inverse[VECTOR_SIZE];
+    size_t done, run;
+    unsigned char c;
+
+    MakeGroupMask(channels, sampleSize, mask);
+
+    for (c = 0; c < VECTOR_SIZE; c++)
+    {
+        inverse[mask[c]] = c;
+    }
+
+    ungroup = _mm_loadu_si128((const __m128i *)inverse);
+    run = (size_t)VECTOR_SIZE * channels;
+
+    for (done = 0; done + run <= length; done += run)
+    {
+        for (c = 0; c < channels; c++)
+        {
+            vectors[c] = _mm_loadu_si128((const __m128i *)(planes +
+                c * stride + done / channels));
+        }
+
+        /* transposing twice gives back what was transposed */
+        TransposeChannels(vectors, channels);
+
+        for (c = 0; c < channels; c++)
+        {
+            _mm_storeu_si128((__m128i *)(frames + done + c * VECTOR_SIZE),
+                _mm_shuffle_epi8(vectors[c], ungroup));
+        }
+    }
+
+    return done;
+}
+
+/***************************************************************************
+*   Function   : TransposeChannels
+*   Description: This function transposes a register of grouped bytes for
+*                each channel into a register of bytes of each channel,
+*                or back.  Every count gets its own call of
+*                TransposeVectors, so that the compiler can unroll each
+*                one.
+*   Parameters : vectors - The registers to transpose.
+*                channels - The number of channels (2, 4, 8, or 16).
+*   Effects    : vectors is transposed.
+*   Returned   : None
+***************************************************************************/
+static void TransposeChannels(__m128i *vectors, const unsigned char channels)
+{
+    switch (channels)
+    {
+        case 2:
+            TransposeVectors(vectors, 2, VECTOR_SIZE / 2);
+            break;
+
+        case 4:
+            TransposeVectors(vectors, 4, VECTOR_SIZE / 4);
+            break;
+
+        case 8:
+            TransposeVectors(vectors, 8, VECTOR_SIZE / 8);
+            break;
+
+        default:
+            TransposeVectors(vectors, 16, VECTOR_SIZE / 16);
+            break;
+    }
+}
+
+/***************************************************************************
+*   Function   : TransposeVectors
+*   Description: This function transposes registers made of segments, so
+*                that segment j of register k becomes segment k of register
+*                j.  Each round interleaves pairs of registers with
+*                segments twice as wide as the last round's.
+*   Parameters : vectors - The registers to transpose.
+*                count - The number of registers, which is also the
+*                        number of segments in each (2, 4, 8, or 16).
+*                width - The number of bytes in a segment.
+*   Effects    : vectors is transposed.
+*   Returned   : None
+***************************************************************************/
+static void TransposeVectors(__m128i *vectors, const unsigned char count,
+    size_t width)
+{
+    __m128i paired[VECTOR_SIZE];
+    unsigned char distance, i, k;
+
+    for (distance = 1; distance < count; distance *= 2, width *= 2)
+    {
+        k = 0;
+
+        for (i = 0; i < count; i++)
+        {
+            if (0 == (i & distance))
+            {
+                paired[k++] = Interleave(vectors[i], vectors[i + distance],
+                    width, 0);
+                paired[k++] = Interleave(vectors[i], vectors[i + distance],
+                    width, 1);
+            }
+        }
+
+        memcpy(vectors, paired, count * sizeof(__m128i));
+    }
+}
+
+/***************************************************************************
+*   Function   : Interleave
+*   Description: This function interleaves the low or high halves of two
+*                registers.
+*   Parameters : a - The register whose pieces come first.
+*                b - The register whose pieces come second.
+*                width - The number of bytes in a piece (1, 2, 4, or 8).
+*                high - Non-zero to interleave the high halves.
+*   Effects    : None
+*   Returned   : The interleaved register.
+***************************************************************************/
+static __m128i Interleave(const __m128i a, const __m128i b,
+    const size_t width, const int high)
+{
+    switch (width)
+    {
+        case 1:
+            return high ? _mm_unpackhi_epi8(a, b) : _mm_unpacklo_epi8(a, b);
+
+        case 2:
+            return high ? _mm_unpackhi_epi16(a, b) :
+                _mm_unpacklo_epi16(a, b);
+
+        case 4:
+            return high ? _mm_unpackhi_epi32(a, b) :
+                _mm_unpacklo_epi32(a, b);
+
+        default:
+            return high ? _mm_unpackhi_epi64(a, b) :
+                _mm_unpacklo_epi64(a, b);
+    }
+}
+#endif
+
+/***************************************************************************
+*   Function   : ChoosePredictor
+*   Description: This function picks the predictor that is expected to
+*                code a block of samples in the fewest bits.  For the bits
+*                backend each predictor's residuals are scored with the
+*                coding kernel's Cost function, starting from the code size
+*                PrepareBlock would start the block with, so runs and
+*                escapes are counted the way they would be coded.  The
+*                kernels say nothing about the other backends, so there
+*                the score is the sum of the residuals' widths.
+*   Parameters : coder - Pointer to the coding state.
+*                predictor - Pointer to the predictor state at the start of
+*                            the block.
+*                scratch - Pointer to predictor state used for the trials.
+*                options - The encoding options.  The row predictors are
+*                          only tried if options->width isn't 0.
+*                samples - The samples in the block.
+*                count - The number of samples.
+*                residuals - Buffer of count residuals used for the trials.
+*   Effects    : scratch, residuals, and coder's adaptive statistics are
+*                overwritten.
+*   Returned   : The predictor with the lowest score.  Ties go to the
+*                predictor listed first in predictor_t.
+***************************************************************************/
+static predictor_t ChoosePredictor(coder_t *coder,
+    const predictor_data_t *predictor, predictor_data_t *scratch,
+    const delta_options_t *options, const unsigned char *samples,
+    const size_t count, long *residuals)
+{
+    predictor_t best;
+    unsigned long score, bestScore;
+    unsigned char codeSize;
+    size_t i;
+    int trial;
+
+    codeSize = coder->codeSize;     /* the size the block would start at */
+    best = PREDICT_PREVIOUS;
+    bestScore = (unsigned long)(-1);
+
+    for (trial = 0; trial < PREDICT_NUM_PREDICTORS; trial++)
+    {
+        if ((0 == options->width) && PredictorUsesRows((predictor_t)trial))
+        {
+            continue;
+        }
+
+        CopyPredictorData(scratch, predictor);
+        SelectPredictor(scratch, (predictor_t)trial);
+        PredictResiduals(scratch, samples, count, residuals);
+
+        if (NULL != backends[options->backend].Encode)
+        {
+            score = 0;
+
+            for (i = 0; i < count; i++)
+            {
+                score += DeltaWidth(residuals[i]);
+            }
+        }
+        else
+        {
+            if (DELTA_AUTO_SIZE == options->codeSize)
+            {
+                coder->codeSize = ChooseCodeSize(coder, residuals, count);
+            }
+
+            ResetAdaptiveData(coder->data, coder->codeSize);
+            score = kernels[options->adapt.policy].Cost(coder, residuals,
+                count);
+            coder->codeSize = codeSize;
+        }
+
+        if (score < bestScore)
+        {
+            bestScore = score;
+            best = (predictor_t)trial;
+        }
+    }
+
+    return best;
+}
+
+/***************************************************************************
+*   Function   : ChooseCodeSize
+*   Description: This function picks the starting code size for a block of
+*                residuals from a histogram of their widths: the size that
+*                would code the whole block in the fewest bits if it never
+*                adapted (see CheapestCodeSize).
+*   Parameters : coder - Pointer to the coding state.
+*                residuals - Residuals of the block.
+*                count - The number of residuals.
+*   Effects    : None
+*   Returned   : The code size with the lowest estimated cost.
+***************************************************************************/
+static unsigned char ChooseCodeSize(const coder_t *coder,
+    const long *residuals, const size_t count)
+{
+    unsigned int histogram[MAX_CODE_SIZE + 2];
+    unsigned char width;
+    size_t i;
+
+    if (0 == count)
+    {
+        /* nothing to measure */
+        return coder->codeSize;
+    }
+
+    memset(histogram, 0, sizeof(histogram));
+
+    for (i = 0; i < count; i++)
+    {
+        width = DeltaWidth(residuals[i]);
+
+        if (width > coder->sampleBits)
+        {
+            width = coder->sampleBits + 1;
+        }
+
+        histogram[width]++;
+    }
+
+    return CheapestCodeSize(histogram, count, coder->sampleBits);
+}
+
+/***************************************************************************
+*   Function   : CreateEncoder
+*   Description: This function allocates an encoder and everything it
+*                carries between calls, in the state a stream starts in.
+*   Parameters : outFile - Pointer to the file the stream is written to.
+*                options - Pointer to the encoding options.  They must be
+*                          valid.
+*   Effects    : Memory is allocated for the encoder.  Its bit file isn't
+*                made.
+*   Returned   : Pointer to the encoder, or NULL for failure.  errno will be
+*                set in the event of a failure.
+***************************************************************************/
+static delta_encoder_t *CreateEncoder(FILE *outFile,
+    const delta_options_t *options)
+{
+    delta_encoder_t *encoder;
+    delta_options_t *stream;
+
+    if (NULL == (encoder = (delta_encoder_t *)malloc(sizeof(*encoder))))
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    encoder->outFile = outFile;
+    encoder->bfp = NULL;
+    encoder->options = *options;
+    stream = &(encoder->stream);
+    *stream = *options;
+
+    if (DELTA_AUTO_SIZE == stream->codeSize)
+    {
+        /* a size is picked for every block */
+        stream->codeSize = DELTA_DEFAULT_SIZE;
+    }
+
+    UsePlanes(stream);
+    encoder->scratch = CreatePredictorData(PREDICT_PREVIOUS,
+        stream->sampleSize);
+    encoder->rebuilt = CreatePredictorData(PREDICT_PREVIOUS,
+        stream->sampleSize);
+    encoder->state = NULL;
+
+    if ((NULL == encoder->scratch) || (NULL == encoder->rebuilt) ||
+        (0 != SetPredictorWidth(encoder->scratch, stream->width)) ||
+        (0 != SetPredictorWidth(encoder->rebuilt, stream->width)) ||
+        (0 != InitChannels(encoder->channels, stream)))
+    {
+        FreePredictorData(encoder->scratch);
+        FreePredictorData(encoder->rebuilt);
+        free(encoder);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if (NULL == (encoder->state =
+        malloc(PredictorStateSize(encoder->channels[0].predictor))))
+    {
+        FreeEncoder(encoder);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    encoder->buffered = 0;
+    encoder->bytes = 0;
+    encoder->encoded = 0;
+    encoder->syncBytes = stream->syncInterval * stream->channels *
+        stream->sampleSize;
+    encoder->nextSync = encoder->syncBytes;
+    encoder->start = clock();
+
+    /* the end block and trailer are a fixed size for a stream */
+    encoder->trailer = (long)(BLOCK_HEADER_SIZE +
+        SyncPointSize(encoder->channels, stream->channels));
+
+    /* pipes can't take back the end of the stream after a flush */
+    encoder->seekable = (-1L != ftell(outFile));
+    return encoder;
+}
+
+/***************************************************************************
+*   Function   : FreeEncoder
+*   Description: This function frees an encoder made by CreateEncoder.
+*   Parameters : encoder - Pointer to the encoder.
+*   Effects    : The encoder and everything it holds are freed.  Its bit
+*                file is turned back into a normal file, which isn't
+*                closed.
+*   Returned   : None
+***************************************************************************/
+static void FreeEncoder(delta_encoder_t *encoder)
+{
+    if (NULL != encoder->bfp)
+    {
+        BitFileToFILE(encoder->bfp);
+    }
+
+    FreeChannels(encoder->channels, encoder->stream.channels);
+    FreePredictorData(encoder->scratch);
+    FreePredictorData(encoder->rebuilt);
+    free(encoder->state);
+    free(encoder);
+}
+
+/***************************************************************************
+*   Function   : EncodeFile
+*   Description: This function feeds everything left in an input stream to
+*                an encoder, then closes the encoder.
+*   Parameters : inFile - Pointer to a file stream to be encoded.
+*                encoder - Pointer to an encoder that isn't holding any
+*                          input.
+*   Effects    : inFile is encoded and the stream is ended.  The encoder is
+*                freed.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int EncodeFile(FILE *inFile, delta_encoder_t *encoder)
+{
+    size_t length;
+
+    /* blocks are read straight into the encoder's input buffer */
+    while (0 != (length = fread(encoder->input, sizeof(unsigned char),
+        BlockSize(&(encoder->stream)), inFile)))
+    {
+        EncodeFrames(encoder, encoder->input, length);
+    }
+
+    return DeltaEncoderClose(encoder);
+}
+
+/***************************************************************************
+*   Function   : EncodeFrames
+*   Description: This function encodes a block of frames as a block per
+*                channel, writing a resynchronization point before it when
+*                one is due.
+*   Parameters : encoder - Pointer to the encoder.
+*                frames - The input bytes.
+*                length - The number of bytes in frames, no more than a
+*                         block.  Only the last block of a stream may end
+*                         with a cut off frame.
+*   Effects    : The block is encoded and written to the encoder's file,
+*                and the encoder's channels move past it.
+*   Returned   : None
+***************************************************************************/
+static void EncodeFrames(delta_encoder_t *encoder,
+    const unsigned char *frames, const size_t length)
+{
+    unsigned char sampleSize, c;
+    unsigned char planes[BUFFER_SIZE];
+    long residuals[BUFFER_SIZE];
+    unsigned char payload[PAYLOAD_SIZE];
+    size_t size, count, planeSize;
+    const delta_options_t *options, *stream;
+    channel_t *channel;
+    bit_file_t *bfp;
+    unsigned char *plane;
+
+    options = &(encoder->options);
+    stream = &(encoder->stream);
+    sampleSize = stream->sampleSize;
+    bfp = encoder->bfp;
+
+    if ((0 != encoder->syncBytes) && (encoder->bytes >= encoder->nextSync))
+    {
+        WriteSyncPoint(bfp, encoder->channels, stream->channels,
+            encoder->bytes, encoder->state);
+        encoder->nextSync = encoder->bytes + encoder->syncBytes;
+    }
+
+    planeSize = ChannelLength(BlockSize(stream), stream, 0);
+    SplitFrames(frames, length, stream, planes, planeSize);
+
+    /* prediction runs across block boundaries; each block restarts code
+     * size adaptation from the size in its header */
+    for (c = 0; c < stream->channels; c++)
+    {
+        channel = &(encoder->channels[c]);
+        plane = planes + c * planeSize;
+        size = ChannelLength(length, stream, c);
+
+        if (0 == size)
+        {
+            /* the last frame was cut off before this channel */
+            WriteBlockHeader(bfp, &emptyBlock);
+            continue;
+        }
+
+        count = PadSamples(plane, size, sampleSize) / sampleSize;
+        channel->block.length = size;
+
+        if (0 != stream->maxError)
+        {
+            /* lossy blocks are checked against what they decode to */
+            CopyPredictorData(encoder->rebuilt, channel->predictor);
+        }
+
+        PrepareBlock(&(channel->coder), channel->predictor,
+            encoder->scratch, options, plane, count,
+            !BelowSpeed(encoder->start, encoder->encoded, options->minSpeed),
+            &(channel->block), residuals, payload);
+
+        if ((0 != stream->maxError) &&
+            (STORED_BLOCK != channel->block.codeSize))
+        {
+            SelectPredictor(encoder->rebuilt, channel->block.predictor);
+            RestoreSamples(encoder->rebuilt, residuals, count, plane);
+        }
+
+        channel->block.crc = Crc32c(0, plane, size);
+        WriteBlockHeader(bfp, &(channel->block));
+
+        if (STORED_BLOCK == channel->block.codeSize)
+        {
+            PutPayload(bfp, plane, size);
+        }
+        else
+        {
+            /* PrepareBlock already coded the block */
+            PutPayload(bfp, payload, channel->block.payload);
+        }
+    }
+
+    encoder->bytes += length;
+    encoder->encoded += length;
+}
+
+/***************************************************************************
+*   Function   : EndStream
+*   Description: This function writes the block that ends a stream and the
+*                trailer after it.
+*   Parameters : encoder - Pointer to the encoder.
+*   Effects    : encoder->trailer bytes are written to the encoder's file.
+*   Returned   : None
+***************************************************************************/
+static void EndStream(delta_encoder_t *encoder)
+{
+    /* a block without any input ends the stream */
+    WriteBlockHeader(encoder->bfp, &emptyBlock);
+    WriteTrailer(encoder->bfp, encoder->channels, encoder->stream.channels,
+        encoder->bytes, encoder->state);
+}
+
+/***************************************************************************
+*   Function   : PrepareBlock
+*   Description: This function picks the predictor and starting code size
+*                for a block, computes the block's residuals, and codes
+*                them in memory.  With PREDICT_AUTO every predictor is
+*                tried unless trial is 0, in which case the last block's
+*                predictor is used again.  Without DELTA_AUTO_SIZE a block
+*                starts with the code size the last block ended with.
+*                A block that codes to at least its input length is
+*                marked STORED_BLOCK instead.
+*   Parameters : coder - Pointer to the coding state.
+*                predictor - Pointer to the predictor state.
+*                scratch - Pointer to predictor state for PREDICT_AUTO
+*                          trials.
+*                options - The encoding options.
+*                samples - The samples in the block.
+*                count - The number of samples.
+*                trial - Non-zero if PREDICT_AUTO may try every predictor.
+*                block - Pointer to the block header.  The predictor field
+*                        must hold the last block's predictor and the
+*                        length field the block's input length.
+*                residuals - Buffer receiving count residuals.
+*                payload - Buffer of PAYLOAD_SIZE bytes receiving the
+*                          block's payload.
+*   Effects    : block's predictor, codeSize, and payload are set,
+*                residuals and payload are filled in, and predictor is set
+*                up for the block.  coder is left at the end of the
+*                block.
+*   Returned   : None
+***************************************************************************/
+static void PrepareBlock(coder_t *coder, predictor_data_t *predictor,
+    predictor_data_t *scratch, const delta_options_t *options,
+    const unsigned char *samples, const size_t count, const int trial,
+    block_header_t *block, long *residuals, unsigned char *payload)
+{
+    code_buffer_t codes;
+
+    if (PREDICT_AUTO != options->predictor)
+    {
+        block->predictor = options->predictor;
+    }
+    else if (trial)
+    {
+        block->predictor = ChoosePredictor(coder, predictor, scratch,
+            options, samples, count, residuals);
+    }
+
+    SelectPredictor(predictor, block->predictor);
+    PredictResiduals(predictor, samples, count, residuals);
+
+    if (NULL != backends[options->backend].Encode)
+    {
+        block->codeSize = 0;
+        block->payload = backends[options->backend].Encode(residuals, count,
+            coder->sampleBits, payload);
+    }
+    else
+    {
+        if (DELTA_AUTO_SIZE == options->codeSize)
+        {
+            coder->codeSize = ChooseCodeSize(coder, residuals, count);
+        }
+
+        block->codeSize = coder->codeSize;
+        ResetAdaptiveData(coder->data, block->codeSize);
+        codes.payload = payload;
+        codes.size = PAYLOAD_SIZE;
+        codes.length = 0;
+        codes.buffer = 0;
+        codes.bits = 0;
+        kernels[options->adapt.policy].Encode(coder, residuals, count,
+            &codes);
+        block->payload = EndCodes(&codes);
+    }
+
+    if (block->payload >= block->length)
+    {
+        /* incompressible; the prediction history is still updated */
+        block->codeSize = STORED_BLOCK;
+        block->payload = block->length;
+    }
+}
+
+/***************************************************************************
+*   Function   : DecodeBlock
+*   Description: This function decodes the payload of one channel's block
+*                and restores the channel's samples.
+*   Parameters : bfp - Pointer to the bit file positioned at the payload.
+*                stream - The settings from the stream header.
+*                kernel - The kernels for the stream's adaptation policy.
+*                channel - Pointer to the state of the block's channel.
+*                block - The block's header.  Its length must not be 0.
+*                residuals - Buffer used for the block's residuals.
+*                payload - Buffer of PAYLOAD_SIZE bytes used for payloads
+*                          coded in memory.
+*                plane - Buffer receiving the channel's samples.  It must
+*                        have room for a padded last sample.
+*   Effects    : The payload is read from bfp, block->length bytes of
+*                samples are written to plane, and the channel's state is
+*                moved to the end of the block.
+*   Returned   : 0 for success, -1 if the payload isn't valid.
+***************************************************************************/
+static int DecodeBlock(bit_file_t *bfp, const delta_options_t *stream,
+    const kernel_t *kernel, channel_t *channel, const block_header_t *block,
+    long *residuals, unsigned char *payload, unsigned char *plane)
+{
+    unsigned char sampleSize;
+    size_t count;
+    coder_t *coder;
+    code_reader_t codes;
+
+    sampleSize = stream->sampleSize;
+    coder = &(channel->coder);
+    SelectPredictor(channel->predictor, block->predictor);
+    count = (block->length + sampleSize - 1) / sampleSize;
+
+    if (STORED_BLOCK == block->codeSize)
+    {
+        if (0 != GetPayload(bfp, plane, block->length))
+        {
+            return -1;
+        }
+
+        /* keep the prediction history up to date for the next block */
+        PadSamples(plane, block->length, sampleSize);
+        PredictResiduals(channel->predictor, plane, count, residuals);
+        return 0;
+    }
+
+    if (0 != GetPayload(bfp, payload, block->payload))
+    {
+        return -1;
+    }
+
+    if (NULL != backends[stream->backend].Decode)
+    {
+        if (0 != backends[stream->backend].Decode(payload, block->payload,
+            coder->sampleBits, residuals, count))
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        ResetAdaptiveData(coder->data, block->codeSize);
+        coder->codeSize = block->codeSize;
+        coder->end = 0;
+        codes.payload = payload;
+        codes.length = block->payload;
+        codes.next = 0;
+        codes.buffer = 0;
+        codes.bits = 0;
+
+        kernel->Decode(coder, &codes, residuals, count);
+
+        if (EOF == coder->end)
+        {
+            /* the payload ended in the middle of the block */
+            return -1;
+        }
+    }
+
+    RestoreSamples(channel->predictor, residuals, count, plane);
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : BelowSpeed
+*   Description: This function checks if encoding is running slower than
+*                the requested minimum speed.
+*   Parameters : start - The processor time when encoding started.
+*                bytes - The number of bytes encoded since start.
+*                minSpeed - The minimum speed in MB/s, or 0 for none.
+*   Effects    : None
+*   Returned   : Non-zero if encoding is slower than minSpeed, otherwise 0.
+***************************************************************************/
+static int BelowSpeed(const clock_t start, const unsigned long bytes,
+    const unsigned int minSpeed)
+{
+    clock_t elapsed;
+
+    if (0 == minSpeed)
+    {
+        return 0;
+    }
+
+    elapsed = clock() - start;
+
+    if (elapsed <= 0)
+    {
+        return 0;
+    }
+
+    return ((double)bytes * CLOCKS_PER_SEC <
+        (double)minSpeed * 1e6 * elapsed);
+}
+
+/***************************************************************************
+*   Function   : WriteHeader
+*   Description: This function writes the stream header (magic, format
+*                version, sample size, channels, byte planes, image width,
+*                backend, and adaptation policy and parameters) to an
+*                encoded stream.
+*   Parameters : bfp - Pointer to the bit file receiving the header.
+*                stream - The settings for the stream.
+*   Effects    : The header is written to bfp.
+*   Returned   : None
+***************************************************************************/
+static void WriteHeader(bit_file_t *bfp, const delta_options_t *stream)
+{
+    const adapt_params_t *params;
+    int i;
+
+    params = &(stream->adapt);
+
+    for (i = 0; i < MAGIC_SIZE; i++)
+    {
+        BitFilePutChar(HEADER_MAGIC[i], bfp);
+    }
+
+    BitFilePutChar(FORMAT_VERSION, bfp);
+    BitFilePutChar(stream->sampleSize, bfp);
+    BitFilePutChar(stream->channels, bfp);
+    BitFilePutChar(0 != stream->planes, bfp);
+    BitFilePutChar(stream->width & 0xFF, bfp);
+    BitFilePutChar(stream->width >> 8, bfp);
+    BitFilePutChar(stream->isSigned, bfp);
+    BitFilePutChar(stream->maxError & 0xFF, bfp);
+    BitFilePutChar(stream->maxError >> 8, bfp);
+    BitFilePutChar(stream->backend, bfp);
+    BitFilePutChar(params->policy, bfp);
+    BitFilePutChar(params->maxOverflow, bfp);
+    BitFilePutChar(params->maxUnderflow, bfp);
+    BitFilePutChar(params->step, bfp);
+    BitFilePutChar(params->emaShift, bfp);
+    BitFilePutChar(params->windowSize, bfp);
+}
+
+/***************************************************************************
+*   Function   : ReadHeader
+*   Description: This function reads and validates the stream header of
+*                an encoded stream.
+*   Parameters : bfp - Pointer to the bit file containing the header.
+*                stream - Pointer to storage for the stream settings.  The
+*                         predictor and code size are set to defaults;
+*                         each block header has its own.
+*   Effects    : The header is read from bfp.
+*   Returned   : 0 for a valid header, -1 otherwise.
+***************************************************************************/
+static int ReadHeader(bit_file_t *bfp, delta_options_t *stream)
+{
+    int i, c;
+    unsigned char fields[HEADER_FIELDS];
+    adapt_params_t *params;
+
+    params = &(stream->adapt);
+
+    for (i = 0; i < MAGIC_SIZE; i++)
+    {
+        if (BitFileGetChar(bfp) != HEADER_MAGIC[i])
+        {
+            return -1;
+        }
+    }
+
+    if (BitFileGetChar(bfp) != FORMAT_VERSION)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < HEADER_FIELDS; i++)
+    {
+        if (EOF == (c = BitFileGetChar(bfp)))
+        {
+            return -1;
+        }
+
+        fields[i] = (unsigned char)c;
+    }
+
+    DeltaDefaultOptions(stream);
+    stream->sampleSize = fields[0];
+    stream->channels = fields[1];
+    stream->planes = fields[2];
+    stream->width = fields[3] | ((unsigned int)fields[4] << 8);
+    stream->isSigned = fields[5];
+    stream->maxError = fields[6] | ((unsigned long)fields[7] << 8);
+    stream->backend = (delta_backend_t)fields[8];
+    params->policy = (adapt_policy_t)fields[9];
+    params->maxOverflow = fields[10];
+    params->maxUnderflow = fields[11];
+    params->step = fields[12];
+    params->emaShift = fields[13];
+    params->windowSize = fields[14];
+
+    if (!ValidOptions(stream))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : WriteBlockHeader
+*   Description: This function writes a block header (predictor, starting
+*                code size, input length, payload length, and CRC) to an
+*                encoded stream.  Lengths are 16 bit little endian values
+*                and the CRC is a 32 bit little endian value.
+*   Parameters : bfp - Pointer to the bit file receiving the header.  It
+*                      must be byte aligned.
+*                block - The block header to write.
+*   Effects    : The block header is written to bfp.
+*   Returned   : None
+***************************************************************************/
+static void WriteBlockHeader(bit_file_t *bfp, const block_header_t *block)
+{
+    BitFilePutChar(block->predictor, bfp);
+    BitFilePutChar(block->codeSize, bfp);
+    BitFilePutChar(block->length & 0xFF, bfp);
+    BitFilePutChar(block->length >> 8, bfp);
+    BitFilePutChar(block->payload & 0xFF, bfp);
+    BitFilePutChar(block->payload >> 8, bfp);
+    BitFilePutChar(block->crc & 0xFF, bfp);
+    BitFilePutChar((block->crc >> 8) & 0xFF, bfp);
+    BitFilePutChar((block->crc >> 16) & 0xFF, bfp);
+    BitFilePutChar((block->crc >> 24) & 0xFF, bfp);
+}
+
+/***************************************************************************
+*   Function   : ReadBlockHeader
+*   Description: This function reads and validates a block header.
+*   Parameters : bfp - Pointer to the bit file containing the header.  It
+*                      must be byte aligned.
+*                stream - The settings from the stream header.
+*                block - Pointer to storage for the block header.
+*   Effects    : The block header is read from bfp.
+*   Returned   : 0 for a valid header, SYNC_POINT for the marker starting
+*                a resynchronization point, -1 otherwise.  A header with a
+*                length of 0 ends the stream.
+***************************************************************************/
+static int ReadBlockHeader(bit_file_t *bfp, const delta_options_t *stream,
+    block_header_t *block)
+{
+    int i, c;
+    unsigned char sampleSize;
+    unsigned char fields[BLOCK_HEADER_SIZE];
+
+    for (i = 0; i < BLOCK_HEADER_SIZE; i++)
+    {
+        if (EOF == (c = BitFileGetChar(bfp)))
+        {
+            return -1;
+        }
+
+        fields[i] = (unsigned char)c;
+    }
+
+    if (0 == memcmp(fields, syncMarker, BLOCK_HEADER_SIZE))
+    {
+        return SYNC_POINT;
+    }
+
+    block->predictor = (predictor_t)fields[0];
+    block->codeSize = fields[1];
+    block->length = fields[2] | ((unsigned int)fields[3] << 8);
+    block->payload = fields[4] | ((unsigned int)fields[5] << 8);
+    block->crc = fields[6] | ((unsigned long)fields[7] << 8) |
+        ((unsigned long)fields[8] << 16) | ((unsigned long)fields[9] << 24);
+
+    if (0 == block->length)
+    {
+        /* empty blocks are all 0, so a damaged length can't pass for one */
+        for (i = 0; i < BLOCK_HEADER_SIZE; i++)
+        {
+            if (0 != fields[i])
+            {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    sampleSize = stream->sampleSize;
+
+    /* a channel gets an equal share of every block of frames */
+    if ((block->predictor >= PREDICT_NUM_PREDICTORS) ||
+        ((0 == stream->width) && PredictorUsesRows(block->predictor)) ||
+        (block->length > ChannelLength(BlockSize(stream), stream, 0)))
+    {
+        return -1;
+    }
+
+    if (STORED_BLOCK == block->codeSize)
+    {
+        if (block->payload != block->length)
+        {
+            return -1;
+        }
+    }
+    else if (block->payload > PAYLOAD_SIZE)
+    {
+        return -1;
+    }
+    else if ((NULL == backends[stream->backend].Decode) &&
+        ((block->codeSize < MIN_CODE_SIZE) ||
+        (block->codeSize > 8 * sampleSize)))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : PutPayload
+*   Description: This function writes a block payload that was coded into
+*                memory to an encoded stream.
+*   Parameters : bfp - Pointer to the bit file receiving the payload.  It
+*                      must be byte aligned.
+*                payload - The payload bytes.
+*                length - The number of bytes in payload.
+*   Effects    : The payload is written to bfp.
+*   Returned   : None
+***************************************************************************/
+static void PutPayload(bit_file_t *bfp, const unsigned char *payload,
+    const size_t length)
+{
+    size_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        BitFilePutChar(payload[i], bfp);
+    }
+}
+
+/***************************************************************************
+*   Function   : GetPayload
+*   Description: This function reads a block payload from an encoded stream
+*                into memory.
+*   Parameters : bfp - Pointer to the bit file containing the payload.  It
+*                      must be byte aligned.
+*                payload - Buffer receiving the payload bytes.
+*                length - The number of bytes to read.
+*   Effects    : length bytes are read from bfp.
+*   Returned   : 0 for success, -1 if the stream ended early.
+***************************************************************************/
+static int GetPayload(bit_file_t *bfp, unsigned char *payload,
+    const size_t length)
+{
+    size_t i;
+    int c;
+
+    for (i = 0; i < length; i++)
+    {
+        if (EOF == (c = BitFileGetChar(bfp)))
+        {
+            return -1;
+        }
+
+        payload[i] = (unsigned char)c;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : SyncPointSize
+*   Description: This function computes the number of bytes a
+*                resynchronization point takes.
+*   Parameters : channels - Array of channel states.
+*                count - The number of channels.
+*   Effects    : None
+*   Returned   : The size of a resynchronization point, marker included.
+***************************************************************************/
+static size_t SyncPointSize(const channel_t *channels,
+    const unsigned char count)
+{
+    return BLOCK_HEADER_SIZE + SYNC_OFFSET_SIZE + SYNC_FIELD_SIZE +
+        count * (1 + SYNC_FIELD_SIZE +
+        PredictorStateSize(channels[0].predictor));
+}
+
+/***************************************************************************
+*   Function   : WriteSyncPoint
+*   Description: This function writes a resynchronization point, which
+*                holds everything needed to decode the rest of a stream
+*                without the blocks before it.
+*   Parameters : bfp - Pointer to the bit file receiving the point.  It
+*                      must be byte aligned.
+*                channels - Array of channel states.
+*                count - The number of channels.
+*                offset - The number of input bytes before the point.
+*                state - Buffer of PredictorStateSize bytes used for each
+*                        channel's saved state.
+*   Effects    : The resynchronization point is written to bfp.
+*   Returned   : None
+***************************************************************************/
+static void WriteSyncPoint(bit_file_t *bfp, const channel_t *channels,
+    const unsigned char count, const unsigned long offset,
+    unsigned char *state)
+{
+    unsigned char fields[SYNC_OFFSET_SIZE];
+    unsigned long crc;
+    size_t size;
+    unsigned char c;
+
+    PutPayload(bfp, syncMarker, BLOCK_HEADER_SIZE);
+    PutField(fields, offset, SYNC_OFFSET_SIZE);
+    PutPayload(bfp, fields, SYNC_OFFSET_SIZE);
+    crc = Crc32c(0, fields, SYNC_OFFSET_SIZE);
+    size = PredictorStateSize(channels[0].predictor);
+
+    for (c = 0; c < count; c++)
+    {
+        fields[0] = channels[c].coder.codeSize;
+        PutPayload(bfp, fields, 1);
+        crc = Crc32c(crc, fields, 1);
+
+        SavePredictorState(channels[c].predictor, state);
+        PutField(fields, size, SYNC_FIELD_SIZE);
+        PutPayload(bfp, fields, SYNC_FIELD_SIZE);
+        PutPayload(bfp, state, size);
+        crc = Crc32c(crc, fields, SYNC_FIELD_SIZE);
+        crc = Crc32c(crc, state, size);
+    }
+
+    PutField(fields, crc, SYNC_FIELD_SIZE);
+    PutPayload(bfp, fields, SYNC_FIELD_SIZE);
+}
+
+/***************************************************************************
+*   Function   : ReadSyncPoint
+*   Description: This function reads the resynchronization point following
+*                a marker and restores the channel states it holds.
+*   Parameters : bfp - Pointer to the bit file positioned just after the
+*                      marker.
+*                channels - Array of channel states.
+*                count - The number of channels.
+*                state - Buffer of PredictorStateSize bytes used for each
+*                        channel's saved state.
+*                offset - Pointer to storage for the number of input bytes
+*                         before the point.
+*   Effects    : The point is read from bfp and every channel continues
+*                from it.  Channels may be left partly restored on failure.
+*   Returned   : 0 for success, -1 if the point isn't valid.
+***************************************************************************/
+static int ReadSyncPoint(bit_file_t *bfp, channel_t *channels,
+    const unsigned char count, unsigned char *state, unsigned long *offset)
+{
+    unsigned char fields[SYNC_OFFSET_SIZE];
+    unsigned long crc, length;
+    size_t size;
+    unsigned char c;
+
+    if ((0 != GetPayload(bfp, fields, SYNC_OFFSET_SIZE)) ||
+        (0 != GetField(fields, SYNC_OFFSET_SIZE, offset)))
+    {
+        return -1;
+    }
+
+    crc = Crc32c(0, fields, SYNC_OFFSET_SIZE);
+    size = PredictorStateSize(channels[0].predictor);
+
+    for (c = 0; c < count; c++)
+    {
+        if ((0 != GetPayload(bfp, fields, 1)) ||
+            (fields[0] < MIN_CODE_SIZE) ||
+            (fields[0] > channels[c].coder.sampleBits))
+        {
+            return -1;
+        }
+
+        channels[c].coder.codeSize = fields[0];
+        crc = Crc32c(crc, fields, 1);
+
+        if ((0 != GetPayload(bfp, fields, SYNC_FIELD_SIZE)) ||
+            (0 != GetField(fields, SYNC_FIELD_SIZE, &length)) ||
+            (length != size) || (0 != GetPayload(bfp, state, size)) ||
+            (0 != LoadPredictorState(channels[c].predictor, state, size)))
+        {
+            return -1;
+        }
+
+        crc = Crc32c(crc, fields, SYNC_FIELD_SIZE);
+        crc = Crc32c(crc, state, size);
+    }
+
+    if ((0 != GetPayload(bfp, fields, SYNC_FIELD_SIZE)) ||
+        (0 != GetField(fields, SYNC_FIELD_SIZE, &length)) ||
+        (length != crc))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : FindSyncPoint
+*   Description: This function skips over damaged data to the next valid
+*                resynchronization point.
+*   Parameters : bfp - Pointer to the bit file containing the damage.
+*                channels - Array of channel states.
+*                count - The number of channels.
+*                state - Buffer of PredictorStateSize bytes used for each
+*                        channel's saved state.
+*                written - The number of bytes decoded so far.  Points
+*                          before this are skipped.
+*                offset - Pointer to storage for the number of input bytes
+*                         before the point that was found.
+*   Effects    : bfp is read through the point found, or to its end, and
+*                every channel continues from the point found.
+*   Returned   : 0 for success, -1 if the stream ends before a valid point.
+***************************************************************************/
+static int FindSyncPoint(bit_file_t *bfp, channel_t *channels,
+    const unsigned char count, unsigned char *state,
+    const unsigned long written, unsigned long *offset)
+{
+    unsigned char window[BLOCK_HEADER_SIZE];
+    size_t filled;
+    int c;
+
+    /* the damage may have left the bits backend in the middle of a byte */
+    BitFileByteAlign(bfp);
+    filled = 0;
+
+    while (EOF != (c = BitFileGetChar(bfp)))
+    {
+        if (BLOCK_HEADER_SIZE == filled)
+        {
+            memmove(window, window + 1, BLOCK_HEADER_SIZE - 1);
+            filled--;
+        }
+
+        window[filled++] = (unsigned char)c;
+
+        if ((BLOCK_HEADER_SIZE == filled) &&
+            (0 == memcmp(window, syncMarker, BLOCK_HEADER_SIZE)))
+        {
+            if ((0 == ReadSyncPoint(bfp, channels, count, state, offset)) &&
+                (*offset >= written))
+            {
+                return 0;
+            }
+
+            filled = 0;
+        }
+    }
+
+    return -1;
+}
+
+/***************************************************************************
+*   Function   : PutField
+*   Description: This function stores a value as a little endian field.
+*   Parameters : buffer - Buffer receiving the field.
+*                value - The value to store.
+*                size - The number of bytes in the field.
+*   Effects    : size bytes of buffer are written.  Bytes beyond an
+*                unsigned long are 0.
+*   Returned   : None
+***************************************************************************/
+static void PutField(unsigned char *buffer, unsigned long value,
+    const size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++)
+    {
+        buffer[i] = (unsigned char)(value & 0xFF);
+        value = (i < sizeof(unsigned long) - 1) ? value >> 8 : 0;
+    }
+}
+
+/***************************************************************************
+*   Function   : GetField
+*   Description: This function reads a little endian field written by
+*                PutField.
+*   Parameters : buffer - The field.
+*                size - The number of bytes in the field.
+*                value - Pointer to storage for the value.
+*   Effects    : value is set.
+*   Returned   : 0 for success, -1 if the value doesn't fit in an unsigned
+*                long.
+***************************************************************************/
+static int GetField(const unsigned char *buffer, const size_t size,
+    unsigned long *value)
+{
+    size_t i;
+
+    *value = 0;
+
+    for (i = size; i-- > 0; )
+    {
+        if (*value > (ULONG_MAX >> 8))
+        {
+            return -1;
+        }
+
+        *value = (*value << 8) | buffer[i];
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : SameStream
+*   Description: This function checks if two streams have the same stream
+*                header settings, so their blocks may be mixed.
+*   Parameters : a - The settings from one stream header.
+*                b - The settings from the other stream header.
+*   Effects    : None
+*   Returned   : Non-zero if the settings match, otherwise 0.
+***************************************************************************/
+static int SameStream(const delta_options_t *a, const delta_options_t *b)
+{
+    return ((a->sampleSize == b->sampleSize) &&
+        (a->channels == b->channels) && (a->planes == b->planes) &&
+        (a->width == b->width) && (a->isSigned == b->isSigned) &&
+        (a->maxError == b->maxError) && (a->backend == b->backend) &&
+        (a->adapt.policy == b->adapt.policy) &&
+        (a->adapt.maxOverflow == b->adapt.maxOverflow) &&
+        (a->adapt.maxUnderflow == b->adapt.maxUnderflow) &&
+        (a->adapt.step == b->adapt.step) &&
+        (a->adapt.emaShift == b->adapt.emaShift) &&
+        (a->adapt.windowSize == b->adapt.windowSize));
+}
+
+/***************************************************************************
+*   Function   : ResetChannels
+*   Description: This function returns the predictors of every channel to
+*                the state a stream starts in.
+*   Parameters : channels - Array of channel states.
+*                count - The number of channels.
+*   Effects    : Every channel's predictor is reset to PREDICT_PREVIOUS
+*                with an empty history.
+*   Returned   : None
+***************************************************************************/
+static void ResetChannels(channel_t *channels, const unsigned char count)
+{
+    unsigned char c;
+
+    for (c = 0; c < count; c++)
+    {
+        SelectPredictor(channels[c].predictor, PREDICT_PREVIOUS);
+        ResetPredictorData(channels[c].predictor);
+    }
+}
+
+/***************************************************************************
+*   Function   : CopyBlocks
+*   Description: This function copies the blocks and resynchronization
+*                points of an encoded stream without decoding them, up to
+*                the end of the stream or a point at or past a given
+*                offset.
+*   Parameters : in - Pointer to the bit file positioned after the stream
+*                     header.
+*                out - Pointer to the bit file receiving the copy.  It must
+*                      be byte aligned.
+*                stream - The settings from the stream header, with byte
+*                         planes split out (see UsePlanes).
+*                channels - Array of channel states, used to read and write
+*                           points.
+*                state - Buffer of PredictorStateSize bytes used for each
+*                        channel's saved state.
+*                shift - Added to the offset of every point copied.
+*                stop - Copying stops at the first point with an offset of
+*                       at least this.  ULONG_MAX to copy the whole stream.
+*                position - Pointer to the number of decoded bytes before
+*                           in's position.  It's moved past the blocks that
+*                           are copied.
+*   Effects    : Blocks and points are copied from in to out.  The block
+*                ending the stream isn't copied.  The point copying stops
+*                at is read into channels and isn't copied.
+*   Returned   : 0 at the end of the stream, SYNC_POINT at the point copying
+*                stopped at, -1 if the stream isn't valid.
+***************************************************************************/
+static int CopyBlocks(bit_file_t *in, bit_file_t *out,
+    const delta_options_t *stream, channel_t *channels, unsigned char *state,
+    const unsigned long shift, const unsigned long stop,
+    unsigned long *position)
+{
+    block_header_t block;
+    unsigned long offset;
+    unsigned int i;
+    unsigned char c;
+    int result, value;
+
+    for (;;)
+    {
+        result = ReadBlockHeader(in, stream, &block);
+
+        if (SYNC_POINT == result)
+        {
+            if ((0 != ReadSyncPoint(in, channels, stream->channels, state,
+                &offset)) || (offset != *position))
+            {
+                return -1;
+            }
+
+            if (offset >= stop)
+            {
+                return SYNC_POINT;
+            }
+
+            WriteSyncPoint(out, channels, stream->channels, offset + shift,
+                state);
+            continue;
+        }
+
+        if (0 != result)
+        {
+            return -1;
+        }
+
+        if (0 == block.length)
+        {
+            return 0;
+        }
+
+        for (c = 0; c < stream->channels; c++)
+        {
+            if ((0 != c) && (0 != ReadBlockHeader(in, stream, &block)))
+            {
+                return -1;
+            }
+
+            WriteBlockHeader(out, &block);
+            *position += block.length;
+
+            /* payload lengths are exact, so payloads copy as bytes */
+            for (i = 0; i < block.payload; i++)
+            {
+                if (EOF == (value = BitFileGetChar(in)))
+                {
+                    return -1;
+                }
+
+                BitFilePutChar(value, out);
+            }
+        }
+    }
+}
+
+/***************************************************************************
+*   Function   : WriteTrailer
+*   Description: This function writes the trailer that follows the block
+*                ending a stream.  It's a resynchronization point holding
+*                the state the encoder finished in.  Decoders stop at the
+*                end block, so they never read it.
+*   Parameters : bfp - Pointer to the bit file receiving the trailer.  It
+*                      must be byte aligned, after the end block.
+*                channels - Array of channel states.
+*                count - The number of channels.
+*                offset - The number of input bytes in the stream.
+*                state - Buffer of PredictorStateSize bytes used for each
+*                        channel's saved state.
+*   Effects    : The trailer is written to bfp.
+*   Returned   : None
+***************************************************************************/
+static void WriteTrailer(bit_file_t *bfp, const channel_t *channels,
+    const unsigned char count, const unsigned long offset,
+    unsigned char *state)
+{
+    WriteSyncPoint(bfp, channels, count, offset, state);
+}
+
+/***************************************************************************
+*   Function   : ReadTrailer
+*   Description: This function reads the trailer that follows the block
+*                ending a stream and restores the state it holds.
+*   Parameters : bfp - Pointer to the bit file positioned just after the end
+*                      block.
+*                stream - The settings from the stream header, with byte
+*                         planes split out (see UsePlanes).
+*                channels - Array of channel states.
+*                state - Buffer of PredictorStateSize bytes used for each
+*                        channel's saved state.
+*                offset - Pointer to storage for the number of input bytes
+*                         in the stream.
+*   Effects    : The trailer is read from bfp and every channel continues
+*                from it.  Channels may be left partly restored on failure.
+*   Returned   : 0 for success, -1 if the trailer isn't valid.
+***************************************************************************/
+static int ReadTrailer(bit_file_t *bfp, const delta_options_t *stream,
+    channel_t *channels, unsigned char *state, unsigned long *offset)
+{
+    block_header_t block;
+
+    if (SYNC_POINT != ReadBlockHeader(bfp, stream, &block))
+    {
+        return -1;
+    }
+
+    return ReadSyncPoint(bfp, channels, stream->channels, state, offset);
 }
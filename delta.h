@@ -33,17 +33,133 @@
 #ifndef _DELTA_H_
 #define _DELTA_H_
 
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include "adapt.h"
+#include "predict.h"
+
 /***************************************************************************
 *                                CONSTANTS
 ***************************************************************************/
+/* pass as codeSize to pick the starting code size by sampling the input */
+#define DELTA_AUTO_SIZE 0
+
+#define DELTA_DEFAULT_SIZE  6
+
+/* largest sample in bytes; samples must fit in an unsigned long */
+#define DELTA_MAX_SAMPLE_SIZE   (MAX_CODE_SIZE / 8)
+
+/* most interleaved channels in a stream */
+#define DELTA_MAX_CHANNELS      16
+
+/* widest image row in samples per channel */
+#define DELTA_MAX_WIDTH         65535U
+
+/* largest error allowed by lossy coding */
+#define DELTA_MAX_ERROR         65535UL
+
+/* DeltaDecodeFileOpt flags */
+#define DELTA_DECODE_NO_VERIFY  0x01    /* don't check block checksums */
+#define DELTA_DECODE_RESYNC     0x02    /* skip damage to the next sync */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/* how residuals are coded (values are stored in streams) */
+typedef enum
+{
+    DELTA_BACKEND_BITS = 0,     /* adaptive width code words */
+    DELTA_BACKEND_RANS = 1,     /* rANS with a frequency table per block */
+    DELTA_BACKEND_VARINT = 2,   /* zigzag group varints, byte aligned */
+    DELTA_BACKEND_PFOR = 3,     /* fixed width frames with patches */
+    DELTA_BACKEND_GORILLA = 4,  /* XOR residuals as meaningful bits */
+    DELTA_NUM_BACKENDS
+} delta_backend_t;
+
+typedef struct
+{
+    unsigned char codeSize;     /* starting code size or DELTA_AUTO_SIZE */
+    unsigned char sampleSize;   /* bytes per little endian sample */
+    unsigned char channels;     /* samples per interleaved frame; each
+                                 * channel is predicted and coded on its
+                                 * own */
+    unsigned char planes;       /* non-zero to code each byte of a sample
+                                 * as a channel of its own (byte planes) */
+    unsigned int width;         /* image row width in frames (pixels) for
+                                 * the row predictors, 0 if the samples
+                                 * aren't an image */
+    unsigned long maxError;     /* largest difference between a sample and
+                                 * its decoded value, 0 for lossless */
+    unsigned char isSigned;     /* non-zero if samples are two's
+                                 * complement; maxError bounds their
+                                 * values read this way */
+    predictor_t predictor;      /* residuals are from this prediction, or
+                                 * PREDICT_AUTO to pick it per block */
+    unsigned int minSpeed;      /* PREDICT_AUTO: MB/s below which blocks
+                                 * reuse the last predictor, 0 for none */
+    delta_backend_t backend;    /* how residuals are coded */
+    unsigned long syncInterval; /* frames between resynchronization
+                                 * points, 0 for none */
+    adapt_params_t adapt;       /* DELTA_BACKEND_BITS: rules for adapting
+                                 * the code size */
+} delta_options_t;
+
+/* an encoder fed input as it arrives (see DeltaEncoderOpen in delta.c) */
+typedef struct delta_encoder_t delta_encoder_t;
 
 /***************************************************************************
 *                               PROTOTYPES
 ***************************************************************************/
+/* fill in default encoding options */
+void DeltaDefaultOptions(delta_options_t *options);
+
  /* encode inFile */
 int DeltaEncodeFile(FILE *inFile, FILE *outFile, unsigned char codeSize);
+int DeltaEncodeFileOpt(FILE *inFile, FILE *outFile,
+    const delta_options_t *options);
+
+/* encode inFile onto the end of the encoded stream in outFile ("r+b") */
+int DeltaEncodeAppend(FILE *inFile, FILE *outFile,
+    const delta_options_t *options);
+
+/* encode input as it arrives, flushing whole frames on demand */
+delta_encoder_t *DeltaEncoderOpen(FILE *outFile,
+    const delta_options_t *options);
+delta_encoder_t *DeltaEncoderOpenAppend(FILE *outFile,
+    const delta_options_t *options);
+int DeltaEncoderWrite(delta_encoder_t *encoder, const unsigned char *buffer,
+    size_t length);
+int DeltaEncoderFlush(delta_encoder_t *encoder);
+int DeltaEncoderClose(delta_encoder_t *encoder);
+
+/* backend names for command lines and profiles */
+const char *DeltaBackendName(const delta_backend_t backend);
+int DeltaParseBackend(const char *text, delta_backend_t *backend);
+
+/* set the sample size, signedness, predictor, and backend for a named
+ * sample type (see DeltaSampleType in delta.c) */
+int DeltaSampleType(const char *text, delta_options_t *options);
+
+/* size in bits of the stream that encoding a buffer would produce */
+unsigned long DeltaCostBuffer(const unsigned char *buffer,
+    const size_t length, const delta_options_t *options);
+
+/* read/write encoding options from/to a profile file (see profile.c) */
+int DeltaLoadProfile(const char *fileName, delta_options_t *options);
+int DeltaSaveProfile(const char *fileName, const delta_options_t *options);
+
+/* decode inFile (starting code size is read from the stream) */
+int DeltaDecodeFile(FILE *inFile, FILE *outFile);
+int DeltaDecodeFileOpt(FILE *inFile, FILE *outFile,
+    const unsigned int flags);
 
-/* decode inFile*/
-int DeltaDecodeFile(FILE *inFile, FILE *outFile, unsigned char codeSize);
+/* join encoded streams, or split one at a resynchronization point, without
+ * decoding them */
+int DeltaConcatFiles(FILE *const *inFiles, const unsigned int count,
+    FILE *outFile);
+int DeltaSplitFile(FILE *inFile, FILE *headFile, FILE *tailFile,
+    unsigned long *offset);
 
 #endif  /* ndef _DELTA_H_ */
@@ -0,0 +1,280 @@
+/***************************************************************************
+*                 Adaptive Delta Coding Kernel Template
+*
+*   File    : deltakern.h
+*   Purpose : Template for the inner coding loops of the delta library.
+*             delta.c includes this file once for each adaptation policy
+*             with KERNEL_SUFFIX and KERNEL_UPDATE defined, so every loop
+*             calls its policy's update function directly instead of
+*             dispatching on the policy for every symbol.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Delta: An adaptive delta encoding/decoding library
+* Copyright (C) 2026 by
+*       Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the Delta library.
+*
+* Delta is free software; you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or (at your
+* option) any later version.
+*
+* Delta is distributed in the hope that it will be useful, but WITHOUT ANY
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+* License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+* Required definitions:
+*   KERNEL_SUFFIX - appended to the name of every generated function
+*   KERNEL_UPDATE - policy specific UpdateAdaptiveStatistics replacement
+*
+* Generated functions:
+*   Encode<KERNEL_SUFFIX> - code a buffer of residuals
+*   Cost<KERNEL_SUFFIX> - count the bits Encode<KERNEL_SUFFIX> would write
+*   Decode<KERNEL_SUFFIX> - decode a buffer of residuals
+***************************************************************************/
+#if !defined(KERNEL_SUFFIX) || !defined(KERNEL_UPDATE)
+#error "KERNEL_SUFFIX and KERNEL_UPDATE must be defined"
+#endif
+
+#define KERNEL_CAT(a, b)    a##b
+#define KERNEL_XCAT(a, b)   KERNEL_CAT(a, b)
+#define KERNEL_NAME(base)   KERNEL_XCAT(base, KERNEL_SUFFIX)
+
+/***************************************************************************
+*   Function   : Encode<KERNEL_SUFFIX>
+*   Description: This function codes a buffer of residuals, continuing from
+*                the state left by the last call.  A run of 0 residuals
+*                that would cost more than an escape, a 0 literal (which a
+*                0 residual never needs), and the run length is coded as
+*                those instead, and adapts the code size once.
+*   Parameters : coder - Pointer to the coding state.
+*                residuals - The residuals to be coded.
+*                count - The number of residuals.
+*                codes - Pointer to the codes receiving the residuals.
+*   Effects    : Codes for each residual are added to codes and coder is
+*                updated.
+*   Returned   : None
+***************************************************************************/
+static void KERNEL_NAME(Encode)(coder_t *coder, const long *residuals,
+    const size_t count, code_buffer_t *codes)
+{
+    adaptive_data_t *data;
+    unsigned char codeSize, newSize, width, sampleBits;
+    unsigned long code, escape;
+    size_t i, run, plain;
+
+    data = coder->data;
+    codeSize = coder->codeSize;
+    sampleBits = coder->sampleBits;
+    escape = EscapeCode(codeSize);
+    plain = 0;      /* residuals before this are coded one at a time */
+
+    for (i = 0; i < count; i++)
+    {
+        width = DeltaWidth(residuals[i]);
+        run = 0;
+
+        if ((0 == residuals[i]) && (i >= plain))
+        {
+            run = ZeroRun(residuals + i, count - i);
+            plain = i + run;
+
+            if (RunCost(codeSize, sampleBits, run) >= run * codeSize)
+            {
+                run = 0;
+            }
+        }
+
+        if (0 != run)
+        {
+            /* run of 0s: write min, a 0 literal, and the run length */
+            PutCodeBits(codes, escape, codeSize);
+            PutCodeBits(codes, 0, 1 + sampleBits);
+            PutRunLength(codes, run);
+            i += run - 1;
+        }
+        else if (width > codeSize)
+        {
+            /* overflow write min followed by the residual */
+            PutCodeBits(codes, escape, codeSize);
+            PutOverflow(codes, residuals[i], codeSize, sampleBits, width);
+        }
+        else
+        {
+            /* not an overflow.  output the low codeSize bits. */
+            code = (unsigned long)residuals[i] & CodeMask(codeSize);
+            PutCodeBits(codes, code, codeSize);
+        }
+
+        newSize = KERNEL_UPDATE(data, width);
+
+        if (newSize != codeSize)
+        {
+            /* update escape for the new code size */
+            codeSize = newSize;
+            escape = EscapeCode(codeSize);
+        }
+    }
+
+    coder->codeSize = codeSize;
+}
+
+/***************************************************************************
+*   Function   : Cost<KERNEL_SUFFIX>
+*   Description: This function counts the bits Encode<KERNEL_SUFFIX> would
+*                write for a buffer of residuals, making the same choices
+*                between runs, overflows, and code words without writing
+*                any of them.
+*   Parameters : coder - Pointer to the coding state.
+*                residuals - The residuals to be counted.
+*                count - The number of residuals.
+*   Effects    : coder's adaptive statistics are updated as they would be
+*                by coding the residuals.  Its code size isn't changed.
+*   Returned   : The number of bits in the codes for the residuals.
+***************************************************************************/
+static unsigned long KERNEL_NAME(Cost)(coder_t *coder, const long *residuals,
+    const size_t count)
+{
+    adaptive_data_t *data;
+    unsigned char codeSize, width, sampleBits;
+    unsigned long cost;
+    size_t i, run, plain;
+
+    data = coder->data;
+    codeSize = coder->codeSize;
+    sampleBits = coder->sampleBits;
+    cost = 0;
+    plain = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        width = DeltaWidth(residuals[i]);
+        run = 0;
+
+        if ((0 == residuals[i]) && (i >= plain))
+        {
+            run = ZeroRun(residuals + i, count - i);
+            plain = i + run;
+
+            if (RunCost(codeSize, sampleBits, run) >= run * codeSize)
+            {
+                run = 0;
+            }
+        }
+
+        if (0 != run)
+        {
+            cost += RunCost(codeSize, sampleBits, run);
+            i += run - 1;
+        }
+        else if (width > codeSize)
+        {
+            cost += OverflowCost(codeSize, sampleBits, width);
+        }
+        else
+        {
+            cost += codeSize;
+        }
+
+        codeSize = KERNEL_UPDATE(data, width);
+    }
+
+    return cost;
+}
+
+/***************************************************************************
+*   Function   : Decode<KERNEL_SUFFIX>
+*   Description: This function decodes residuals from a block's codes until
+*                it fills the residual buffer or reaches the end of the
+*                codes.  Runs of 0 residuals are filled in all at once.
+*   Parameters : coder - Pointer to the coding state.
+*                codes - Pointer to the codes to read.
+*                residuals - Buffer receiving the decoded residuals.
+*                count - The number of residuals the buffer holds.
+*   Effects    : residuals is filled in and coder is updated.  coder->end
+*                is set to EOF if the codes end first or a run doesn't fit
+*                in the buffer.
+*   Returned   : The number of residuals decoded.
+***************************************************************************/
+static size_t KERNEL_NAME(Decode)(coder_t *coder, code_reader_t *codes,
+    long *residuals, const size_t count)
+{
+    adaptive_data_t *data;
+    unsigned char codeSize, newSize, sampleBits;
+    unsigned long code;
+    long residual;
+    range_t range;
+    size_t i, run;
+    int escape;
+
+    data = coder->data;
+    codeSize = coder->codeSize;
+    sampleBits = coder->sampleBits;
+    range = MakeRange(codeSize);
+
+    for (i = 0; i < count; i++)
+    {
+        if (EOF == GetCodeBits(codes, codeSize, &code))
+        {
+            /* ran out of data without an end of stream marker */
+            coder->end = EOF;
+            break;
+        }
+
+        residual = SignExtend(code, codeSize);
+
+        if (residual == range.min)
+        {
+            /* overflow residual or a run of 0s */
+            escape = GetEscape(codes, codeSize, sampleBits, &residual);
+
+            if (ESCAPE_RUN == escape)
+            {
+                if ((0 != GetRunLength(codes, &run)) || (run > count - i))
+                {
+                    coder->end = EOF;
+                    break;
+                }
+
+                memset(residuals + i, 0, run * sizeof(long));
+                i += run - 1;
+                residual = 0;
+            }
+            else if (EOF == escape)
+            {
+                coder->end = EOF;
+                break;
+            }
+        }
+
+        residuals[i] = residual;
+        newSize = KERNEL_UPDATE(data, DeltaWidth(residual));
+
+        if (newSize != codeSize)
+        {
+            /* update range for the new code size */
+            codeSize = newSize;
+            range = MakeRange(codeSize);
+        }
+    }
+
+    coder->codeSize = codeSize;
+    return i;
+}
+
+#undef KERNEL_NAME
+#undef KERNEL_XCAT
+#undef KERNEL_CAT
+#undef KERNEL_UPDATE
+#undef KERNEL_SUFFIX
@@ -0,0 +1,393 @@
+/***************************************************************************
+*                     Delta Encoding XOR Residual Coder
+*
+*   File    : gorilla.c
+*   Purpose : Module that codes blocks of XOR residuals (the bits that
+*             changed from the last sample) the way Gorilla codes floating
+*             point time series: the count of leading and trailing zero
+*             bits, and only the meaningful bits between them.  It's meant
+*             for the xor predictor on float and double samples, whose
+*             arithmetic differences are as wide as the samples.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Delta: An adaptive delta encoding/decoding library
+* Copyright (C) 2026 by
+*       Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the Delta library.
+*
+* Delta is free software; you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or (at your
+* option) any later version.
+*
+* Delta is distributed in the hope that it will be useful, but WITHOUT ANY
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+* License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+* Each residual is coded from the bits of the sample (not zigzag mapped):
+*   0           - the residual is 0 (the sample repeated)
+*   10 bits     - the meaningful bits fit in the last window; only the
+*                 bits of the window follow
+*   11 lead len - a new window: the leading zero count, the number of
+*                 meaningful bits less 1, then the meaningful bits
+*
+* The counts take the bits needed for sampleBits - 1 (3 for bytes up to 6
+* for 64 bit samples).  Everything is packed LSB first with the payload
+* padded to a whole byte, and there's no window at the start of a block,
+* so blocks decode on their own.
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include "predict.h"
+#include "gorilla.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+/* most bits moved through the accumulator at once; with fewer than 8
+ * bits waiting, this fits an unsigned long of any legal size */
+#define CHUNK_BITS      24
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/* bits waiting to be written to a payload */
+typedef struct
+{
+    unsigned char *out;         /* next payload byte */
+    unsigned long buffer;       /* waiting bits, first bit lowest */
+    unsigned int bits;          /* bits in buffer (always fewer than 8) */
+} bit_writer_t;
+
+/* bits read from a payload but not yet used */
+typedef struct
+{
+    const unsigned char *in;    /* next payload byte */
+    const unsigned char *end;   /* end of the payload */
+    unsigned long buffer;       /* unused bits, next bit lowest */
+    unsigned int bits;          /* bits in buffer */
+} bit_reader_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static unsigned int FieldBits(const unsigned char sampleBits);
+static unsigned int LeadingZeros(unsigned long value,
+    const unsigned char sampleBits);
+static unsigned int TrailingZeros(unsigned long value);
+static void PutBits(bit_writer_t *writer, unsigned long value,
+    unsigned int count);
+static int GetBits(bit_reader_t *reader, const unsigned int count,
+    unsigned long *value);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : GorillaEncode
+*   Description: This function codes a block of XOR residuals as the
+*                meaningful bits of each, reusing the last window of
+*                leading and trailing zeros when the residual fits in it.
+*   Parameters : residuals - The residuals to code.
+*                count - The number of residuals.  It must not be 0.
+*                sampleBits - The number of bits in a sample.  Every
+*                             residual must fit in sampleBits bits.
+*                payload - Buffer receiving the coded block.  It must hold
+*                          GORILLA_MAX_PAYLOAD(count, sampleBits) bytes.
+*   Effects    : The coded block is written to payload.
+*   Returned   : The number of bytes in the coded block.
+***************************************************************************/
+size_t GorillaEncode(const long *residuals, const size_t count,
+    const unsigned char sampleBits, unsigned char *payload)
+{
+    bit_writer_t writer;
+    unsigned long mask, value;
+    unsigned int fieldBits, leading, trailing, lead, trail, meaningful;
+    size_t i;
+
+    writer.out = payload;
+    writer.buffer = 0;
+    writer.bits = 0;
+
+    /* shift in two steps so 64 bit samples don't shift by 64 */
+    mask = ((1UL << (sampleBits - 1)) << 1) - 1;
+    fieldBits = FieldBits(sampleBits);
+
+    /* no window yet; nothing has sampleBits leading zeros but 0 */
+    leading = sampleBits;
+    trailing = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        value = (unsigned long)residuals[i] & mask;
+
+        if (0 == value)
+        {
+            PutBits(&writer, 0, 1);
+            continue;
+        }
+
+        lead = LeadingZeros(value, sampleBits);
+        trail = TrailingZeros(value);
+
+        if ((lead >= leading) && (trail >= trailing))
+        {
+            /* 1 then 0, first bit lowest */
+            PutBits(&writer, 1, 2);
+        }
+        else
+        {
+            meaningful = sampleBits - lead - trail;
+            PutBits(&writer, 3, 2);
+            PutBits(&writer, lead, fieldBits);
+            PutBits(&writer, meaningful - 1, fieldBits);
+            leading = lead;
+            trailing = trail;
+        }
+
+        PutBits(&writer, value >> trailing, sampleBits - leading - trailing);
+    }
+
+    if (0 != writer.bits)
+    {
+        *writer.out++ = (unsigned char)writer.buffer;
+    }
+
+    return writer.out - payload;
+}
+
+/***************************************************************************
+*   Function   : GorillaDecode
+*   Description: This function decodes a block of residuals written by
+*                GorillaEncode.
+*   Parameters : payload - The coded block.
+*                length - The number of bytes in payload.
+*                sampleBits - The number of bits in a sample.
+*                residuals - Buffer receiving the residuals.
+*                count - The number of residuals to decode.
+*   Effects    : residuals is filled in.
+*   Returned   : 0 for success, -1 if the payload isn't a valid block of
+*                count residuals.
+***************************************************************************/
+int GorillaDecode(const unsigned char *payload, const size_t length,
+    const unsigned char sampleBits, long *residuals, const size_t count)
+{
+    bit_reader_t reader;
+    unsigned long bit, value, lead, meaningful;
+    unsigned int fieldBits, leading, trailing;
+    size_t i;
+
+    reader.in = payload;
+    reader.end = payload + length;
+    reader.buffer = 0;
+    reader.bits = 0;
+
+    fieldBits = FieldBits(sampleBits);
+    leading = sampleBits;
+    trailing = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        if (0 != GetBits(&reader, 1, &bit))
+        {
+            return -1;
+        }
+
+        if (0 == bit)
+        {
+            residuals[i] = 0;
+            continue;
+        }
+
+        if (0 != GetBits(&reader, 1, &bit))
+        {
+            return -1;
+        }
+
+        if (0 != bit)
+        {
+            /* a new window */
+            if ((0 != GetBits(&reader, fieldBits, &lead)) ||
+                (0 != GetBits(&reader, fieldBits, &meaningful)))
+            {
+                return -1;
+            }
+
+            meaningful++;
+
+            if (lead + meaningful > sampleBits)
+            {
+                return -1;
+            }
+
+            leading = (unsigned int)lead;
+            trailing = sampleBits - leading - (unsigned int)meaningful;
+        }
+        else if (leading == sampleBits)
+        {
+            /* reusing a window that was never set */
+            return -1;
+        }
+
+        if (0 != GetBits(&reader, sampleBits - leading - trailing, &value))
+        {
+            return -1;
+        }
+
+        residuals[i] = SignExtend(value << trailing, sampleBits);
+    }
+
+    /* only the padding of the last byte may be left */
+    return (reader.in == reader.end) ? 0 : -1;
+}
+
+/***************************************************************************
+*   Function   : FieldBits
+*   Description: This function computes the number of bits used for the
+*                leading zero and meaningful bit counts.
+*   Parameters : sampleBits - The number of bits in a sample.
+*   Effects    : None
+*   Returned   : The number of bits needed to hold sampleBits - 1.
+***************************************************************************/
+static unsigned int FieldBits(const unsigned char sampleBits)
+{
+    unsigned int bits, largest;
+
+    largest = sampleBits - 1;
+
+    for (bits = 0; 0 != largest; bits++)
+    {
+        largest >>= 1;
+    }
+
+    return bits;
+}
+
+/***************************************************************************
+*   Function   : LeadingZeros
+*   Description: This function counts the zero bits above the highest set
+*                bit of a sample.
+*   Parameters : value - The value to measure.  It must not be 0.
+*                sampleBits - The number of bits in a sample.
+*   Effects    : None
+*   Returned   : The number of leading zero bits in a sampleBits value.
+***************************************************************************/
+static unsigned int LeadingZeros(unsigned long value,
+    const unsigned char sampleBits)
+{
+    unsigned int width;
+
+    for (width = 0; 0 != value; width++)
+    {
+        value >>= 1;
+    }
+
+    return sampleBits - width;
+}
+
+/***************************************************************************
+*   Function   : TrailingZeros
+*   Description: This function counts the zero bits below the lowest set
+*                bit of a value.
+*   Parameters : value - The value to measure.  It must not be 0.
+*   Effects    : None
+*   Returned   : The number of trailing zero bits in value.
+***************************************************************************/
+static unsigned int TrailingZeros(unsigned long value)
+{
+    unsigned int zeros;
+
+    for (zeros = 0; 0 == (value & 1); zeros++)
+    {
+        value >>= 1;
+    }
+
+    return zeros;
+}
+
+/***************************************************************************
+*   Function   : PutBits
+*   Description: This function adds the low bits of a value to the bits
+*                waiting to be written, writing every whole byte.
+*   Parameters : writer - The bits waiting to be written.
+*                value - The value to write.
+*                count - The number of low bits of value to write.
+*   Effects    : Whole bytes are written to the payload and the rest are
+*                kept in writer.
+*   Returned   : None
+***************************************************************************/
+static void PutBits(bit_writer_t *writer, unsigned long value,
+    unsigned int count)
+{
+    unsigned int chunk;
+
+    for (; 0 != count; count -= chunk)
+    {
+        chunk = (count > CHUNK_BITS) ? CHUNK_BITS : count;
+        writer->buffer |= (value & ((1UL << chunk) - 1)) << writer->bits;
+        value >>= chunk;
+        writer->bits += chunk;
+
+        while (writer->bits >= 8)
+        {
+            *writer->out++ = (unsigned char)(writer->buffer & 0xFF);
+            writer->buffer >>= 8;
+            writer->bits -= 8;
+        }
+    }
+}
+
+/***************************************************************************
+*   Function   : GetBits
+*   Description: This function reads a value written by PutBits, loading
+*                payload bytes only as they're needed.
+*   Parameters : reader - The bits read but not yet used.
+*                count - The number of bits in the value.
+*                value - Set to the value read.
+*   Effects    : Bytes are read from the payload and the unused bits are
+*                kept in reader.
+*   Returned   : 0 for success, -1 if the payload ends first.
+***************************************************************************/
+static int GetBits(bit_reader_t *reader, const unsigned int count,
+    unsigned long *value)
+{
+    unsigned int got, chunk;
+
+    *value = 0;
+
+    for (got = 0; got < count; got += chunk)
+    {
+        chunk = (count - got > CHUNK_BITS) ? CHUNK_BITS : count - got;
+
+        while (reader->bits < chunk)
+        {
+            if (reader->in == reader->end)
+            {
+                return -1;
+            }
+
+            reader->buffer |= (unsigned long)(*reader->in++) << reader->bits;
+            reader->bits += 8;
+        }
+
+        *value |= (reader->buffer & ((1UL << chunk) - 1)) << got;
+        reader->buffer >>= chunk;
+        reader->bits -= chunk;
+    }
+
+    return 0;
+}
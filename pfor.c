@@ -0,0 +1,618 @@
+/***************************************************************************
+*              Delta Encoding Frame of Reference Residual Coder
+*
+*   File    : pfor.c
+*   Purpose : Module that codes blocks of residuals as frames of fixed
+*             width values with a patch list for the values that don't
+*             fit (PFor).  The width is picked once per frame instead of
+*             being adapted after every value, so decoding a frame is a
+*             plain unpacking loop.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Delta: An adaptive delta encoding/decoding library
+* Copyright (C) 2026 by
+*       Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the Delta library.
+*
+* Delta is free software; you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or (at your
+* option) any later version.
+*
+* Delta is distributed in the hope that it will be useful, but WITHOUT ANY
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+* License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+* Residuals are zigzag mapped and split into frames of PFOR_FRAME_SIZE
+* (the last frame may be shorter).  A frame is:
+*   width           - 1 byte, bits packed for every value
+*   exceptions      - 1 byte, number of values wider than width
+*   exception width - 1 byte, bits of the high part of each exception
+*                     (only when there are exceptions)
+*   values          - the low width bits of every value, packed LSB first
+*                     and padded to a whole byte
+*   positions       - 1 byte per exception, its index in the frame
+*   high parts      - each exception shifted right by width, packed LSB
+*                     first and padded to a whole byte
+*
+* The encoder picks the width that makes the frame smallest, so a few
+* outliers get patched instead of widening the whole frame.
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <string.h>
+#include <limits.h>
+#include "predict.h"
+#include "pfor.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+/* widest zigzag mapped value */
+#define MAX_WIDTH       64
+
+/* values up to 25 bits wide can be unpacked 8 at a time with AVX2's byte
+ * shuffles and variable shifts, which need GCC's target attribute and CPU
+ * detection; define DELTA_NO_SIMD to build with the bit loop only */
+#if defined(__GNUC__) && !defined(DELTA_NO_SIMD) && \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define SIMD_UNPACK
+#include <immintrin.h>
+#endif
+
+/* a value starts up to 7 bits into a byte and must end within the 4 byte
+ * lane it's shuffled into */
+#define MAX_LANE_WIDTH  25
+
+/* values in an AVX2 register of 4 byte lanes, which is also the number
+ * of values that end on a byte boundary whatever their width */
+#define LANES           8
+
+/***************************************************************************
+*                            GLOBAL VARIABLES
+***************************************************************************/
+#ifdef SIMD_UNPACK
+static int avx2Ready = 0;
+static int haveAvx2 = 0;        /* non-zero if AVX2 unpacking is used */
+#endif
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static unsigned int ValueWidth(unsigned long value);
+static size_t FrameSize(const size_t count, const unsigned int width,
+    const size_t exceptions, const unsigned int highWidth);
+static unsigned char *Pack(const unsigned long *values, const size_t count,
+    const unsigned int width, unsigned char *out);
+static const unsigned char *Unpack(const unsigned char *in,
+    const unsigned char *end, const size_t count, const unsigned int width,
+    unsigned long *values);
+
+#ifdef SIMD_UNPACK
+static int UseAvx2(void);
+static size_t UnpackVectors(const unsigned char *in,
+    const unsigned char *end, const size_t count, const unsigned int width,
+    unsigned long *values) __attribute__((target("avx2")));
+static size_t UnZigZagVectors(const unsigned long *values,
+    const size_t count, long *residuals) __attribute__((target("avx2")));
+#endif
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : PforEncode
+*   Description: This function codes a block of residuals as fixed width
+*                frames, picking the width of each frame to minimize its
+*                size.
+*   Parameters : residuals - The residuals to code.
+*                count - The number of residuals.  It must not be 0.
+*                sampleBits - The number of bits in a sample.  Every
+*                             residual must fit in sampleBits bits.
+*                payload - Buffer receiving the coded block.  It must hold
+*                          PFOR_MAX_PAYLOAD(count, sampleBits) bytes.
+*   Effects    : The coded block is written to payload.
+*   Returned   : The number of bytes in the coded block.
+***************************************************************************/
+size_t PforEncode(const long *residuals, const size_t count,
+    const unsigned char sampleBits, unsigned char *payload)
+{
+    unsigned long values[PFOR_FRAME_SIZE], highs[PFOR_FRAME_SIZE];
+    unsigned char widths[PFOR_FRAME_SIZE];
+    size_t histogram[MAX_WIDTH + 1];
+    size_t frame, size, i, exceptions, bytes, bestBytes;
+    unsigned int width, maxWidth, best;
+    unsigned char *out;
+
+    /* residuals fit in sampleBits, so every width does too */
+    (void)sampleBits;
+    out = payload;
+
+    for (frame = 0; frame < count; frame += size)
+    {
+        size = count - frame;
+        size = (size > PFOR_FRAME_SIZE) ? PFOR_FRAME_SIZE : size;
+
+        /* count the values of each width */
+        memset(histogram, 0, sizeof(histogram));
+        maxWidth = 0;
+
+        for (i = 0; i < size; i++)
+        {
+            values[i] = ZigZag(residuals[frame + i]);
+            width = ValueWidth(values[i]);
+            widths[i] = (unsigned char)width;
+            histogram[width]++;
+            maxWidth = (width > maxWidth) ? width : maxWidth;
+        }
+
+        /* the widest width never has exceptions; narrower ones are only
+         * used if they're strictly smaller */
+        best = maxWidth;
+        bestBytes = FrameSize(size, maxWidth, 0, 0);
+        exceptions = 0;
+
+        for (width = maxWidth; width-- > 0; )
+        {
+            exceptions += histogram[width + 1];
+            bytes = FrameSize(size, width, exceptions, maxWidth - width);
+
+            if (bytes < bestBytes)
+            {
+                best = width;
+                bestBytes = bytes;
+            }
+        }
+
+        exceptions = 0;
+
+        for (i = 0; i < size; i++)
+        {
+            if (widths[i] > best)
+            {
+                highs[exceptions++] = values[i] >> best;
+            }
+        }
+
+        *out++ = (unsigned char)best;
+        *out++ = (unsigned char)exceptions;
+
+        if (0 != exceptions)
+        {
+            *out++ = (unsigned char)(maxWidth - best);
+        }
+
+        out = Pack(values, size, best, out);
+
+        if (0 != exceptions)
+        {
+            for (i = 0; i < size; i++)
+            {
+                if (widths[i] > best)
+                {
+                    *out++ = (unsigned char)i;
+                }
+            }
+
+            out = Pack(highs, exceptions, maxWidth - best, out);
+        }
+    }
+
+    return out - payload;
+}
+
+/***************************************************************************
+*   Function   : PforDecode
+*   Description: This function decodes a block of residuals written by
+*                PforEncode.
+*   Parameters : payload - The coded block.
+*                length - The number of bytes in payload.
+*                sampleBits - The number of bits in a sample.
+*                residuals - Buffer receiving the residuals.
+*                count - The number of residuals to decode.
+*   Effects    : residuals is filled in.
+*   Returned   : 0 for success, -1 if the payload isn't a valid block of
+*                count residuals.
+***************************************************************************/
+int PforDecode(const unsigned char *payload, const size_t length,
+    const unsigned char sampleBits, long *residuals, const size_t count)
+{
+    unsigned long values[PFOR_FRAME_SIZE], highs[PFOR_FRAME_SIZE];
+    const unsigned char *in, *end, *positions;
+    size_t frame, size, i, exceptions;
+    unsigned int width, highWidth;
+
+    in = payload;
+    end = payload + length;
+
+    for (frame = 0; frame < count; frame += size)
+    {
+        size = count - frame;
+        size = (size > PFOR_FRAME_SIZE) ? PFOR_FRAME_SIZE : size;
+
+        if (end - in < 2)
+        {
+            return -1;
+        }
+
+        width = *in++;
+        exceptions = *in++;
+        highWidth = 0;
+
+        if (0 != exceptions)
+        {
+            if (in >= end)
+            {
+                return -1;
+            }
+
+            highWidth = *in++;
+        }
+
+        if ((width > sampleBits) || (exceptions > size) ||
+            (highWidth > sampleBits - width) ||
+            ((0 != exceptions) && (0 == highWidth)))
+        {
+            return -1;
+        }
+
+        if (NULL == (in = Unpack(in, end, size, width, values)))
+        {
+            return -1;
+        }
+
+        if (0 != exceptions)
+        {
+            if ((size_t)(end - in) < exceptions)
+            {
+                return -1;
+            }
+
+            positions = in;
+            in += exceptions;
+
+            if (NULL == (in = Unpack(in, end, exceptions, highWidth, highs)))
+            {
+                return -1;
+            }
+
+            /* patch in the high parts of the exceptions */
+            for (i = 0; i < exceptions; i++)
+            {
+                if (positions[i] >= size)
+                {
+                    return -1;
+                }
+
+                values[positions[i]] |= highs[i] << width;
+            }
+        }
+
+        i = 0;
+
+#ifdef SIMD_UNPACK
+        if (UseAvx2())
+        {
+            i = UnZigZagVectors(values, size, residuals + frame);
+        }
+#endif
+
+        for (; i < size; i++)
+        {
+            residuals[frame + i] = UnZigZag(values[i]);
+        }
+    }
+
+    return (in == end) ? 0 : -1;
+}
+
+/***************************************************************************
+*   Function   : ValueWidth
+*   Description: This function computes the number of bits needed to hold
+*                an unsigned value.
+*   Parameters : value - The value to measure.
+*   Effects    : None
+*   Returned   : The position of the highest set bit, or 0 if value is 0.
+***************************************************************************/
+static unsigned int ValueWidth(unsigned long value)
+{
+    unsigned int width;
+
+    for (width = 0; 0 != value; width++)
+    {
+        value >>= 1;
+    }
+
+    return width;
+}
+
+/***************************************************************************
+*   Function   : FrameSize
+*   Description: This function computes the number of bytes a frame takes
+*                for a given width.
+*   Parameters : count - The number of values in the frame.
+*                width - The bits packed for every value.
+*                exceptions - The number of values wider than width.
+*                highWidth - The bits packed for each exception's high
+*                            part.
+*   Effects    : None
+*   Returned   : The size of the frame in bytes.
+***************************************************************************/
+static size_t FrameSize(const size_t count, const unsigned int width,
+    const size_t exceptions, const unsigned int highWidth)
+{
+    size_t bytes;
+
+    bytes = 2 + (count * width + 7) / 8;
+
+    if (0 != exceptions)
+    {
+        bytes += 1 + exceptions + (exceptions * highWidth + 7) / 8;
+    }
+
+    return bytes;
+}
+
+/***************************************************************************
+*   Function   : Pack
+*   Description: This function packs the low bits of values LSB first and
+*                pads the result to a whole byte.
+*   Parameters : values - The values to pack.
+*                count - The number of values.
+*                width - The number of low bits of each value to pack.
+*                out - Buffer receiving the packed bytes.
+*   Effects    : (count * width + 7) / 8 bytes are written to out.
+*   Returned   : Pointer to the byte after the packed bytes.
+***************************************************************************/
+static unsigned char *Pack(const unsigned long *values, const size_t count,
+    const unsigned int width, unsigned char *out)
+{
+    unsigned long buffer, value;
+    unsigned int bits, left, chunk;
+    size_t i;
+
+    buffer = 0;
+    bits = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        value = values[i];
+
+        /* no more than a byte at a time so the buffer can't overflow */
+        for (left = width; 0 != left; left -= chunk)
+        {
+            chunk = (left > 8) ? 8 : left;
+            buffer |= (value & ((1UL << chunk) - 1)) << bits;
+            value >>= chunk;
+            bits += chunk;
+
+            if (bits >= 8)
+            {
+                *out++ = (unsigned char)(buffer & 0xFF);
+                buffer >>= 8;
+                bits -= 8;
+            }
+        }
+    }
+
+    if (0 != bits)
+    {
+        *out++ = (unsigned char)buffer;
+    }
+
+    return out;
+}
+
+/***************************************************************************
+*   Function   : Unpack
+*   Description: This function reverses Pack.
+*   Parameters : in - The packed bytes.
+*                end - The end of the buffer holding in.
+*                count - The number of values to unpack.
+*                width - The number of bits packed for each value.
+*                values - Buffer receiving the values.
+*   Effects    : values is filled in.
+*   Returned   : Pointer to the byte after the packed bytes, or NULL if
+*                the buffer ends first.
+***************************************************************************/
+static const unsigned char *Unpack(const unsigned char *in,
+    const unsigned char *end, const size_t count, const unsigned int width,
+    unsigned long *values)
+{
+    unsigned long value;
+    unsigned int got, chunk, offset;
+    size_t i, position;
+
+    if ((size_t)(end - in) < (count * width + 7) / 8)
+    {
+        return NULL;
+    }
+
+    i = 0;
+
+#ifdef SIMD_UNPACK
+    if ((0 != width) && (width <= MAX_LANE_WIDTH) && UseAvx2())
+    {
+        i = UnpackVectors(in, end, count, width, values);
+    }
+#endif
+
+    /* whatever the vectors left starts on a byte boundary */
+    position = i * width;
+
+    for (; i < count; i++)
+    {
+        value = 0;
+
+        for (got = 0; got < width; got += chunk)
+        {
+            offset = (unsigned int)(position % 8);
+            chunk = 8 - offset;
+            chunk = (chunk > width - got) ? width - got : chunk;
+            value |= ((unsigned long)(in[position / 8] >> offset) &
+                ((1UL << chunk) - 1)) << got;
+            position += chunk;
+        }
+
+        values[i] = value;
+    }
+
+    return in + (count * width + 7) / 8;
+}
+
+#ifdef SIMD_UNPACK
+/***************************************************************************
+*   Function   : UseAvx2
+*   Description: This function checks whether the processor has AVX2,
+*                which UnpackVectors needs.
+*   Parameters : None
+*   Effects    : The processor is checked on the first call.
+*   Returned   : Non-zero if UnpackVectors may be used.
+***************************************************************************/
+static int UseAvx2(void)
+{
+    if (!avx2Ready)
+    {
+        __builtin_cpu_init();
+        haveAvx2 = __builtin_cpu_supports("avx2");
+        avx2Ready = 1;
+    }
+
+    return haveAvx2;
+}
+
+/***************************************************************************
+*   Function   : UnpackVectors
+*   Description: This function does the work of Unpack for values up to
+*                MAX_LANE_WIDTH bits wide, LANES values at a time.  Each
+*                half of a register is loaded from where its first value
+*                starts, the bytes holding each value are shuffled into its
+*                lane, and every lane is shifted by its value's offset in
+*                its first byte and masked.  LANES values always take a
+*                whole number of bytes, so the same shuffle and shifts
+*                serve every step.  It stops where a load would read past
+*                end.  It must only be called if UseAvx2 returns non-zero.
+*   Parameters : in - The packed bytes.
+*                end - The end of the buffer holding in.
+*                count - The number of values to unpack.
+*                width - The number of bits packed for each value (1 -
+*                        MAX_LANE_WIDTH).
+*                values - Buffer receiving the values.
+*   Effects    : The first values are written.
+*   Returned   : The number of values unpacked, a multiple of LANES.
+***************************************************************************/
+static size_t UnpackVectors(const unsigned char *in,
+    const unsigned char *end, const size_t count, const unsigned int width,
+    unsigned long *values)
+{
+    unsigned char bytes[2 * LANES * 2];
+    int offsets[LANES];
+    __m256i shuffle, shifts, mask, lanes;
+    const unsigned char *next;
+    size_t i, half, start;
+    unsigned int k, j;
+
+    /* the second half starts at the byte holding value LANES / 2 */
+    half = (LANES / 2) * width / 8;
+
+    for (k = 0; k < LANES; k++)
+    {
+        start = k * width;
+        offsets[k] = (int)(start % 8);
+
+        for (j = 0; j < 4; j++)
+        {
+            bytes[4 * k + j] = (unsigned char)(start / 8 + j -
+                ((k < LANES / 2) ? 0 : half));
+        }
+    }
+
+    shuffle = _mm256_loadu_si256((const __m256i *)bytes);
+    shifts = _mm256_loadu_si256((const __m256i *)offsets);
+    mask = _mm256_set1_epi32((int)((1UL << width) - 1));
+
+    for (i = 0; i + LANES <= count; i += LANES)
+    {
+        /* each half loads 16 bytes */
+        next = in + i / LANES * width;
+
+        if ((size_t)(end - next) < half + 16)
+        {
+            break;
+        }
+
+        lanes = _mm256_inserti128_si256(_mm256_castsi128_si256(
+            _mm_loadu_si128((const __m128i *)next)),
+            _mm_loadu_si128((const __m128i *)(next + half)), 1);
+        lanes = _mm256_and_si256(_mm256_srlv_epi32(
+            _mm256_shuffle_epi8(lanes, shuffle), shifts), mask);
+
+#if (ULONG_MAX > 0xFFFFFFFFUL)
+        _mm256_storeu_si256((__m256i *)(values + i),
+            _mm256_cvtepu32_epi64(_mm256_castsi256_si128(lanes)));
+        _mm256_storeu_si256((__m256i *)(values + i + LANES / 2),
+            _mm256_cvtepu32_epi64(_mm256_extracti128_si256(lanes, 1)));
+#else
+        _mm256_storeu_si256((__m256i *)(values + i), lanes);
+#endif
+    }
+
+    return i;
+}
+
+/***************************************************************************
+*   Function   : UnZigZagVectors
+*   Description: This function reverses ZigZag for a register of values
+*                at a time.  x86 longs are two's complement, so the
+*                mapping is (value >> 1) ^ -(value & 1) in every lane.  It
+*                must only be called if UseAvx2 returns non-zero.
+*   Parameters : values - The zigzag mapped values.
+*                count - The number of values.
+*                residuals - Buffer receiving the residuals.
+*   Effects    : The first residuals are written.
+*   Returned   : The number of residuals written.
+***************************************************************************/
+static size_t UnZigZagVectors(const unsigned long *values,
+    const size_t count, long *residuals)
+{
+    __m256i lanes, zero, one;
+    size_t i, step;
+
+    step = sizeof(__m256i) / sizeof(unsigned long);
+    zero = _mm256_setzero_si256();
+
+    for (i = 0; i + step <= count; i += step)
+    {
+        lanes = _mm256_loadu_si256((const __m256i *)(values + i));
+
+#if (ULONG_MAX > 0xFFFFFFFFUL)
+        one = _mm256_set1_epi64x(1);
+        lanes = _mm256_xor_si256(_mm256_srli_epi64(lanes, 1),
+            _mm256_sub_epi64(zero, _mm256_and_si256(lanes, one)));
+#else
+        one = _mm256_set1_epi32(1);
+        lanes = _mm256_xor_si256(_mm256_srli_epi32(lanes, 1),
+            _mm256_sub_epi32(zero, _mm256_and_si256(lanes, one)));
+#endif
+
+        _mm256_storeu_si256((__m256i *)(residuals + i), lanes);
+    }
+
+    return i;
+}
+#endif
@@ -0,0 +1,1568 @@
+/***************************************************************************
+*                  Delta Encoding Sample Prediction Module
+*
+*   File    : predict.c
+*   Purpose : Module containing the predictors used ahead of residual
+*             coding.  Each sample is predicted from the samples before it
+*             and only the difference (residual) is coded, so the better
+*             the prediction the smaller the code words.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Delta: An adaptive delta encoding/decoding library
+* Copyright (C) 2026 by
+*       Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the Delta library.
+*
+* Delta is free software; you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or (at your
+* option) any later version.
+*
+* Delta is distributed in the hope that it will be useful, but WITHOUT ANY
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+* License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+* All sample arithmetic is done modulo 2^(sample bits) in unsigned longs,
+* so predictions may wrap without undefined behavior and the encoder and
+* decoder always agree.  Residuals are the wrapped difference between a
+* sample and its prediction, sign extended to a long.  PREDICT_XOR is the
+* exception: its residual is the exclusive or of a sample and the last
+* one, which keeps the sign, exponent, and high mantissa bits of slowly
+* changing floating point values at 0 where a difference wouldn't.
+*
+* PREDICT_PERIOD is for timestamps that are mostly exactly periodic: it
+* predicts the last sample plus the nominal period.  The period is the
+* last step between samples that was the same twice in a row, so it's
+* tracked by the encoder and decoder alike and never stored.  A late
+* sample or a gap changes one step, or two steps by different amounts, so
+* it codes as one or two residuals without disturbing the period, where
+* PREDICT_LINEAR would take up the jittered step and miss the next sample
+* as well.  Runs of perfectly periodic samples are runs of 0 residuals,
+* and RestoreSamples writes them as an arithmetic sequence.
+*
+* With a maximum error (SetPredictorError), prediction is lossy: the
+* difference between a sample and its prediction is quantized to a
+* multiple of 2 x maxError + 1, and the residual is the multiple.  The
+* rebuilt sample is clamped to the range of a sample, which only moves it
+* closer to the real one, so it's always within maxError.  The history
+* holds the rebuilt samples, not the real ones, so the encoder predicts
+* from what the decoder will see and errors never add up.  This is done in
+* the sample's integer value (signed or not), so samples must be narrower
+* than a long.
+*
+* The row predictors treat samples as rows of an image, width samples
+* wide.  The last width + 1 samples are kept in a ring, so the sample
+* above (up) and the one above and to the left are at fixed offsets from
+* the ring position.  At the start of a row the left and up left samples
+* are taken to be up, and rows above the first are all 0, as in PNG.
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "predict.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+/* history kept for the fixed polynomial predictors */
+#define FIXED_ORDER     4
+
+/* PREDICT_LMS filter: taps, weight fraction bits, adaptation step, and
+ * weight limit */
+#define LMS_ORDER       4
+#define LMS_SHIFT       12
+#define LMS_RATE        16
+#define LMS_LIMIT       (4L << LMS_SHIFT)
+
+#define ULONG_BITS      (sizeof(unsigned long) * CHAR_BIT)
+
+/* bytes used by each LMS weight and ring index in a saved state */
+#define STATE_FIELD_SIZE    4
+
+/* runs of periodic samples can be written a register at a time with AVX2
+ * adds, which need GCC's target attribute and CPU detection; define
+ * DELTA_NO_SIMD to build with the sample loop only */
+#if defined(__GNUC__) && !defined(DELTA_NO_SIMD) && \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define SIMD_RUNS
+#include <immintrin.h>
+#endif
+
+/* bytes in an AVX2 register */
+#define VECTOR_SIZE         32
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+struct predictor_data_t
+{
+    predictor_t predictor;
+    unsigned char sampleSize;   /* bytes per sample */
+    unsigned char sampleBits;   /* bits per sample */
+    unsigned long mask;         /* bits used by a sample */
+
+    /* fixed predictors: prediction is sum of coefficient x history */
+    const long *coefficients;
+    unsigned long history[FIXED_ORDER];     /* newest sample first */
+    unsigned long period;                   /* last step seen twice */
+
+    /* PREDICT_LMS: prediction is last sample + filtered differences */
+    long steps[LMS_ORDER];                  /* newest difference first */
+    long weights[LMS_ORDER];                /* << LMS_SHIFT */
+
+    /* row predictors: last width + 1 samples, allocated once */
+    unsigned long *rows;                    /* NULL if width is 0 */
+    size_t width;                           /* samples per row */
+    size_t position;                        /* ring slot of up left */
+    size_t column;                          /* column of the next sample */
+
+    /* lossy prediction: residuals count steps of 2 x maxError + 1 */
+    long step;                              /* 1 if lossless */
+    long limit;                             /* most steps that stay in range */
+    long low;                               /* smallest sample value */
+    long high;                              /* largest sample value */
+    int isSigned;                           /* samples are two's complement */
+};
+
+/* names accepted for each predictor; the first name listed is used when
+ * naming a predictor */
+typedef struct
+{
+    const char *name;
+    predictor_t predictor;
+} predictor_name_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static unsigned long GetSample(const unsigned char *buffer,
+    const unsigned char sampleSize);
+static void PutSample(unsigned long value, const unsigned char sampleSize,
+    unsigned char *buffer);
+static unsigned char *PutSamples(const unsigned long *values,
+    const size_t count, const unsigned char sampleSize,
+    unsigned char *state);
+static const unsigned char *GetSamples(unsigned long *values,
+    const size_t count, const unsigned char sampleSize,
+    const unsigned char *state);
+static unsigned long PredictFixed(const predictor_data_t *data);
+static void UpdatePeriod(predictor_data_t *data, const unsigned long value);
+static void RestoreRun(predictor_data_t *data, const size_t run,
+    unsigned char *samples);
+
+#ifdef SIMD_RUNS
+static int UseAvx2(void);
+static size_t RestoreRunVectors(const predictor_data_t *data,
+    const size_t run, unsigned char *samples)
+    __attribute__((target("avx2")));
+#endif
+static int IsByteDelta(const predictor_data_t *data);
+static void UpdateBytes(predictor_data_t *data, const unsigned char *samples,
+    const size_t count);
+static unsigned long PredictLms(const predictor_data_t *data);
+static unsigned long PredictRow(const predictor_data_t *data);
+static void UpdateRows(predictor_data_t *data, const unsigned long value);
+static void UpdateLms(predictor_data_t *data, const unsigned long value,
+    const long residual);
+static long SampleValue(const predictor_data_t *data,
+    const unsigned long sample);
+static unsigned long Quantize(const predictor_data_t *data,
+    const unsigned long value, const unsigned long predicted,
+    long *residual);
+static unsigned long Dequantize(const predictor_data_t *data,
+    const unsigned long predicted, long residual);
+
+/***************************************************************************
+*                            GLOBAL VARIABLES
+***************************************************************************/
+/* fixed polynomial coefficients for the last FIXED_ORDER samples, indexed
+ * by predictor_t (PREDICT_LMS, the row predictors, PREDICT_XOR, and
+ * PREDICT_PERIOD use the PREDICT_PREVIOUS row) */
+static const long fixedCoefficients[PREDICT_NUM_PREDICTORS][FIXED_ORDER] =
+{
+    {1, 0, 0, 0},           /* PREDICT_PREVIOUS */
+    {2, -1, 0, 0},          /* PREDICT_LINEAR */
+    {0, 0, 0, 0},           /* PREDICT_FIXED0 */
+    {3, -3, 1, 0},          /* PREDICT_FIXED3 */
+    {4, -6, 4, -1},         /* PREDICT_FIXED4 */
+    {1, 0, 0, 0},           /* PREDICT_LMS */
+    {1, 0, 0, 0},           /* PREDICT_UP */
+    {1, 0, 0, 0},           /* PREDICT_AVERAGE */
+    {1, 0, 0, 0},           /* PREDICT_PAETH */
+    {1, 0, 0, 0},           /* PREDICT_XOR */
+    {1, 0, 0, 0}            /* PREDICT_PERIOD */
+};
+
+static const predictor_name_t predictorNames[] =
+{
+    {"delta", PREDICT_PREVIOUS},
+    {"delta2", PREDICT_LINEAR},
+    {"fixed0", PREDICT_FIXED0},
+    {"fixed3", PREDICT_FIXED3},
+    {"fixed4", PREDICT_FIXED4},
+    {"lms", PREDICT_LMS},
+    {"up", PREDICT_UP},
+    {"average", PREDICT_AVERAGE},
+    {"paeth", PREDICT_PAETH},
+    {"xor", PREDICT_XOR},
+    {"period", PREDICT_PERIOD},
+    {"previous", PREDICT_PREVIOUS},
+    {"fixed1", PREDICT_PREVIOUS},
+    {"linear", PREDICT_LINEAR},
+    {"fixed2", PREDICT_LINEAR},
+    {"auto", PREDICT_AUTO},
+    {NULL, PREDICT_NUM_PREDICTORS}
+};
+
+#ifdef SIMD_RUNS
+static int avx2Ready = 0;
+static int haveAvx2 = 0;        /* non-zero if AVX2 runs are used */
+#endif
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : CreatePredictorData
+*   Description: This function creates the state used by a predictor.
+*   Parameters : predictor - The predictor to create state for.
+*                sampleSize - The number of bytes in a sample.
+*   Effects    : The predictor state is created on the heap.
+*   Returned   : A pointer to the created state on success, otherwise NULL.
+***************************************************************************/
+predictor_data_t *CreatePredictorData(const predictor_t predictor,
+    const unsigned char sampleSize)
+{
+    predictor_data_t *data;
+
+    if ((predictor >= PREDICT_NUM_PREDICTORS) || (0 == sampleSize) ||
+        (sampleSize > sizeof(unsigned long)))
+    {
+        return NULL;
+    }
+
+    data = malloc(sizeof(predictor_data_t));
+
+    if (NULL != data)
+    {
+        data->predictor = predictor;
+        data->sampleSize = sampleSize;
+        data->sampleBits = 8 * sampleSize;
+        data->mask = (data->sampleBits >= ULONG_BITS) ? ~0UL :
+            (1UL << data->sampleBits) - 1;
+        data->coefficients = fixedCoefficients[predictor];
+        data->rows = NULL;
+        data->width = 0;
+        data->step = 1;
+        data->isSigned = 0;
+        ResetPredictorData(data);
+    }
+
+    return data;
+}
+
+/***************************************************************************
+*   Function   : ResetPredictorData
+*   Description: This function returns a predictor to its starting state,
+*                as if every earlier sample was 0.
+*   Parameters : data - pointer to the predictor state to reset.
+*   Effects    : History, rows, and filter weights are cleared.
+*   Returned   : None
+***************************************************************************/
+void ResetPredictorData(predictor_data_t *data)
+{
+    memset(data->history, 0, sizeof(data->history));
+    data->period = 0;
+    memset(data->steps, 0, sizeof(data->steps));
+    memset(data->weights, 0, sizeof(data->weights));
+    data->position = 0;
+    data->column = 0;
+
+    if (NULL != data->rows)
+    {
+        memset(data->rows, 0, (data->width + 1) * sizeof(unsigned long));
+    }
+}
+
+/***************************************************************************
+*   Function   : SetPredictorWidth
+*   Description: This function sets the image row width used by the row
+*                predictors and allocates the ring of samples they predict
+*                from.  The ring is reused for every row, so it's only
+*                allocated here.
+*   Parameters : data - pointer to the predictor state.
+*                width - the number of samples in a row, or 0 if the
+*                        samples aren't an image.
+*   Effects    : The predictor state is reset and its ring is replaced.
+*   Returned   : 0 for success, -1 if the ring can't be allocated.
+***************************************************************************/
+int SetPredictorWidth(predictor_data_t *data, const size_t width)
+{
+    unsigned long *rows;
+
+    rows = NULL;
+
+    if (0 != width)
+    {
+        rows = malloc((width + 1) * sizeof(unsigned long));
+
+        if (NULL == rows)
+        {
+            return -1;
+        }
+    }
+
+    free(data->rows);
+    data->rows = rows;
+    data->width = width;
+    ResetPredictorData(data);
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : SetPredictorError
+*   Description: This function makes prediction lossy, rebuilding each
+*                sample to within a maximum error instead of exactly.
+*   Parameters : data - pointer to the predictor state.
+*                maxError - the largest difference allowed between a
+*                           sample and its rebuilt value, or 0 for
+*                           lossless prediction.
+*                isSigned - non-zero if samples are two's complement,
+*                           otherwise they're unsigned.  The error is
+*                           bounded for values read this way.
+*   Effects    : The predictor state is reset.
+*   Returned   : 0 for success, -1 if maxError isn't 0 and samples aren't
+*                narrower than a long, or maxError is too large.
+***************************************************************************/
+int SetPredictorError(predictor_data_t *data, const unsigned long maxError,
+    const int isSigned)
+{
+    unsigned long range;
+
+    data->step = 1;
+    data->isSigned = 0;
+    ResetPredictorData(data);
+
+    if (0 == maxError)
+    {
+        return 0;
+    }
+
+    if ((data->sampleBits >= ULONG_BITS) ||
+        (maxError > (unsigned long)(LONG_MAX / 4)))
+    {
+        return -1;
+    }
+
+    /* samples are narrower than a long, so every value fits in one */
+    range = data->mask;
+    data->isSigned = isSigned;
+    data->low = isSigned ? -(long)(range / 2) - 1 : 0;
+    data->high = isSigned ? (long)(range / 2) : (long)range;
+    data->step = 2 * (long)maxError + 1;
+    data->limit = (long)(range / (unsigned long)data->step) + 1;
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : PredictorUsesRows
+*   Description: This function checks if a predictor needs an image row
+*                width (see SetPredictorWidth).
+*   Parameters : predictor - the predictor to check.
+*   Effects    : None
+*   Returned   : Non-zero for the row predictors, otherwise 0.
+***************************************************************************/
+int PredictorUsesRows(const predictor_t predictor)
+{
+    return ((PREDICT_UP == predictor) || (PREDICT_AVERAGE == predictor) ||
+        (PREDICT_PAETH == predictor));
+}
+
+/***************************************************************************
+*   Function   : SelectPredictor
+*   Description: This function switches predictor state to a different
+*                predictor.  The sample history is kept, so the new
+*                predictor continues from the samples already seen.
+*                PREDICT_LMS filter weights are only adapted while it's
+*                selected, and its differences are rebuilt from the history
+*                when it's selected again.
+*   Parameters : data - pointer to the predictor state to switch.
+*                predictor - the predictor to use from now on.  It must not
+*                            be PREDICT_AUTO.
+*   Effects    : The predictor is changed.
+*   Returned   : None
+***************************************************************************/
+void SelectPredictor(predictor_data_t *data, const predictor_t predictor)
+{
+    int i;
+
+    if ((PREDICT_LMS == predictor) && (PREDICT_LMS != data->predictor))
+    {
+        /* the oldest difference is older than the history */
+        for (i = 0; i < LMS_ORDER - 1; i++)
+        {
+            data->steps[i] = SignExtend(
+                (data->history[i] - data->history[i + 1]) & data->mask,
+                data->sampleBits);
+        }
+
+        data->steps[LMS_ORDER - 1] = 0;
+    }
+
+    data->predictor = predictor;
+    data->coefficients = fixedCoefficients[predictor];
+}
+
+/***************************************************************************
+*   Function   : CopyPredictorData
+*   Description: This function copies the state of one predictor to
+*                another, so predictions may be tried without disturbing
+*                the original.
+*   Parameters : dest - pointer to the predictor state to overwrite.
+*                src - pointer to the predictor state to copy.  Both must
+*                      be for the same sample size and row width.
+*   Effects    : dest becomes a copy of src.  dest keeps its own ring.
+*   Returned   : None
+***************************************************************************/
+void CopyPredictorData(predictor_data_t *dest, const predictor_data_t *src)
+{
+    unsigned long *rows;
+
+    rows = dest->rows;
+    *dest = *src;
+    dest->rows = rows;
+
+    if (NULL != rows)
+    {
+        memcpy(rows, src->rows, (src->width + 1) * sizeof(unsigned long));
+    }
+}
+
+/***************************************************************************
+*   Function   : PredictorStateSize
+*   Description: This function computes the number of bytes
+*                SavePredictorState writes for a predictor.
+*   Parameters : data - pointer to the predictor state.
+*   Effects    : None
+*   Returned   : The size of the saved state.  It depends only on the
+*                sample size and row width.
+***************************************************************************/
+size_t PredictorStateSize(const predictor_data_t *data)
+{
+    size_t size;
+
+    /* predictor, history, period, LMS differences, and LMS weights */
+    size = 1 + (FIXED_ORDER + 1 + LMS_ORDER) * (size_t)data->sampleSize +
+        LMS_ORDER * STATE_FIELD_SIZE;
+
+    if (NULL != data->rows)
+    {
+        /* ring position, column, and ring */
+        size += 2 * STATE_FIELD_SIZE + (data->width + 1) * data->sampleSize;
+    }
+
+    return size;
+}
+
+/***************************************************************************
+*   Function   : SavePredictorState
+*   Description: This function writes everything a predictor carries from
+*                one sample to the next as bytes, so that a decoder can
+*                continue from the same point without the samples before
+*                it.  The sample size, row width, and lossy settings are
+*                fixed for a stream, so they aren't saved.
+*   Parameters : data - pointer to the predictor state to save.
+*                state - buffer receiving PredictorStateSize(data) bytes.
+*   Effects    : state is filled in.  Multi-byte values are little
+*                endian.
+*   Returned   : None
+***************************************************************************/
+void SavePredictorState(const predictor_data_t *data, unsigned char *state)
+{
+    unsigned long values[LMS_ORDER];
+    int i;
+
+    *state++ = (unsigned char)data->predictor;
+    state = PutSamples(data->history, FIXED_ORDER, data->sampleSize, state);
+    state = PutSamples(&(data->period), 1, data->sampleSize, state);
+
+    for (i = 0; i < LMS_ORDER; i++)
+    {
+        values[i] = (unsigned long)data->steps[i] & data->mask;
+    }
+
+    state = PutSamples(values, LMS_ORDER, data->sampleSize, state);
+
+    for (i = 0; i < LMS_ORDER; i++)
+    {
+        /* weights are limited to LMS_LIMIT, so 4 bytes always hold them */
+        values[i] = (unsigned long)data->weights[i];
+    }
+
+    state = PutSamples(values, LMS_ORDER, STATE_FIELD_SIZE, state);
+
+    if (NULL != data->rows)
+    {
+        values[0] = data->position;
+        values[1] = data->column;
+        state = PutSamples(values, 2, STATE_FIELD_SIZE, state);
+        PutSamples(data->rows, data->width + 1, data->sampleSize, state);
+    }
+}
+
+/***************************************************************************
+*   Function   : LoadPredictorState
+*   Description: This function reverses SavePredictorState.
+*   Parameters : data - pointer to the predictor state to overwrite.  It
+*                       must have the sample size and row width of the
+*                       predictor that was saved.
+*                state - the saved state.
+*                length - the number of bytes in state.
+*   Effects    : data continues from the point state was saved at.  data
+*                may be left partly overwritten on failure.
+*   Returned   : 0 for success, -1 if state isn't a valid saved state for
+*                data.
+***************************************************************************/
+int LoadPredictorState(predictor_data_t *data, const unsigned char *state,
+    const size_t length)
+{
+    unsigned long values[LMS_ORDER];
+    long weight;
+    int i;
+
+    if ((length != PredictorStateSize(data)) ||
+        (*state >= PREDICT_NUM_PREDICTORS) ||
+        ((NULL == data->rows) && PredictorUsesRows((predictor_t)*state)))
+    {
+        return -1;
+    }
+
+    data->predictor = (predictor_t)*state++;
+    data->coefficients = fixedCoefficients[data->predictor];
+    state = GetSamples(data->history, FIXED_ORDER, data->sampleSize, state);
+    state = GetSamples(&(data->period), 1, data->sampleSize, state);
+    state = GetSamples(values, LMS_ORDER, data->sampleSize, state);
+
+    for (i = 0; i < LMS_ORDER; i++)
+    {
+        data->steps[i] = SignExtend(values[i], data->sampleBits);
+    }
+
+    state = GetSamples(values, LMS_ORDER, STATE_FIELD_SIZE, state);
+
+    for (i = 0; i < LMS_ORDER; i++)
+    {
+        weight = SignExtend(values[i], 8 * STATE_FIELD_SIZE);
+
+        if ((weight > LMS_LIMIT) || (weight < -LMS_LIMIT))
+        {
+            return -1;
+        }
+
+        data->weights[i] = weight;
+    }
+
+    if (NULL != data->rows)
+    {
+        state = GetSamples(values, 2, STATE_FIELD_SIZE, state);
+
+        if ((values[0] > data->width) || (values[1] >= data->width))
+        {
+            return -1;
+        }
+
+        data->position = values[0];
+        data->column = values[1];
+        GetSamples(data->rows, data->width + 1, data->sampleSize, state);
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : FreePredictorData
+*   Description: This function frees the state used by a predictor.
+*   Parameters : data - pointer to the predictor state to free.
+*   Effects    : The predictor state is freed.
+*   Returned   : None
+***************************************************************************/
+void FreePredictorData(predictor_data_t *data)
+{
+    if (NULL != data)
+    {
+        free(data->rows);
+        free(data);
+    }
+}
+
+/***************************************************************************
+*   Function   : PredictResiduals
+*   Description: This function computes the residual (sample minus
+*                prediction) for each sample in a buffer, continuing from
+*                the state left by the last call.
+*   Parameters : data - pointer to the predictor state.
+*                samples - little endian samples.
+*                count - the number of samples in samples.
+*                residuals - array of at least count residuals to fill in.
+*   Effects    : residuals is filled in and the predictor state is updated.
+*   Returned   : None
+***************************************************************************/
+void PredictResiduals(predictor_data_t *data, const unsigned char *samples,
+    const size_t count, long *residuals)
+{
+    unsigned long value, predicted, *history;
+    size_t i;
+
+    history = data->history;
+
+    if (IsByteDelta(data))
+    {
+        /* the common case: each residual is a byte difference */
+        value = history[0];
+
+        for (i = 0; i < count; i++)
+        {
+            residuals[i] = (long)(((samples[i] - value) & 0xFF) ^ 0x80) -
+                0x80;
+            value = samples[i];
+        }
+
+        UpdateBytes(data, samples, count);
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        value = GetSample(samples, data->sampleSize);
+        samples += data->sampleSize;
+
+        if (PREDICT_LMS == data->predictor)
+        {
+            predicted = PredictLms(data);
+        }
+        else if (PredictorUsesRows(data->predictor))
+        {
+            predicted = PredictRow(data);
+        }
+        else
+        {
+            predicted = PredictFixed(data);
+        }
+
+        if (1 != data->step)
+        {
+            /* predict from the sample the decoder will rebuild */
+            value = Quantize(data, value, predicted, &residuals[i]);
+        }
+        else if (PREDICT_XOR == data->predictor)
+        {
+            /* the bits that changed, not a difference */
+            residuals[i] = SignExtend(value ^ predicted, data->sampleBits);
+        }
+        else
+        {
+            residuals[i] = SignExtend((value - predicted) & data->mask,
+                data->sampleBits);
+        }
+
+        if (PREDICT_LMS == data->predictor)
+        {
+            UpdateLms(data, value, residuals[i]);
+        }
+
+        if (NULL != data->rows)
+        {
+            UpdateRows(data, value);
+        }
+
+        UpdatePeriod(data, value);
+        history[3] = history[2];
+        history[2] = history[1];
+        history[1] = history[0];
+        history[0] = value;
+    }
+}
+
+/***************************************************************************
+*   Function   : RestoreSamples
+*   Description: This function reverses PredictResiduals, adding each
+*                residual to its prediction, continuing from the state left
+*                by the last call.  PREDICT_PERIOD runs of 0 residuals are
+*                written straight from the period.
+*   Parameters : data - pointer to the predictor state.
+*                residuals - the residuals to restore.
+*                count - the number of residuals.
+*                samples - buffer of at least count samples that receives
+*                          the little endian samples.
+*   Effects    : samples is filled in and the predictor state is updated.
+*   Returned   : None
+***************************************************************************/
+void RestoreSamples(predictor_data_t *data, const long *residuals,
+    const size_t count, unsigned char *samples)
+{
+    unsigned long value, predicted, *history;
+    size_t i, run;
+    int periodic;
+
+    history = data->history;
+    periodic = (PREDICT_PERIOD == data->predictor) && (1 == data->step) &&
+        (NULL == data->rows);
+
+    if (IsByteDelta(data))
+    {
+        /* the common case: each sample is the last one plus a residual */
+        value = history[0];
+
+        for (i = 0; i < count; i++)
+        {
+            value = (value + (unsigned long)residuals[i]) & 0xFF;
+            samples[i] = (unsigned char)value;
+        }
+
+        UpdateBytes(data, samples, count);
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (periodic && (0 == residuals[i]))
+        {
+            for (run = 1; (i + run < count) && (0 == residuals[i + run]);
+                run++)
+            {
+                /* find the end of the run */
+            }
+
+            RestoreRun(data, run, samples);
+            samples += run * data->sampleSize;
+            i += run - 1;
+            continue;
+        }
+
+        if (PREDICT_LMS == data->predictor)
+        {
+            predicted = PredictLms(data);
+        }
+        else if (PredictorUsesRows(data->predictor))
+        {
+            predicted = PredictRow(data);
+        }
+        else
+        {
+            predicted = PredictFixed(data);
+        }
+
+        if (1 != data->step)
+        {
+            value = Dequantize(data, predicted, residuals[i]);
+        }
+        else if (PREDICT_XOR == data->predictor)
+        {
+            value = (predicted ^ (unsigned long)residuals[i]) & data->mask;
+        }
+        else
+        {
+            value = (predicted + (unsigned long)residuals[i]) & data->mask;
+        }
+
+        PutSample(value, data->sampleSize, samples);
+        samples += data->sampleSize;
+
+        if (PREDICT_LMS == data->predictor)
+        {
+            UpdateLms(data, value, residuals[i]);
+        }
+
+        if (NULL != data->rows)
+        {
+            UpdateRows(data, value);
+        }
+
+        UpdatePeriod(data, value);
+        history[3] = history[2];
+        history[2] = history[1];
+        history[1] = history[0];
+        history[0] = value;
+    }
+}
+
+/***************************************************************************
+*   Function   : PredictorName
+*   Description: This function returns the name of a predictor as accepted
+*                by ParsePredictor.
+*   Parameters : predictor - the predictor to name.
+*   Effects    : None
+*   Returned   : The predictor's name, or NULL if there's no such predictor.
+***************************************************************************/
+const char *PredictorName(const predictor_t predictor)
+{
+    int i;
+
+    for (i = 0; NULL != predictorNames[i].name; i++)
+    {
+        if (predictorNames[i].predictor == predictor)
+        {
+            return predictorNames[i].name;
+        }
+    }
+
+    return NULL;
+}
+
+/***************************************************************************
+*   Function   : ParsePredictor
+*   Description: This function looks up a predictor by name.
+*   Parameters : text - the name of the predictor.
+*                predictor - pointer to storage for the predictor.
+*   Effects    : predictor is set if the name is found.
+*   Returned   : 0 for success, -1 if the name isn't a predictor.
+***************************************************************************/
+int ParsePredictor(const char *text, predictor_t *predictor)
+{
+    int i;
+
+    if (NULL == text)
+    {
+        return -1;
+    }
+
+    for (i = 0; NULL != predictorNames[i].name; i++)
+    {
+        if (0 == strcmp(text, predictorNames[i].name))
+        {
+            *predictor = predictorNames[i].predictor;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/***************************************************************************
+*   Function   : SignExtend
+*   Description: This function converts a two's complement value stored in
+*                the low bits of an unsigned long to a signed value.
+*   Parameters : value - The value to convert.  Bits above the sign bit
+*                        must be 0.
+*                bits - The number of bits in value, including the sign.
+*   Effects    : None
+*   Returned   : The signed value.
+***************************************************************************/
+long SignExtend(const unsigned long value, const unsigned char bits)
+{
+    unsigned long sign;
+
+    sign = 1UL << (bits - 1);
+
+    if (value & sign)
+    {
+        /* negative; avoid converting values above LONG_MAX */
+        return -(long)((value ^ sign) ^ (sign - 1)) - 1;
+    }
+
+    return (long)value;
+}
+
+/***************************************************************************
+*   Function   : ZigZag
+*   Description: This function maps signed residuals to unsigned values so
+*                that small magnitudes get small values.
+*   Parameters : residual - The residual to map.
+*   Effects    : None
+*   Returned   : 2 x residual for positive residuals and
+*                -2 x residual - 1 for negative ones.
+***************************************************************************/
+unsigned long ZigZag(const long residual)
+{
+    if (residual < 0)
+    {
+        /* avoid negating LONG_MIN */
+        return 2 * (unsigned long)(-(residual + 1)) + 1;
+    }
+
+    return 2 * (unsigned long)residual;
+}
+
+/***************************************************************************
+*   Function   : UnZigZag
+*   Description: This function reverses ZigZag.
+*   Parameters : value - The mapped value.
+*   Effects    : None
+*   Returned   : The residual value was mapped from.
+***************************************************************************/
+long UnZigZag(const unsigned long value)
+{
+    if (value & 1)
+    {
+        return -(long)(value >> 1) - 1;
+    }
+
+    return (long)(value >> 1);
+}
+
+/***************************************************************************
+*   Function   : GetSample
+*   Description: This function assembles a little endian sample from a
+*                buffer.
+*   Parameters : buffer - Pointer to the first byte of the sample.
+*                sampleSize - The number of bytes in a sample.
+*   Effects    : None
+*   Returned   : The value of the sample.
+***************************************************************************/
+static unsigned long GetSample(const unsigned char *buffer,
+    const unsigned char sampleSize)
+{
+    unsigned long value;
+    int i;
+
+    value = 0;
+
+    for (i = sampleSize - 1; i >= 0; i--)
+    {
+        value = (value << 8) | buffer[i];
+    }
+
+    return value;
+}
+
+/***************************************************************************
+*   Function   : PutSample
+*   Description: This function stores a sample in a buffer in little endian
+*                order.
+*   Parameters : value - The sample to store.
+*                sampleSize - The number of bytes in a sample.
+*                buffer - Pointer to where the sample is stored.
+*   Effects    : sampleSize bytes of buffer are written.
+*   Returned   : None
+***************************************************************************/
+static void PutSample(unsigned long value, const unsigned char sampleSize,
+    unsigned char *buffer)
+{
+    unsigned char i;
+
+    for (i = 0; i < sampleSize; i++)
+    {
+        buffer[i] = (unsigned char)(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+/***************************************************************************
+*   Function   : PutSamples
+*   Description: This function stores an array of values in a buffer as
+*                little endian values of a given size.
+*   Parameters : values - The values to store.
+*                count - The number of values.
+*                sampleSize - The number of bytes stored for each value.
+*                state - Pointer to where the values are stored.
+*   Effects    : count x sampleSize bytes of state are written.
+*   Returned   : Pointer to the byte after the stored values.
+***************************************************************************/
+static unsigned char *PutSamples(const unsigned long *values,
+    const size_t count, const unsigned char sampleSize,
+    unsigned char *state)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        PutSample(values[i], sampleSize, state);
+        state += sampleSize;
+    }
+
+    return state;
+}
+
+/***************************************************************************
+*   Function   : GetSamples
+*   Description: This function reverses PutSamples.
+*   Parameters : values - Array receiving the values.
+*                count - The number of values.
+*                sampleSize - The number of bytes stored for each value.
+*                state - Pointer to the stored values.
+*   Effects    : values is filled in.
+*   Returned   : Pointer to the byte after the stored values.
+***************************************************************************/
+static const unsigned char *GetSamples(unsigned long *values,
+    const size_t count, const unsigned char sampleSize,
+    const unsigned char *state)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        values[i] = GetSample(state, sampleSize);
+        state += sampleSize;
+    }
+
+    return state;
+}
+
+/***************************************************************************
+*   Function   : PredictFixed
+*   Description: This function predicts the next sample with a fixed
+*                polynomial of the last FIXED_ORDER samples, plus the
+*                nominal period for PREDICT_PERIOD.
+*   Parameters : data - pointer to the predictor state.
+*   Effects    : None
+*   Returned   : The predicted sample.
+***************************************************************************/
+static unsigned long PredictFixed(const predictor_data_t *data)
+{
+    const long *c;
+    const unsigned long *h;
+    unsigned long period;
+
+    c = data->coefficients;
+    h = data->history;
+    period = (PREDICT_PERIOD == data->predictor) ? data->period : 0;
+
+    /* unsigned math wraps the same way in the encoder and decoder */
+    return ((unsigned long)c[0] * h[0] + (unsigned long)c[1] * h[1] +
+        (unsigned long)c[2] * h[2] + (unsigned long)c[3] * h[3] + period) &
+        data->mask;
+}
+
+/***************************************************************************
+*   Function   : UpdatePeriod
+*   Description: This function updates the nominal period with the step to
+*                a new sample.  A step only becomes the period once it's
+*                been seen twice in a row.  It's updated for every
+*                predictor, so PREDICT_PERIOD can be picked at any block.
+*   Parameters : data - pointer to the predictor state.  Its history must
+*                       not include value yet.
+*                value - the sample that was just coded.
+*   Effects    : The period may be changed.
+*   Returned   : None
+***************************************************************************/
+static void UpdatePeriod(predictor_data_t *data, const unsigned long value)
+{
+    unsigned long step;
+
+    step = (value - data->history[0]) & data->mask;
+
+    if (step == ((data->history[0] - data->history[1]) & data->mask))
+    {
+        data->period = step;
+    }
+}
+
+/***************************************************************************
+*   Function   : RestoreRun
+*   Description: This function restores a PREDICT_PERIOD run of 0
+*                residuals, which is an arithmetic sequence continuing
+*                from the last sample.  Each sample is computed from the
+*                last one before the run, so no iteration waits on the one
+*                before it.  RestoreRunVectors writes what it can a
+*                register at a time.
+*   Parameters : data - pointer to the predictor state.  It must be
+*                       lossless and have no row width.
+*                run - the number of 0 residuals.
+*                samples - buffer of at least run samples that receives
+*                          the little endian samples.
+*   Effects    : samples is filled in and the history is updated as if
+*                each sample had been restored on its own.  The period
+*                doesn't change; every step in the run is the period.
+*   Returned   : None
+***************************************************************************/
+static void RestoreRun(predictor_data_t *data, const size_t run,
+    unsigned char *samples)
+{
+    unsigned long base, period, *history;
+    size_t k;
+
+    history = data->history;
+    base = history[0];
+    period = data->period;
+    k = 0;
+
+#ifdef SIMD_RUNS
+    if (UseAvx2())
+    {
+        k = RestoreRunVectors(data, run, samples);
+    }
+#endif
+
+    for (; k < run; k++)
+    {
+        PutSample((base + (k + 1) * period) & data->mask, data->sampleSize,
+            samples + k * data->sampleSize);
+    }
+
+    /* only the last FIXED_ORDER samples stay in the history */
+    for (k = (run > FIXED_ORDER) ? run - FIXED_ORDER : 0; k < run; k++)
+    {
+        history[3] = history[2];
+        history[2] = history[1];
+        history[1] = history[0];
+        history[0] = (base + (k + 1) * period) & data->mask;
+    }
+}
+
+#ifdef SIMD_RUNS
+/***************************************************************************
+*   Function   : UseAvx2
+*   Description: This function checks whether the processor has AVX2,
+*                which RestoreRunVectors needs.
+*   Parameters : None
+*   Effects    : The processor is checked on the first call.
+*   Returned   : Non-zero if RestoreRunVectors may be used.
+***************************************************************************/
+static int UseAvx2(void)
+{
+    if (!avx2Ready)
+    {
+        __builtin_cpu_init();
+        haveAvx2 = __builtin_cpu_supports("avx2");
+        avx2Ready = 1;
+    }
+
+    return haveAvx2;
+}
+
+/***************************************************************************
+*   Function   : RestoreRunVectors
+*   Description: This function writes the first samples of a PREDICT_PERIOD
+*                run a register at a time.  The register starts with the
+*                first samples of the run, and every lane then adds the
+*                period times the number of lanes.  x86 is little endian
+*                and lane adds wrap like the sample mask, so the lanes are
+*                the samples as stored.  It must only be called if UseAvx2
+*                returns non-zero.
+*   Parameters : data - pointer to the predictor state.  It must be
+*                       lossless and have no row width.
+*                run - the number of 0 residuals.
+*                samples - buffer of at least run samples that receives
+*                          the little endian samples.
+*   Effects    : The first samples of the run are written.  The history
+*                isn't changed.
+*   Returned   : The number of samples written.  It's 0 for sample sizes
+*                that aren't a lane size (1, 2, 4, or 8 bytes).
+***************************************************************************/
+static size_t RestoreRunVectors(const predictor_data_t *data,
+    const size_t run, unsigned char *samples)
+{
+    unsigned char first[VECTOR_SIZE], step[VECTOR_SIZE];
+    __m256i values, steps;
+    unsigned long base, period;
+    size_t lanes, k;
+    unsigned char size;
+
+    size = data->sampleSize;
+    lanes = VECTOR_SIZE / size;
+
+    if ((0 != (size & (size - 1))) || (run < lanes))
+    {
+        return 0;
+    }
+
+    base = data->history[0];
+    period = data->period;
+
+    /* byte k % size of lane k / size, little endian */
+    for (k = 0; k < VECTOR_SIZE; k++)
+    {
+        first[k] = (unsigned char)((((base + (k / size + 1) * period) &
+            data->mask) >> (8 * (k % size))) & 0xFF);
+        step[k] = (unsigned char)((((lanes * period) & data->mask) >>
+            (8 * (k % size))) & 0xFF);
+    }
+
+    values = _mm256_loadu_si256((const __m256i *)first);
+    steps = _mm256_loadu_si256((const __m256i *)step);
+
+    for (k = 0; k + lanes <= run; k += lanes)
+    {
+        _mm256_storeu_si256((__m256i *)(samples + k * size), values);
+
+        switch (size)
+        {
+            case 1:
+                values = _mm256_add_epi8(values, steps);
+                break;
+
+            case 2:
+                values = _mm256_add_epi16(values, steps);
+                break;
+
+            case 4:
+                values = _mm256_add_epi32(values, steps);
+                break;
+
+            default:
+                values = _mm256_add_epi64(values, steps);
+                break;
+        }
+    }
+
+    return k;
+}
+#endif
+
+/***************************************************************************
+*   Function   : IsByteDelta
+*   Description: This function determines if PredictResiduals and
+*                RestoreSamples may take their direct path for 1 byte
+*                samples predicted by the previous one, without a lossy
+*                step or rows to keep up.
+*   Parameters : data - pointer to the predictor state.
+*   Effects    : None
+*   Returned   : Non-zero if the direct path may be taken.
+***************************************************************************/
+static int IsByteDelta(const predictor_data_t *data)
+{
+    return (PREDICT_PREVIOUS == data->predictor) && (1 == data->step) &&
+        (1 == data->sampleSize) && (NULL == data->rows);
+}
+
+/***************************************************************************
+*   Function   : UpdateBytes
+*   Description: This function brings the period and history up to date
+*                after a buffer of 1 byte samples was predicted or restored
+*                without them.  Only the first two steps reach back into
+*                the history; after that the period is the last step in
+*                the buffer that was the same twice in a row.
+*   Parameters : data - pointer to the predictor state.  Its history must
+*                       not include the samples yet.
+*                samples - the samples, 1 byte each.
+*                count - the number of samples.
+*   Effects    : The period and history are updated as if each sample had
+*                been predicted on its own.
+*   Returned   : None
+***************************************************************************/
+static void UpdateBytes(predictor_data_t *data, const unsigned char *samples,
+    const size_t count)
+{
+    unsigned long *history, step;
+    size_t i;
+
+    history = data->history;
+
+    for (i = 0; (i < count) && (i < 2); i++)
+    {
+        UpdatePeriod(data, samples[i]);
+        history[3] = history[2];
+        history[2] = history[1];
+        history[1] = history[0];
+        history[0] = samples[i];
+    }
+
+    for (i = count; i > 2; i--)
+    {
+        step = ((unsigned long)samples[i - 1] - samples[i - 2]) & 0xFF;
+
+        if (step == (((unsigned long)samples[i - 2] - samples[i - 3]) & 0xFF))
+        {
+            data->period = step;
+            break;
+        }
+    }
+
+    /* only the last FIXED_ORDER samples stay in the history */
+    for (i = (count > FIXED_ORDER + 2) ? count - FIXED_ORDER : 2; i < count;
+        i++)
+    {
+        history[3] = history[2];
+        history[2] = history[1];
+        history[1] = history[0];
+        history[0] = samples[i];
+    }
+}
+
+/***************************************************************************
+*   Function   : PredictLms
+*   Description: This function predicts the next sample as the last sample
+*                plus a weighted sum of the last LMS_ORDER differences.
+*   Parameters : data - pointer to the predictor state.
+*   Effects    : None
+*   Returned   : The predicted sample.
+***************************************************************************/
+static unsigned long PredictLms(const predictor_data_t *data)
+{
+    unsigned long sum;
+    int i;
+
+    sum = 0;
+
+    for (i = 0; i < LMS_ORDER; i++)
+    {
+        sum += (unsigned long)data->weights[i] *
+            (unsigned long)data->steps[i];
+    }
+
+    /* portable arithmetic shift of the two's complement sum */
+    if (sum & (1UL << (ULONG_BITS - 1)))
+    {
+        sum = ~(~sum >> LMS_SHIFT);
+    }
+    else
+    {
+        sum >>= LMS_SHIFT;
+    }
+
+    return (data->history[0] + sum) & data->mask;
+}
+
+/***************************************************************************
+*   Function   : UpdateLms
+*   Description: This function adapts the PREDICT_LMS weights with the
+*                sign-sign LMS rule: each weight moves LMS_RATE toward
+*                reducing the residual, based only on signs.
+*   Parameters : data - pointer to the predictor state.
+*                value - the sample that was just coded.
+*                residual - the residual that was coded for value.
+*   Effects    : The weights and difference history are updated.
+*   Returned   : None
+***************************************************************************/
+static void UpdateLms(predictor_data_t *data, const unsigned long value,
+    const long residual)
+{
+    long *weights, *steps, rate;
+    int i;
+
+    weights = data->weights;
+    steps = data->steps;
+
+    if (0 != residual)
+    {
+        rate = (residual > 0) ? LMS_RATE : -LMS_RATE;
+
+        for (i = 0; i < LMS_ORDER; i++)
+        {
+            if (steps[i] > 0)
+            {
+                weights[i] += rate;
+            }
+            else if (steps[i] < 0)
+            {
+                weights[i] -= rate;
+            }
+
+            if (weights[i] > LMS_LIMIT)
+            {
+                weights[i] = LMS_LIMIT;
+            }
+            else if (weights[i] < -LMS_LIMIT)
+            {
+                weights[i] = -LMS_LIMIT;
+            }
+        }
+    }
+
+    for (i = LMS_ORDER - 1; i > 0; i--)
+    {
+        steps[i] = steps[i - 1];
+    }
+
+    steps[0] = SignExtend((value - data->history[0]) & data->mask,
+        data->sampleBits);
+}
+
+/***************************************************************************
+*   Function   : PredictRow
+*   Description: This function predicts the next sample of an image from
+*                its neighbors to the left, above, and above and to the
+*                left, with the PNG up, average, or Paeth filter.
+*   Parameters : data - pointer to the predictor state.  It must have a
+*                       row width.
+*   Effects    : None
+*   Returned   : The predicted sample.
+***************************************************************************/
+static unsigned long PredictRow(const predictor_data_t *data)
+{
+    unsigned long left, up, upLeft, pa, pb, pc;
+    size_t next;
+
+    next = data->position + 1;
+    next = (next > data->width) ? 0 : next;
+    up = data->rows[next];
+
+    if (0 == data->column)
+    {
+        left = up;
+        upLeft = up;
+    }
+    else
+    {
+        left = data->history[0];
+        upLeft = data->rows[data->position];
+    }
+
+    if (PREDICT_UP == data->predictor)
+    {
+        return up;
+    }
+
+    if (PREDICT_AVERAGE == data->predictor)
+    {
+        /* (left + up) / 2 without overflowing 64 bit samples */
+        return (left >> 1) + (up >> 1) + (left & up & 1);
+    }
+
+    /* Paeth: the neighbor closest to left + up - upLeft, with the
+     * distances worked out so that nothing overflows */
+    pa = (up > upLeft) ? up - upLeft : upLeft - up;
+    pb = (left > upLeft) ? left - upLeft : upLeft - left;
+
+    if ((up > upLeft) == (left > upLeft))
+    {
+        pc = pa + pb;
+        pc = (pc < pa) ? ~0UL : pc;
+    }
+    else
+    {
+        pc = (pa > pb) ? pa - pb : pb - pa;
+    }
+
+    if ((pa <= pb) && (pa <= pc))
+    {
+        return left;
+    }
+
+    return (pb <= pc) ? up : upLeft;
+}
+
+/***************************************************************************
+*   Function   : UpdateRows
+*   Description: This function adds a sample to the ring used by the row
+*                predictors.
+*   Parameters : data - pointer to the predictor state.  It must have a
+*                       row width.
+*                value - the sample that was just coded.
+*   Effects    : The ring position and column are advanced.
+*   Returned   : None
+***************************************************************************/
+static void UpdateRows(predictor_data_t *data, const unsigned long value)
+{
+    /* the up left sample is never needed again */
+    data->rows[data->position] = value;
+    data->position++;
+
+    if (data->position > data->width)
+    {
+        data->position = 0;
+    }
+
+    data->column++;
+
+    if (data->column == data->width)
+    {
+        data->column = 0;
+    }
+}
+
+/***************************************************************************
+*   Function   : SampleValue
+*   Description: This function reads a sample as a signed or unsigned
+*                integer, as set by SetPredictorError.
+*   Parameters : data - pointer to the predictor state.  Its samples must
+*                       be narrower than a long.
+*                sample - the sample's bits.
+*   Effects    : None
+*   Returned   : The sample's value.
+***************************************************************************/
+static long SampleValue(const predictor_data_t *data,
+    const unsigned long sample)
+{
+    if (data->isSigned)
+    {
+        return SignExtend(sample, data->sampleBits);
+    }
+
+    return (long)sample;
+}
+
+/***************************************************************************
+*   Function   : Quantize
+*   Description: This function computes the lossy residual of a sample:
+*                the nearest number of steps from the prediction to the
+*                sample.
+*   Parameters : data - pointer to the predictor state.  It must have a
+*                       maximum error.
+*                value - the sample.
+*                predicted - the sample's prediction.
+*                residual - set to the number of steps.
+*   Effects    : None
+*   Returned   : The rebuilt sample, which is within the maximum error of
+*                value.
+***************************************************************************/
+static unsigned long Quantize(const predictor_data_t *data,
+    const unsigned long value, const unsigned long predicted,
+    long *residual)
+{
+    long difference, half;
+
+    /* can't overflow; both values are narrower than a long */
+    difference = SampleValue(data, value) - SampleValue(data, predicted);
+    half = data->step / 2;
+
+    /* round to the nearest step, the same way for both signs */
+    if (difference >= 0)
+    {
+        *residual = (difference + half) / data->step;
+    }
+    else
+    {
+        *residual = -((half - difference) / data->step);
+    }
+
+    return Dequantize(data, predicted, *residual);
+}
+
+/***************************************************************************
+*   Function   : Dequantize
+*   Description: This function rebuilds a sample from its prediction and
+*                lossy residual.
+*   Parameters : data - pointer to the predictor state.  It must have a
+*                       maximum error.
+*                predicted - the sample's prediction.
+*                residual - the number of steps from the prediction.
+*   Effects    : None
+*   Returned   : The rebuilt sample, clamped to the range of a sample.
+***************************************************************************/
+static unsigned long Dequantize(const predictor_data_t *data,
+    const unsigned long predicted, long residual)
+{
+    long value;
+
+    /* more steps would be clamped anyway; this keeps a corrupt residual
+     * from overflowing */
+    if (residual > data->limit)
+    {
+        residual = data->limit;
+    }
+    else if (residual < -data->limit)
+    {
+        residual = -data->limit;
+    }
+
+    value = SampleValue(data, predicted) + residual * data->step;
+
+    if (value < data->low)
+    {
+        value = data->low;
+    }
+    else if (value > data->high)
+    {
+        value = data->high;
+    }
+
+    return (unsigned long)value & data->mask;
+}
@@ -0,0 +1,110 @@
+/***************************************************************************
+*            Header for Delta Encoding Sample Prediction Module
+*
+*   File    : predict.h
+*   Purpose : Provides prototypes for functions that predict samples from
+*             the samples before them, turning samples into residuals for
+*             delta encoding and residuals back into samples for decoding.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Delta: An adaptive delta encoding/decoding library
+* Copyright (C) 2026 by
+*       Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the Delta library.
+*
+* Delta is free software; you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or (at your
+* option) any later version.
+*
+* Delta is distributed in the hope that it will be useful, but WITHOUT ANY
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+* License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+#ifndef _PREDICT_H_
+#define _PREDICT_H_
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stddef.h>
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/* how the next sample is predicted (values are stored in streams) */
+typedef enum
+{
+    PREDICT_PREVIOUS = 0,   /* last sample (delta, fixed order 1) */
+    PREDICT_LINEAR = 1,     /* last step repeats (delta2, fixed order 2) */
+    PREDICT_FIXED0 = 2,     /* always 0, samples are coded as is */
+    PREDICT_FIXED3 = 3,     /* fixed order 3 polynomial */
+    PREDICT_FIXED4 = 4,     /* fixed order 4 polynomial */
+    PREDICT_LMS = 5,        /* delta with sign-sign LMS adaptive filter */
+    PREDICT_UP = 6,         /* same sample in the row above (images) */
+    PREDICT_AVERAGE = 7,    /* mean of the left and up samples (images) */
+    PREDICT_PAETH = 8,      /* PNG Paeth of left, up, and up left (images) */
+    PREDICT_XOR = 9,        /* bits that changed from the last sample */
+    PREDICT_PERIOD = 10,    /* last sample + nominal period (timestamps) */
+    PREDICT_NUM_PREDICTORS,
+    PREDICT_AUTO = PREDICT_NUM_PREDICTORS   /* encoder picks per block */
+} predictor_t;
+
+/* predictor state (contents private to predict.c) */
+struct predictor_data_t;
+typedef struct predictor_data_t predictor_data_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+
+/* create, reset, and free predictor state for samples of sampleSize bytes */
+predictor_data_t *CreatePredictorData(const predictor_t predictor,
+    const unsigned char sampleSize);
+void ResetPredictorData(predictor_data_t *data);
+void SelectPredictor(predictor_data_t *data, const predictor_t predictor);
+void CopyPredictorData(predictor_data_t *dest, const predictor_data_t *src);
+
+/* predictor state as bytes, so a decoder can pick up mid stream */
+size_t PredictorStateSize(const predictor_data_t *data);
+void SavePredictorState(const predictor_data_t *data, unsigned char *state);
+int LoadPredictorState(predictor_data_t *data, const unsigned char *state,
+    const size_t length);
+void FreePredictorData(predictor_data_t *data);
+
+/* image rows of width samples for the row predictors, 0 for none */
+int SetPredictorWidth(predictor_data_t *data, const size_t width);
+int PredictorUsesRows(const predictor_t predictor);
+
+/* lossy prediction to within maxError of each sample, 0 for lossless */
+int SetPredictorError(predictor_data_t *data, const unsigned long maxError,
+    const int isSigned);
+
+/* little endian samples to signed residuals and back */
+void PredictResiduals(predictor_data_t *data, const unsigned char *samples,
+    const size_t count, long *residuals);
+void RestoreSamples(predictor_data_t *data, const long *residuals,
+    const size_t count, unsigned char *samples);
+
+/* predictor names for command lines and profiles */
+const char *PredictorName(const predictor_t predictor);
+int ParsePredictor(const char *text, predictor_t *predictor);
+
+/* value of a bits wide two's complement number held in an unsigned long */
+long SignExtend(const unsigned long value, const unsigned char bits);
+
+/* signed residuals to unsigned values with small magnitudes first, and back */
+unsigned long ZigZag(const long residual);
+long UnZigZag(const unsigned long value);
+
+#endif  /* ndef _PREDICT_H_ */
@@ -0,0 +1,389 @@
+/***************************************************************************
+*                     Delta Encoding Option Profiles
+*
+*   File    : profile.c
+*   Purpose : Functions for saving encoding options to and loading them
+*             from profile files, so options tuned for a data source can
+*             be reused without rebuilding the library.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Delta: An adaptive delta encoding/decoding library
+* Copyright (C) 2026 by
+*       Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the Delta library.
+*
+* Delta is free software; you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or (at your
+* option) any later version.
+*
+* Delta is distributed in the hope that it will be useful, but WITHOUT ANY
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+* License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+* A profile is a text file of "key = value" lines.  Blank lines and lines
+* starting with '#' are ignored.  Keys that aren't in a profile keep the
+* value they had before the profile was loaded.
+*
+*   policy = <adaptation policy as accepted by ParseAdaptiveParams>
+*   size = <starting code size | auto>
+*   sample_size = <bytes per sample>
+*   channels = <interleaved channels>
+*   byte_planes = <1 to code each byte of a sample on its own, otherwise 0>
+*   width = <image row width in pixels, 0 for none>
+*   signed = <1 for two's complement samples, otherwise 0>
+*   max_error = <largest error allowed by lossy coding, 0 for lossless>
+*   predictor = <predictor name as accepted by ParsePredictor>
+*   min_speed = <MB/s floor for PREDICT_AUTO, 0 for none>
+*   backend = <backend name as accepted by DeltaParseBackend>
+*   sync_interval = <frames between resynchronization points, 0 for none>
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <errno.h>
+#include "delta.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define MAX_LINE    256
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static char *TrimSpace(char *text);
+static int SetOption(const char *key, const char *value,
+    delta_options_t *options);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : DeltaLoadProfile
+*   Description: This function reads encoding options from a profile file.
+*   Parameters : fileName - The name of the profile file.
+*                options - Pointer to the options that the profile will
+*                          modify.
+*   Effects    : Options listed in the profile are set in options.  If the
+*                profile can't be read or has errors, options may have been
+*                partially modified.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+int DeltaLoadProfile(const char *fileName, delta_options_t *options)
+{
+    FILE *fp;
+    char line[MAX_LINE];
+    char *key, *value, *equals;
+
+    if ((NULL == fileName) || (NULL == options))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (NULL == (fp = fopen(fileName, "r")))
+    {
+        return -1;
+    }
+
+    while (NULL != fgets(line, MAX_LINE, fp))
+    {
+        key = TrimSpace(line);
+
+        if (('\0' == *key) || ('#' == *key))
+        {
+            /* blank or comment */
+            continue;
+        }
+
+        if (NULL == (equals = strchr(key, '=')))
+        {
+            fclose(fp);
+            errno = EINVAL;
+            return -1;
+        }
+
+        *equals = '\0';
+        key = TrimSpace(key);
+        value = TrimSpace(equals + 1);
+
+        if (0 != SetOption(key, value, options))
+        {
+            fclose(fp);
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : DeltaSaveProfile
+*   Description: This function writes encoding options to a profile file
+*                that may be read with DeltaLoadProfile.
+*   Parameters : fileName - The name of the profile file.
+*                options - Pointer to the options to be saved.
+*   Effects    : The profile file is created or overwritten.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+int DeltaSaveProfile(const char *fileName, const delta_options_t *options)
+{
+    FILE *fp;
+    char policy[ADAPT_TEXT_SIZE];
+
+    if ((NULL == fileName) || (NULL == options) ||
+        !ValidAdaptiveParams(&(options->adapt)) ||
+        (NULL == PredictorName(options->predictor)) ||
+        (NULL == DeltaBackendName(options->backend)))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (NULL == (fp = fopen(fileName, "w")))
+    {
+        return -1;
+    }
+
+    FormatAdaptiveParams(&(options->adapt), policy);
+    fprintf(fp, "# delta encoding profile\n");
+    fprintf(fp, "policy = %s\n", policy);
+
+    if (DELTA_AUTO_SIZE == options->codeSize)
+    {
+        fprintf(fp, "size = auto\n");
+    }
+    else
+    {
+        fprintf(fp, "size = %u\n", options->codeSize);
+    }
+
+    fprintf(fp, "sample_size = %u\n", options->sampleSize);
+    fprintf(fp, "channels = %u\n", options->channels);
+    fprintf(fp, "byte_planes = %d\n", 0 != options->planes);
+    fprintf(fp, "width = %u\n", options->width);
+    fprintf(fp, "signed = %d\n", 0 != options->isSigned);
+    fprintf(fp, "max_error = %lu\n", options->maxError);
+    fprintf(fp, "predictor = %s\n", PredictorName(options->predictor));
+    fprintf(fp, "min_speed = %u\n", options->minSpeed);
+    fprintf(fp, "backend = %s\n", DeltaBackendName(options->backend));
+    fprintf(fp, "sync_interval = %lu\n", options->syncInterval);
+
+    if (0 != fclose(fp))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : TrimSpace
+*   Description: This function removes leading and trailing white space
+*                from a string.
+*   Parameters : text - The string to trim.
+*   Effects    : Trailing white space in text is overwritten with '\0'.
+*   Returned   : Pointer to the first non-white space character in text.
+***************************************************************************/
+static char *TrimSpace(char *text)
+{
+    char *end;
+
+    while (isspace((unsigned char)*text))
+    {
+        text++;
+    }
+
+    end = text + strlen(text);
+
+    while ((end > text) && isspace((unsigned char)*(end - 1)))
+    {
+        end--;
+    }
+
+    *end = '\0';
+    return text;
+}
+
+/***************************************************************************
+*   Function   : SetOption
+*   Description: This function sets the option named by a profile key.
+*   Parameters : key - The profile key.
+*                value - The value for the key.
+*                options - Pointer to the options being modified.
+*   Effects    : The option named by key is set in options.
+*   Returned   : 0 for success, -1 for an unknown key or a bad value.
+***************************************************************************/
+static int SetOption(const char *key, const char *value,
+    delta_options_t *options)
+{
+    unsigned long number;
+    char *end;
+
+    if (0 == strcmp(key, "policy"))
+    {
+        return ParseAdaptiveParams(value, &(options->adapt));
+    }
+
+    if (0 == strcmp(key, "size"))
+    {
+        if (0 == strcmp(value, "auto"))
+        {
+            options->codeSize = DELTA_AUTO_SIZE;
+            return 0;
+        }
+
+        number = strtoul(value, &end, 10);
+
+        if (('\0' != *end) || (number < MIN_CODE_SIZE) ||
+            (number > MAX_CODE_SIZE))
+        {
+            return -1;
+        }
+
+        options->codeSize = (unsigned char)number;
+        return 0;
+    }
+
+    if (0 == strcmp(key, "predictor"))
+    {
+        return ParsePredictor(value, &(options->predictor));
+    }
+
+    if (0 == strcmp(key, "sample_size"))
+    {
+        number = strtoul(value, &end, 10);
+
+        if (('\0' != *end) || (number < 1) ||
+            (number > DELTA_MAX_SAMPLE_SIZE))
+        {
+            return -1;
+        }
+
+        options->sampleSize = (unsigned char)number;
+        return 0;
+    }
+
+    if (0 == strcmp(key, "channels"))
+    {
+        number = strtoul(value, &end, 10);
+
+        if (('\0' != *end) || (number < 1) ||
+            (number > DELTA_MAX_CHANNELS))
+        {
+            return -1;
+        }
+
+        options->channels = (unsigned char)number;
+        return 0;
+    }
+
+    if (0 == strcmp(key, "byte_planes"))
+    {
+        number = strtoul(value, &end, 10);
+
+        if (('\0' != *end) || (number > 1))
+        {
+            return -1;
+        }
+
+        options->planes = (unsigned char)number;
+        return 0;
+    }
+
+    if (0 == strcmp(key, "width"))
+    {
+        number = strtoul(value, &end, 10);
+
+        if (('\0' != *end) || (number > DELTA_MAX_WIDTH))
+        {
+            return -1;
+        }
+
+        options->width = (unsigned int)number;
+        return 0;
+    }
+
+    if (0 == strcmp(key, "signed"))
+    {
+        number = strtoul(value, &end, 10);
+
+        if (('\0' != *end) || (number > 1))
+        {
+            return -1;
+        }
+
+        options->isSigned = (unsigned char)number;
+        return 0;
+    }
+
+    if (0 == strcmp(key, "max_error"))
+    {
+        number = strtoul(value, &end, 10);
+
+        if (('\0' != *end) || (number > DELTA_MAX_ERROR))
+        {
+            return -1;
+        }
+
+        options->maxError = number;
+        return 0;
+    }
+
+    if (0 == strcmp(key, "min_speed"))
+    {
+        number = strtoul(value, &end, 10);
+
+        if (('\0' != *end) || (number > UINT_MAX))
+        {
+            return -1;
+        }
+
+        options->minSpeed = (unsigned int)number;
+        return 0;
+    }
+
+    if (0 == strcmp(key, "backend"))
+    {
+        return DeltaParseBackend(value, &(options->backend));
+    }
+
+    if (0 == strcmp(key, "sync_interval"))
+    {
+        number = strtoul(value, &end, 10);
+
+        if (('\0' != *end) || (number > ULONG_MAX / DELTA_MAX_CHANNELS /
+            DELTA_MAX_SAMPLE_SIZE))
+        {
+            return -1;
+        }
+
+        options->syncInterval = number;
+        return 0;
+    }
+
+    return -1;
+}
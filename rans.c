@@ -0,0 +1,531 @@
+/***************************************************************************
+*                  Delta Encoding rANS Residual Coder
+*
+*   File    : rans.c
+*   Purpose : Module that entropy codes blocks of residuals with a range
+*             asymmetric numeral system (rANS) coder.  It's an alternative
+*             to the adaptive width code words for residuals that are
+*             strongly peaked around 0.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Delta: An adaptive delta encoding/decoding library
+* Copyright (C) 2026 by
+*       Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the Delta library.
+*
+* Delta is free software; you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or (at your
+* option) any later version.
+*
+* Delta is distributed in the hope that it will be useful, but WITHOUT ANY
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+* License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+* Residuals are zigzag mapped (0, -1, 1, -2, ... become 0, 1, 2, 3, ...).
+* Mapped values below DIRECT_SYMBOLS are symbols of their own.  Larger
+* values are coded as a symbol for their bit length followed by the bits
+* after the leading 1, which are stored uncoded.
+*
+* A payload is:
+*   frequency table - the number of symbols in the table, then each
+*                     symbol's frequency (1 byte below 128, otherwise 2)
+*   rANS length     - 16 bit little endian count of rANS bytes
+*   rANS bytes      - the final coder states, then renormalization bytes
+*   extra bits      - the uncoded bits of each large value, MSB first
+*
+* Even and odd residuals use separate coder states that share one byte
+* stream.  The two states don't depend on each other, so a decoder may
+* work on both at once.
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <string.h>
+#include "predict.h"
+#include "rans.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+/* frequencies add up to 2^SCALE_BITS */
+#define SCALE_BITS      12
+#define SCALE           (1UL << SCALE_BITS)
+
+/* coder states are kept in [RANS_LOW, RANS_LOW << 8) */
+#define RANS_LOW        (1UL << 23)
+
+/* zigzag values coded directly, then one symbol per bit length 5 - 64 */
+#define DIRECT_SYMBOLS  16
+#define DIRECT_BITS     4
+#define NUM_SYMBOLS     (DIRECT_SYMBOLS + 64 - DIRECT_BITS)
+
+/* number of interleaved coder states */
+#define NUM_STATES      2
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/* MSB first bits packed into a byte buffer */
+typedef struct
+{
+    unsigned char *bytes;       /* next byte to write or read */
+    const unsigned char *end;   /* end of buffer (reading only) */
+    unsigned long buffer;       /* bits not yet written or read */
+    unsigned int count;         /* number of bits in buffer */
+} bit_buffer_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static unsigned int MakeSymbol(const unsigned long value,
+    unsigned int *extraBits);
+static void NormalizeCounts(const unsigned long *counts, const size_t total,
+    unsigned int *freqs);
+static void PutBits(bit_buffer_t *bits, const unsigned long value,
+    unsigned int count);
+static int GetBits(bit_buffer_t *bits, unsigned long *value,
+    unsigned int count);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : RansEncode
+*   Description: This function entropy codes a block of residuals with a
+*                frequency table built from the block.
+*   Parameters : residuals - The residuals to code.
+*                count - The number of residuals.  It must not be 0.
+*                sampleBits - The number of bits in a sample.  Every
+*                             residual must fit in sampleBits bits.
+*                payload - Buffer receiving the coded block.  It must hold
+*                          RANS_MAX_PAYLOAD(count, sampleBits) bytes.
+*   Effects    : The coded block is written to payload.
+*   Returned   : The number of bytes in the coded block.
+***************************************************************************/
+size_t RansEncode(const long *residuals, const size_t count,
+    const unsigned char sampleBits, unsigned char *payload)
+{
+    unsigned long counts[NUM_SYMBOLS];
+    unsigned int freqs[NUM_SYMBOLS], starts[NUM_SYMBOLS];
+    unsigned long states[NUM_STATES], limit, value;
+    unsigned int symbol, used, extraBits, state;
+    unsigned char *end, *ptr;
+    size_t i, tableSize, ransSize;
+    bit_buffer_t bits;
+
+    /* build the frequency table */
+    memset(counts, 0, sizeof(counts));
+    used = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        symbol = MakeSymbol(ZigZag(residuals[i]), &extraBits);
+        counts[symbol]++;
+        used = (symbol >= used) ? symbol + 1 : used;
+    }
+
+    NormalizeCounts(counts, count, freqs);
+    tableSize = 0;
+    payload[tableSize++] = (unsigned char)used;
+
+    for (symbol = 0; symbol < used; symbol++)
+    {
+        starts[symbol] = (0 == symbol) ? 0 :
+            starts[symbol - 1] + freqs[symbol - 1];
+
+        if (freqs[symbol] < 0x80)
+        {
+            payload[tableSize++] = (unsigned char)freqs[symbol];
+        }
+        else
+        {
+            payload[tableSize++] =
+                (unsigned char)(0x80 | (freqs[symbol] & 0x7F));
+            payload[tableSize++] = (unsigned char)(freqs[symbol] >> 7);
+        }
+    }
+
+    /* rANS codes backwards, so work down from the end of the buffer */
+    end = payload + RANS_MAX_PAYLOAD(count, sampleBits);
+    ptr = end;
+
+    for (state = 0; state < NUM_STATES; state++)
+    {
+        states[state] = RANS_LOW;
+    }
+
+    for (i = count; i-- > 0; )
+    {
+        symbol = MakeSymbol(ZigZag(residuals[i]), &extraBits);
+        state = i % NUM_STATES;
+        limit = ((RANS_LOW >> SCALE_BITS) << 8) * freqs[symbol];
+
+        while (states[state] >= limit)
+        {
+            *(--ptr) = (unsigned char)(states[state] & 0xFF);
+            states[state] >>= 8;
+        }
+
+        states[state] = ((states[state] / freqs[symbol]) << SCALE_BITS) +
+            (states[state] % freqs[symbol]) + starts[symbol];
+    }
+
+    /* the decoder reads the states first, lowest numbered state first */
+    for (state = NUM_STATES; state-- > 0; )
+    {
+        ptr -= 4;
+        ptr[0] = (unsigned char)(states[state] & 0xFF);
+        ptr[1] = (unsigned char)((states[state] >> 8) & 0xFF);
+        ptr[2] = (unsigned char)((states[state] >> 16) & 0xFF);
+        ptr[3] = (unsigned char)((states[state] >> 24) & 0xFF);
+    }
+
+    ransSize = end - ptr;
+    payload[tableSize] = (unsigned char)(ransSize & 0xFF);
+    payload[tableSize + 1] = (unsigned char)(ransSize >> 8);
+    memmove(payload + tableSize + 2, ptr, ransSize);
+
+    /* uncoded bits of large values follow */
+    bits.bytes = payload + tableSize + 2 + ransSize;
+    bits.end = NULL;
+    bits.buffer = 0;
+    bits.count = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        value = ZigZag(residuals[i]);
+        MakeSymbol(value, &extraBits);
+
+        if (0 != extraBits)
+        {
+            PutBits(&bits, value, extraBits);
+        }
+    }
+
+    if (0 != bits.count)
+    {
+        /* pad the last byte with 0s */
+        PutBits(&bits, 0, 8 - bits.count);
+    }
+
+    return bits.bytes - payload;
+}
+
+/***************************************************************************
+*   Function   : RansDecode
+*   Description: This function decodes a block of residuals written by
+*                RansEncode.
+*   Parameters : payload - The coded block.
+*                length - The number of bytes in payload.
+*                sampleBits - The number of bits in a sample.
+*                residuals - Buffer receiving the residuals.
+*                count - The number of residuals to decode.
+*   Effects    : residuals is filled in.
+*   Returned   : 0 for success, -1 if the payload isn't a valid block of
+*                count residuals.
+***************************************************************************/
+int RansDecode(const unsigned char *payload, const size_t length,
+    const unsigned char sampleBits, long *residuals, const size_t count)
+{
+    unsigned int freqs[NUM_SYMBOLS], starts[NUM_SYMBOLS];
+    unsigned char lookup[SCALE];
+    unsigned long states[NUM_STATES], slot, value, extra;
+    unsigned int symbol, used, state, total, width;
+    const unsigned char *ptr, *end;
+    size_t i, ransSize;
+    bit_buffer_t bits;
+
+    end = payload + length;
+    ptr = payload;
+
+    if ((ptr >= end) || ((used = *ptr++) > NUM_SYMBOLS))
+    {
+        return -1;
+    }
+
+    /* read the frequency table and build the slot to symbol lookup */
+    total = 0;
+
+    for (symbol = 0; symbol < used; symbol++)
+    {
+        if (ptr >= end)
+        {
+            return -1;
+        }
+
+        freqs[symbol] = *ptr++;
+
+        if (freqs[symbol] & 0x80)
+        {
+            if (ptr >= end)
+            {
+                return -1;
+            }
+
+            freqs[symbol] =
+                (freqs[symbol] & 0x7F) | ((unsigned int)*ptr++ << 7);
+        }
+
+        starts[symbol] = total;
+
+        if (total + freqs[symbol] > SCALE)
+        {
+            return -1;
+        }
+
+        memset(lookup + total, symbol, freqs[symbol]);
+        total += freqs[symbol];
+    }
+
+    if ((total != SCALE) || (end - ptr < 2))
+    {
+        return -1;
+    }
+
+    ransSize = ptr[0] | ((size_t)ptr[1] << 8);
+    ptr += 2;
+
+    if ((ransSize < 4 * NUM_STATES) || ((size_t)(end - ptr) < ransSize))
+    {
+        return -1;
+    }
+
+    bits.bytes = (unsigned char *)ptr + ransSize;
+    bits.end = end;
+    bits.buffer = 0;
+    bits.count = 0;
+    end = ptr + ransSize;
+
+    for (state = 0; state < NUM_STATES; state++)
+    {
+        states[state] = ptr[0] | ((unsigned long)ptr[1] << 8) |
+            ((unsigned long)ptr[2] << 16) | ((unsigned long)ptr[3] << 24);
+        ptr += 4;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        state = i % NUM_STATES;
+        slot = states[state] & (SCALE - 1);
+        symbol = lookup[slot];
+        states[state] = freqs[symbol] * (states[state] >> SCALE_BITS) +
+            slot - starts[symbol];
+
+        while (states[state] < RANS_LOW)
+        {
+            if (ptr >= end)
+            {
+                return -1;
+            }
+
+            states[state] = (states[state] << 8) | *ptr++;
+        }
+
+        if (symbol < DIRECT_SYMBOLS)
+        {
+            value = symbol;
+        }
+        else
+        {
+            /* length of the value, then the bits after its leading 1 */
+            width = symbol - DIRECT_SYMBOLS + DIRECT_BITS + 1;
+
+            if ((width > sampleBits) ||
+                (0 != GetBits(&bits, &extra, width - 1)))
+            {
+                return -1;
+            }
+
+            value = (1UL << (width - 1)) | extra;
+        }
+
+        residuals[i] = UnZigZag(value);
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : MakeSymbol
+*   Description: This function finds the symbol used to code a zigzag
+*                mapped value.
+*   Parameters : value - The mapped value.
+*                extraBits - Pointer to storage for the number of uncoded
+*                            bits that follow the symbol.
+*   Effects    : None
+*   Returned   : The symbol for value.
+***************************************************************************/
+static unsigned int MakeSymbol(const unsigned long value,
+    unsigned int *extraBits)
+{
+    unsigned int length;
+    unsigned long rest;
+
+    if (value < DIRECT_SYMBOLS)
+    {
+        *extraBits = 0;
+        return (unsigned int)value;
+    }
+
+    length = 0;
+
+    for (rest = value; 0 != rest; rest >>= 1)
+    {
+        length++;
+    }
+
+    *extraBits = length - 1;
+    return DIRECT_SYMBOLS + length - (DIRECT_BITS + 1);
+}
+
+/***************************************************************************
+*   Function   : NormalizeCounts
+*   Description: This function scales symbol counts to frequencies that
+*                add up to SCALE.  Every symbol that occurs gets a
+*                frequency of at least 1.
+*   Parameters : counts - The number of times each symbol occurs.
+*                total - The sum of counts.  It must not be 0.
+*                freqs - Array receiving the frequency of each symbol.
+*   Effects    : freqs is filled in.
+*   Returned   : None
+***************************************************************************/
+static void NormalizeCounts(const unsigned long *counts, const size_t total,
+    unsigned int *freqs)
+{
+    unsigned int symbol, largest;
+    unsigned long sum, excess, cut;
+
+    sum = 0;
+    largest = 0;
+
+    for (symbol = 0; symbol < NUM_SYMBOLS; symbol++)
+    {
+        freqs[symbol] = 0;
+
+        if (0 != counts[symbol])
+        {
+            freqs[symbol] = (unsigned int)(counts[symbol] * SCALE / total);
+            freqs[symbol] = (0 == freqs[symbol]) ? 1 : freqs[symbol];
+            sum += freqs[symbol];
+
+            if (freqs[symbol] > freqs[largest])
+            {
+                largest = symbol;
+            }
+        }
+    }
+
+    if (sum < SCALE)
+    {
+        /* rounding down left some over */
+        freqs[largest] += (unsigned int)(SCALE - sum);
+        return;
+    }
+
+    /* rare symbols rounded up to 1 took too much; take it from the
+     * largest frequencies */
+    excess = sum - SCALE;
+
+    while (0 != excess)
+    {
+        largest = 0;
+
+        for (symbol = 1; symbol < NUM_SYMBOLS; symbol++)
+        {
+            if (freqs[symbol] > freqs[largest])
+            {
+                largest = symbol;
+            }
+        }
+
+        cut = (freqs[largest] / 2 < excess) ? freqs[largest] / 2 : excess;
+        freqs[largest] -= (unsigned int)cut;
+        excess -= cut;
+    }
+}
+
+/***************************************************************************
+*   Function   : PutBits
+*   Description: This function appends bits to a bit buffer, most
+*                significant bit first.
+*   Parameters : bits - Pointer to the bit buffer.
+*                value - The value whose low count bits are written.
+*                count - The number of bits to write.
+*   Effects    : Bits are added to bits and whole bytes are written out.
+*   Returned   : None
+***************************************************************************/
+static void PutBits(bit_buffer_t *bits, const unsigned long value,
+    unsigned int count)
+{
+    unsigned int chunk;
+
+    while (0 != count)
+    {
+        /* no more than a byte at a time so the buffer can't overflow */
+        chunk = (count > 8) ? 8 : count;
+        count -= chunk;
+        bits->buffer = (bits->buffer << chunk) |
+            ((value >> count) & ((1UL << chunk) - 1));
+        bits->count += chunk;
+
+        if (bits->count >= 8)
+        {
+            bits->count -= 8;
+            *(bits->bytes)++ =
+                (unsigned char)((bits->buffer >> bits->count) & 0xFF);
+        }
+    }
+}
+
+/***************************************************************************
+*   Function   : GetBits
+*   Description: This function reads bits written by PutBits.
+*   Parameters : bits - Pointer to the bit buffer.
+*                value - Pointer to storage for the bits read.
+*                count - The number of bits to read.
+*   Effects    : Bits are removed from bits.
+*   Returned   : 0 for success, -1 if the buffer runs out.
+***************************************************************************/
+static int GetBits(bit_buffer_t *bits, unsigned long *value,
+    unsigned int count)
+{
+    unsigned int chunk;
+
+    *value = 0;
+
+    while (0 != count)
+    {
+        if (0 == bits->count)
+        {
+            if (bits->bytes >= bits->end)
+            {
+                return -1;
+            }
+
+            bits->buffer = *(bits->bytes)++;
+            bits->count = 8;
+        }
+
+        chunk = (count > bits->count) ? bits->count : count;
+        count -= chunk;
+        bits->count -= chunk;
+        *value = (*value << chunk) |
+            ((bits->buffer >> bits->count) & ((1UL << chunk) - 1));
+    }
+
+    return 0;
+}
@@ -36,31 +36,54 @@
 /***************************************************************************
 *                             INCLUDED FILES
 ***************************************************************************/
+#ifndef _WIN32
+/* nanosleep, for following a growing input file */
+#define _POSIX_C_SOURCE 199309L
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
+#include <time.h>
 #include "optlist/optlist.h"
 #include "delta.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 /***************************************************************************
 *                                CONSTANTS
 ***************************************************************************/
-#define DEFAULT_SIZE 6
+#define DEFAULT_SIZE DELTA_DEFAULT_SIZE
+
+/* how often a followed input file is checked for more data */
+#define POLL_MS         250
+#define READ_CHUNK      65536
 
 typedef enum
 {
     MODE_ENCODE,
-    MODE_DECODE
+    MODE_DECODE,
+    MODE_APPEND
 } modes_t;
 
 /***************************************************************************
 *                            GLOBAL VARIABLES
 ***************************************************************************/
+/* set by a signal to stop following the input file */
+static volatile sig_atomic_t stopFollowing = 0;
 
 /***************************************************************************
 *                               PROTOTYPES
 ***************************************************************************/
 static void ShowUsage(const char *const progName);
+static void CloseAll(FILE *inFile, FILE *outFile, option_t *optList);
+static int FollowFile(FILE *inFile, FILE *outFile,
+    const delta_options_t *options, const int append, const long latency);
+static void StopFollowing(int sig);
+static void SleepMs(const unsigned int ms);
 
 /***************************************************************************
 *                                FUNCTIONS
@@ -80,18 +103,27 @@ static void ShowUsage(const char *const progName);
 int main(int argc, char *argv[])
 {
     FILE *inFile, *outFile;
-    unsigned char codeSize;
+    const char *outName;
+    delta_options_t options;
     modes_t mode;
+    unsigned int decodeFlags;
+    long latency;
+    int status;
     option_t *optList, *thisOpt;
 
     /* initialize variables */
     inFile = NULL;
     outFile = NULL;
-    codeSize = DEFAULT_SIZE;
+    outName = NULL;
+    DeltaDefaultOptions(&options);
     mode = MODE_ENCODE;
+    decodeFlags = 0;
+    latency = -1;                       /* don't follow the input */
+    status = EXIT_SUCCESS;
 
     /* parse command line */
-    optList = GetOptList(argc, argv, "cds:i:o:h?");
+    optList = GetOptList(argc, argv,
+        "cduxlts:w:y:n:r:e:k:m:f:b:a:p:g:i:o:h?");
     thisOpt = optList;
 
     while (thisOpt != NULL)
@@ -106,13 +138,37 @@ int main(int argc, char *argv[])
                 mode = MODE_DECODE;
                 break;
 
+            case 'u':       /* add to an existing encoded file */
+                mode = MODE_APPEND;
+                break;
+
+            case 'x':       /* skip block checksums */
+                decodeFlags |= DELTA_DECODE_NO_VERIFY;
+                break;
+
+            case 'l':       /* carry on past lost or damaged data */
+                decodeFlags |= DELTA_DECODE_RESYNC;
+                break;
+
+            case 't':       /* transpose samples into byte planes */
+                options.planes = 1;
+                break;
+
             case 's':       /* size of starting code word */
-                codeSize = atoi(thisOpt->argument);
+                if (0 == strcmp(thisOpt->argument, "a"))
+                {
+                    /* pick size by sampling the input */
+                    options.codeSize = DELTA_AUTO_SIZE;
+                    break;
+                }
+
+                options.codeSize = atoi(thisOpt->argument);
 
-                if ((codeSize < 2) || (codeSize > 8))
+                if ((options.codeSize < MIN_CODE_SIZE) ||
+                    (options.codeSize > MAX_CODE_SIZE))
                 {
-                    fprintf(stderr,
-                        "Starting code size must be between 2 and 8.\n\n");
+                    fprintf(stderr, "Starting code size must be between %d "
+                        "and %d or a.\n\n", MIN_CODE_SIZE, MAX_CODE_SIZE);
                     ShowUsage(FindFileName(argv[0]));
 
                     if (inFile != NULL)
@@ -131,6 +187,146 @@ int main(int argc, char *argv[])
 
                 break;
 
+            case 'w':       /* bytes per sample */
+                options.sampleSize = atoi(thisOpt->argument);
+
+                if ((options.sampleSize < 1) ||
+                    (options.sampleSize > DELTA_MAX_SAMPLE_SIZE))
+                {
+                    fprintf(stderr, "Sample size must be between 1 and %d "
+                        "bytes.\n\n", DELTA_MAX_SAMPLE_SIZE);
+                    ShowUsage(FindFileName(argv[0]));
+                    CloseAll(inFile, outFile, optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'y':       /* sample type */
+                if (0 != DeltaSampleType(thisOpt->argument, &options))
+                {
+                    fprintf(stderr, "Invalid sample type %s.\n\n",
+                        thisOpt->argument);
+                    ShowUsage(FindFileName(argv[0]));
+                    CloseAll(inFile, outFile, optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'n':       /* interleaved channels */
+                options.channels = atoi(thisOpt->argument);
+
+                if ((options.channels < 1) ||
+                    (options.channels > DELTA_MAX_CHANNELS))
+                {
+                    fprintf(stderr, "Channels must be between 1 and %d.\n\n",
+                        DELTA_MAX_CHANNELS);
+                    ShowUsage(FindFileName(argv[0]));
+                    CloseAll(inFile, outFile, optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'r':       /* image row width */
+                options.width = atoi(thisOpt->argument);
+
+                if (options.width > DELTA_MAX_WIDTH)
+                {
+                    fprintf(stderr, "Row width must be between 0 and %u.\n\n",
+                        DELTA_MAX_WIDTH);
+                    ShowUsage(FindFileName(argv[0]));
+                    CloseAll(inFile, outFile, optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'e':       /* lossy maximum error */
+                options.maxError = (unsigned long)atol(thisOpt->argument);
+
+                if (options.maxError > DELTA_MAX_ERROR)
+                {
+                    fprintf(stderr, "Maximum error must be between 0 and "
+                        "%lu.\n\n", DELTA_MAX_ERROR);
+                    ShowUsage(FindFileName(argv[0]));
+                    CloseAll(inFile, outFile, optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'k':       /* frames between resynchronization points */
+                options.syncInterval = (unsigned long)atol(thisOpt->argument);
+                break;
+
+            case 'm':       /* prediction mode */
+                if (0 != ParsePredictor(thisOpt->argument,
+                    &(options.predictor)))
+                {
+                    fprintf(stderr, "Invalid prediction mode %s.\n\n",
+                        thisOpt->argument);
+                    ShowUsage(FindFileName(argv[0]));
+                    CloseAll(inFile, outFile, optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'f':       /* speed floor for automatic prediction */
+                options.minSpeed = atoi(thisOpt->argument);
+                break;
+
+            case 'b':       /* residual coding backend */
+                if (0 != DeltaParseBackend(thisOpt->argument,
+                    &(options.backend)))
+                {
+                    fprintf(stderr, "Invalid backend %s.\n\n",
+                        thisOpt->argument);
+                    ShowUsage(FindFileName(argv[0]));
+                    CloseAll(inFile, outFile, optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'a':       /* code size adaptation policy */
+                if (0 != ParseAdaptiveParams(thisOpt->argument,
+                    &(options.adapt)))
+                {
+                    fprintf(stderr, "Invalid adaptation policy %s.\n\n",
+                        thisOpt->argument);
+                    ShowUsage(FindFileName(argv[0]));
+                    CloseAll(inFile, outFile, optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'p':       /* options from a profile */
+                if (0 != DeltaLoadProfile(thisOpt->argument, &options))
+                {
+                    perror("Loading Profile");
+                    CloseAll(inFile, outFile, optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'g':       /* follow a growing input file */
+                latency = atol(thisOpt->argument);
+
+                if (latency < 0)
+                {
+                    fprintf(stderr, "Flush interval can't be negative.\n\n");
+                    ShowUsage(FindFileName(argv[0]));
+                    CloseAll(inFile, outFile, optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
             case 'i':       /* input file name */
                 if (inFile != NULL)
                 {
@@ -160,10 +356,9 @@ int main(int argc, char *argv[])
                 break;
 
             case 'o':       /* output file name */
-                if (outFile != NULL)
+                if (outName != NULL)
                 {
                     fprintf(stderr, "Multiple output files not allowed.\n");
-                    fclose(outFile);
 
                     if (inFile != NULL)
                     {
@@ -173,18 +368,9 @@ int main(int argc, char *argv[])
                     FreeOptList(optList);
                     exit(EXIT_FAILURE);
                 }
-                else if ((outFile = fopen(thisOpt->argument, "wb")) == NULL)
-                {
-                    perror("Opening Output File");
-
-                    if (inFile != NULL)
-                    {
-                        fclose(inFile);
-                    }
 
-                    FreeOptList(optList);
-                    exit(EXIT_FAILURE);
-                }
+                /* opened once the mode is known */
+                outName = thisOpt->argument;
                 break;
 
             case 'h':
@@ -199,34 +385,92 @@ int main(int argc, char *argv[])
         thisOpt = optList;
     }
 
+    if ((DELTA_AUTO_SIZE != options.codeSize) &&
+        (options.codeSize > 8 * options.sampleSize))
+    {
+        fprintf(stderr, "Starting code size can't be wider than a sample.\n");
+        CloseAll(inFile, outFile, NULL);
+        return EXIT_FAILURE;
+    }
+
+    if ((0 == options.width) && PredictorUsesRows(options.predictor))
+    {
+        fprintf(stderr, "Prediction mode %s needs a row width.\n",
+            PredictorName(options.predictor));
+        CloseAll(inFile, outFile, NULL);
+        return EXIT_FAILURE;
+    }
+
+    if ((0 != options.maxError) &&
+        ((0 != options.planes) || (options.sampleSize >= sizeof(long))))
+    {
+        fprintf(stderr, "Lossy coding needs samples narrower than %d bytes "
+            "and no byte planes.\n", (int)sizeof(long));
+        CloseAll(inFile, outFile, NULL);
+        return EXIT_FAILURE;
+    }
+
     if (NULL == inFile)
     {
         inFile = stdin;
     }
 
-    if (NULL == outFile)
+    if (NULL == outName)
     {
+        if (MODE_APPEND == mode)
+        {
+            fprintf(stderr, "Adding to an encoded file needs -o.\n");
+            CloseAll(inFile, NULL, NULL);
+            return EXIT_FAILURE;
+        }
+
         outFile = stdout;
     }
+    else if ((outFile = fopen(outName,
+        (MODE_APPEND == mode) ? "r+b" : "wb")) == NULL)
+    {
+        perror("Opening Output File");
+        CloseAll(inFile, NULL, NULL);
+        return EXIT_FAILURE;
+    }
 
-    if (MODE_ENCODE == mode)
+    if ((latency >= 0) && (MODE_DECODE != mode))
+    {
+        if (0 != FollowFile(inFile, outFile, &options,
+            MODE_APPEND == mode, latency))
+        {
+            perror("Failed to Encode Followed File");
+            status = EXIT_FAILURE;
+        }
+    }
+    else if (MODE_ENCODE == mode)
     {
-        if(-1 == DeltaEncodeFile(inFile, outFile, codeSize))
+        if(-1 == DeltaEncodeFileOpt(inFile, outFile, &options))
         {
             fprintf(stderr, "Failed to Encode File\n");
+            status = EXIT_FAILURE;
         }
     }
     else if (MODE_DECODE == mode)
     {
-        if(-1 == DeltaDecodeFile(inFile, outFile, codeSize))
+        if(-1 == DeltaDecodeFileOpt(inFile, outFile, decodeFlags))
         {
             fprintf(stderr, "Failed to Decode File\n");
+            status = EXIT_FAILURE;
+        }
+    }
+    else if (MODE_APPEND == mode)
+    {
+        if(-1 == DeltaEncodeAppend(inFile, outFile, &options))
+        {
+            perror("Failed to Add to Encoded File");
+            status = EXIT_FAILURE;
         }
     }
 
     fclose(inFile);
     fclose(outFile);
-    return EXIT_SUCCESS;
+    return status;
 }
 
 /****************************************************************************
@@ -244,10 +488,224 @@ static void ShowUsage(const char *const progName)
     printf("Options:\n");
     printf("  -c : encode input.\n");
     printf("  -d : decode input.\n");
-    printf("  -s : initial codeword size (2 - 8 bits).\n");
+    printf("  -u : encode input and add it to the end of the encoded\n");
+    printf("       output file.  The output file's settings (-w, -y, -n,\n");
+    printf("       -t, -r, -e, -b, and -a) must be given again.\n");
+    printf("  -x : don't check the CRC of each block.  Only used when\n");
+    printf("       decoding.\n");
+    printf("  -l : skip lost or damaged data, decoding again from the\n");
+    printf("       next resynchronization point (see -k).  Lost bytes are\n");
+    printf("       written as 0s.  Only used when decoding.\n");
+    printf("  -s : initial codeword size (2 - 8 x sample size bits, or a for\n");
+    printf("       automatic).  Only used when encoding.\n");
+    printf("  -w : sample size (1 - %d bytes, little endian).\n",
+        DELTA_MAX_SAMPLE_SIZE);
+    printf("       Only used when encoding.\n");
+    printf("  -y <type> : sample type, one of int8, int16, int32, int64,\n");
+    printf("       uint8, uint16, uint32, uint64, float, double, time32, or\n");
+    printf("       time64.  Sets -w and whether samples are signed, for\n");
+    printf("       float and double also -m xor -b gorilla, and for time32\n");
+    printf("       and time64 also -m period -b pfor.  Later options\n");
+    printf("       override it.\n");
+    printf("       Only used when encoding.\n");
+    printf("  -n : interleaved channels (1 - %d).  Each channel of a frame\n",
+        DELTA_MAX_CHANNELS);
+    printf("       is predicted and coded on its own.\n");
+    printf("       Only used when encoding.\n");
+    printf("  -t : split samples into byte planes, each coded as a\n");
+    printf("       channel of its own.  Only used when encoding.\n");
+    printf("  -r : image row width in pixels (frames of -n samples), or 0\n");
+    printf("       if the input isn't an image.  Enables the row modes.\n");
+    printf("       Only used when encoding.\n");
+    printf("  -e <error> : lossy coding; every decoded sample is within\n");
+    printf("       this much of the input (0 - %lu, 0 for lossless).\n",
+        DELTA_MAX_ERROR);
+    printf("       Samples are unsigned unless -y names a signed type.\n");
+    printf("       Only used when encoding.\n");
+    printf("  -k <frames> : write a resynchronization point every this\n");
+    printf("       many frames (rounded up to a 4KB block), 0 for none.\n");
+    printf("       Only used when encoding.\n");
+    printf("  -m <mode> : prediction mode, one of:\n");
+    printf("       delta - code differences between samples\n");
+    printf("       delta2 - code differences between differences\n");
+    printf("       fixed0 - code samples as they are\n");
+    printf("       fixed3, fixed4 - higher order fixed polynomials\n");
+    printf("       lms - adaptive sign-sign LMS on differences\n");
+    printf("       up - the pixel above (needs -r)\n");
+    printf("       average - mean of the pixels left and above (needs -r)\n");
+    printf("       paeth - PNG Paeth predictor (needs -r)\n");
+    printf("       xor - bits that changed from the last sample\n");
+    printf("       period - last sample plus the period (timestamps)\n");
+    printf("       auto - pick the cheapest of the above for each block\n");
+    printf("       Only used when encoding.\n");
+    printf("  -f <MB/s> : with -m auto, reuse the last block's predictor\n");
+    printf("       while encoding is slower than this (0 for no limit).\n");
+    printf("       Only used when encoding.\n");
+    printf("  -b <backend> : residual coder, one of:\n");
+    printf("       bits - adaptive width code words (default)\n");
+    printf("       rans - rANS with a frequency table per block\n");
+    printf("       varint - zigzag group varints, fast to decode\n");
+    printf("       pfor - fixed width frames of 128 with patched outliers\n");
+    printf("       gorilla - leading/trailing zeros and meaningful bits\n");
+    printf("       of each residual, for -m xor on floating point\n");
+    printf("       Only used when encoding.\n");
+    printf("  -a <policy> : code size adaptation policy, one of:\n");
+    printf("       classic\n");
+    printf("       threshold[,overflows[,underflows[,step]]]\n");
+    printf("       ema[,shift]\n");
+    printf("       window[,size]\n");
+    printf("       Only used when encoding.\n");
+    printf("  -p <filename> : load options from a profile written by tune.\n");
+    printf("       A profile may set any of -a, -s, -w, -y, -n, -t, -r,\n");
+    printf("       -e, -m, -f, -b, and -k.  Options are applied in\n");
+    printf("       command line order.\n");
+    printf("  -g <seconds> : follow an input file that's still being\n");
+    printf("       written, encoding data as it's added and flushing the\n");
+    printf("       output at least this often, until interrupted.  Only\n");
+    printf("       used when encoding.\n");
     printf("  -i <filename> : Name of input file.\n");
-    printf("  -o <filename> : Name of output file.\n");
+    printf("  -o <filename> : Name of output file.  Required with -u.\n");
     printf("  -h | ?  : Print out command line options.\n\n");
-    printf("Default: %s -s%d -c -i stdin -o stdout\n",
-        progName, DEFAULT_SIZE);
+    printf("Default: %s -s%d -w1 -n1 -r0 -e0 -m delta -a classic -c "
+        "-i stdin -o stdout\n", progName, DEFAULT_SIZE);
+}
+
+/****************************************************************************
+*   Function   : CloseAll
+*   Description: This function releases everything main may be holding
+*                when it has to exit early.
+*   Parameters : inFile - input file or NULL
+*                outFile - output file or NULL
+*                optList - remaining command line options or NULL
+*   Effects    : Open files are closed and the option list is freed.
+*   Returned   : None
+****************************************************************************/
+static void CloseAll(FILE *inFile, FILE *outFile, option_t *optList)
+{
+    if (inFile != NULL)
+    {
+        fclose(inFile);
+    }
+
+    if (outFile != NULL)
+    {
+        fclose(outFile);
+    }
+
+    FreeOptList(optList);
+}
+
+/****************************************************************************
+*   Function   : FollowFile
+*   Description: This function encodes an input file that another process
+*                is still adding to.  Whenever the end of the file is
+*                reached, it waits and checks again, so data is encoded as
+*                it's added.  Output is flushed at least every latency
+*                seconds while there's new data, so it can be read without
+*                waiting for the end.  It stops on SIGINT or SIGTERM.
+*   Parameters : inFile - file being followed
+*                outFile - file receiving the encoded stream
+*                options - encoding options
+*                append - non-zero to add to the encoded stream already in
+*                         outFile
+*                latency - the most seconds encoded data may wait before
+*                          being flushed, 0 to flush every check
+*   Effects    : inFile is encoded to outFile until a signal arrives.  The
+*                files aren't closed.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int FollowFile(FILE *inFile, FILE *outFile,
+    const delta_options_t *options, const int append, const long latency)
+{
+    delta_encoder_t *encoder;
+    unsigned char buffer[READ_CHUNK];
+    size_t length;
+    time_t lastFlush;
+    int pending;
+
+    encoder = append ? DeltaEncoderOpenAppend(outFile, options) :
+        DeltaEncoderOpen(outFile, options);
+
+    if (NULL == encoder)
+    {
+        return -1;
+    }
+
+    signal(SIGINT, StopFollowing);
+    signal(SIGTERM, StopFollowing);
+    lastFlush = time(NULL);
+    pending = 0;
+
+    while (!stopFollowing)
+    {
+        length = fread(buffer, sizeof(unsigned char), READ_CHUNK, inFile);
+
+        if (0 != length)
+        {
+            if (0 != DeltaEncoderWrite(encoder, buffer, length))
+            {
+                DeltaEncoderClose(encoder);
+                return -1;
+            }
+
+            pending = 1;
+        }
+
+        if (pending && (difftime(time(NULL), lastFlush) >= latency))
+        {
+            if (0 != DeltaEncoderFlush(encoder))
+            {
+                DeltaEncoderClose(encoder);
+                return -1;
+            }
+
+            lastFlush = time(NULL);
+            pending = 0;
+        }
+
+        if (0 == length)
+        {
+            /* caught up; the writer may add more */
+            clearerr(inFile);
+            SleepMs(POLL_MS);
+        }
+    }
+
+    return DeltaEncoderClose(encoder);
+}
+
+/****************************************************************************
+*   Function   : StopFollowing
+*   Description: This function is the SIGINT and SIGTERM handler used while
+*                following an input file.
+*   Parameters : sig - the signal that arrived
+*   Effects    : stopFollowing is set, so the stream is ended cleanly.
+*   Returned   : None
+****************************************************************************/
+static void StopFollowing(int sig)
+{
+    (void)sig;
+    stopFollowing = 1;
+}
+
+/****************************************************************************
+*   Function   : SleepMs
+*   Description: This function waits without using the processor.
+*   Parameters : ms - the number of milliseconds to wait
+*   Effects    : The program waits ms milliseconds, or less if a signal
+*                arrives.
+*   Returned   : None
+****************************************************************************/
+static void SleepMs(const unsigned int ms)
+{
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    struct timespec wait;
+
+    wait.tv_sec = ms / 1000;
+    wait.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&wait, NULL);
+#endif
 }
@@ -0,0 +1,252 @@
+/***************************************************************************
+*              Encoded Stream Splicer Using Delta Encoding Library
+*
+*   File    : splice.c
+*   Purpose : Join encoded streams end to end, or split one in two at a
+*             resynchronization point, without decoding and re-encoding
+*             the samples.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* SPLICE: Encoded stream splicer for the Delta Encoding Library
+* Copyright (C) 2026 by
+*       Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the delta library.
+*
+* The delta library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The delta library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "optlist/optlist.h"
+#include "delta.h"
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static void ShowUsage(const char *const progName);
+static void CloseFiles(FILE **files, const unsigned int count);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : main
+*   Description: This is the main function for this program.  It joins
+*                the encoded streams named on the command line into one
+*                stream, or, if a split offset is given, splits the one
+*                stream named at the first resynchronization point at or
+*                past that offset.
+*   Parameters : argc - number of parameters
+*                argv - parameter list
+*   Effects    : The joined stream or the two halves of the split stream
+*                are written.  The split point is written to stdout.
+*   Returned   : EXIT_SUCCESS for success, otherwise EXIT_FAILURE.
+****************************************************************************/
+int main(int argc, char *argv[])
+{
+    FILE **inFiles, *outFile, *tailFile;
+    const char *outName, *tailName;
+    option_t *optList, *thisOpt;
+    unsigned int count;
+    unsigned long offset;
+    int split, result;
+
+    /* there can't be more input files than arguments */
+    if (NULL == (inFiles = (FILE **)malloc(argc * sizeof(FILE *))))
+    {
+        perror("Allocating file list");
+        return EXIT_FAILURE;
+    }
+
+    count = 0;
+    outName = NULL;
+    tailName = NULL;
+    offset = 0;
+    split = 0;
+
+    /* parse command line */
+    optList = GetOptList(argc, argv, "i:o:t:s:h?");
+    thisOpt = optList;
+
+    while (thisOpt != NULL)
+    {
+        switch(thisOpt->option)
+        {
+            case 'i':       /* encoded input file name */
+                if (NULL == (inFiles[count] = fopen(thisOpt->argument, "rb")))
+                {
+                    perror(thisOpt->argument);
+                    goto failed;
+                }
+
+                count++;
+                break;
+
+            case 'o':       /* joined stream or first half name */
+                outName = thisOpt->argument;
+                break;
+
+            case 't':       /* second half name */
+                tailName = thisOpt->argument;
+                break;
+
+            case 's':       /* split offset */
+                offset = (unsigned long)atol(thisOpt->argument);
+                split = 1;
+                break;
+
+            case 'h':
+            case '?':
+                ShowUsage(FindFileName(argv[0]));
+                CloseFiles(inFiles, count);
+                FreeOptList(optList);
+                return EXIT_SUCCESS;
+        }
+
+        thisOpt = thisOpt->next;
+    }
+
+    if ((0 == count) || (split && ((1 != count) || (NULL == outName) ||
+        (NULL == tailName))))
+    {
+        fprintf(stderr, "Joining needs at least one input file, splitting "
+            "needs one input file and\nboth output files.\n\n");
+        ShowUsage(FindFileName(argv[0]));
+        goto failed;
+    }
+
+    if (NULL == outName)
+    {
+        outFile = stdout;
+    }
+    else if (NULL == (outFile = fopen(outName, "wb")))
+    {
+        perror(outName);
+        goto failed;
+    }
+
+    if (split)
+    {
+        if (NULL == (tailFile = fopen(tailName, "wb")))
+        {
+            perror(tailName);
+            fclose(outFile);
+            goto failed;
+        }
+
+        result = DeltaSplitFile(inFiles[0], outFile, tailFile, &offset);
+
+        if ((0 != result) && (ERANGE == errno))
+        {
+            fprintf(stderr, "No resynchronization point at or past %lu "
+                "bytes\n", offset);
+        }
+        else if (0 != result)
+        {
+            perror("Splitting stream");
+        }
+        else
+        {
+            printf("Split after %lu bytes\n", offset);
+        }
+
+        fclose(tailFile);
+    }
+    else
+    {
+        result = DeltaConcatFiles(inFiles, count, outFile);
+
+        if (0 != result)
+        {
+            perror("Joining streams");
+        }
+    }
+
+    if (stdout != outFile)
+    {
+        fclose(outFile);
+    }
+
+    if (0 != result)
+    {
+        goto failed;
+    }
+
+    CloseFiles(inFiles, count);
+    FreeOptList(optList);
+    return EXIT_SUCCESS;
+
+failed:
+    CloseFiles(inFiles, count);
+    FreeOptList(optList);
+    return EXIT_FAILURE;
+}
+
+/****************************************************************************
+*   Function   : ShowUsage
+*   Description: This function sends instructions for using this program to
+*                stdout.
+*   Parameters : progName - the name of the executable version of this
+*                           program.
+*   Effects    : Usage instructions are sent to stdout.
+*   Returned   : None
+****************************************************************************/
+static void ShowUsage(const char *const progName)
+{
+    printf("Usage: %s <options>\n\n", progName);
+    printf("Options:\n");
+    printf("  -i <filename> : Name of an encoded input file.  Repeat it to\n");
+    printf("       join files, in order.\n");
+    printf("  -o <filename> : Name of the joined file or the first half of\n");
+    printf("       the split file.  Joins go to stdout if it's omitted.\n");
+    printf("  -s <bytes> : split the input file at the first\n");
+    printf("       resynchronization point at or past this many decoded\n");
+    printf("       bytes.\n");
+    printf("  -t <filename> : Name of the second half of the split file.\n");
+    printf("  -h | ?  : Print out command line options.\n\n");
+    printf("Example: %s -i day1.d -i day2.d -o days.d\n", progName);
+    printf("         %s -i days.d -s 1048576 -o head.d -t tail.d\n",
+        progName);
+}
+
+/****************************************************************************
+*   Function   : CloseFiles
+*   Description: This function closes the input files and frees the list
+*                holding them.
+*   Parameters : files - The list of open files.
+*                count - The number of open files in the list.
+*   Effects    : The files are closed and the list is freed.
+*   Returned   : None
+****************************************************************************/
+static void CloseFiles(FILE **files, const unsigned int count)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i++)
+    {
+        fclose(files[i]);
+    }
+
+    free(files);
+}
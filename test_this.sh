@@ -1,16 +1,13 @@
 #!/bin/bash
 
-if [ -f foo ]
-then
-    echo this script requies use of a file foo
-    exit 1
-fi
-
-if [ -f bar ]
-then
-    echo this script requies use of a file bar
-    exit 1
-fi
+for X in foo bar baz qux
+do
+    if [ -f $X ]
+    then
+        echo this script requies use of a file $X
+        exit 1
+    fi
+done
 
 for X in *
 do
@@ -25,4 +22,116 @@ do
     fi
 done
 
+# deleting bytes from the middle of a stream may only lose the sync
+# interval holding them
+echo checking resynchronization after lost bytes
+cat *.c > baz
+./sample -c -k 4096 -i baz -o foo
+head -c 3500 foo > bar
+tail -c +3511 foo >> bar
+./sample -d -l -i bar -o foo 2> /dev/null
+
+if [ $(wc -c < baz) -ne $(wc -c < foo) ]
+then
+    echo resynchronized output is the wrong length
+fi
+
+cmp -l baz foo | awk 'NR == 1 {lost = int(($1 - 1) / 4096)}
+    int(($1 - 1) / 4096) != lost {bad = 1} END {exit bad}' ||
+    echo resynchronization lost more than one interval
+
+# a changed byte must fail the block's CRC, and only its interval is lost
+echo checking a damaged block
+./sample -c -k 4096 -i baz -o foo
+cp foo bar
+X=$(od -An -tu1 -j 3500 -N 1 foo)
+printf "$(printf '\\%03o' $(((X + 1) % 256)))" |
+    dd of=bar bs=1 seek=3500 conv=notrunc 2> /dev/null
+
+if ./sample -d -i bar -o foo 2> /dev/null
+then
+    echo damaged block was not caught
+fi
+
+if [ $(wc -c < baz) -le $(wc -c < foo) ] ||
+    ! head -c $(wc -c < foo) baz | cmp -s - foo
+then
+    echo damaged block was written
+fi
+
+./sample -d -l -i bar -o foo 2> /dev/null
+
+if [ $(wc -c < baz) -ne $(wc -c < foo) ]
+then
+    echo resynchronized output is the wrong length
+fi
+
+cmp -l baz foo | awk 'NR == 1 {lost = int(($1 - 1) / 4096)}
+    int(($1 - 1) / 4096) != lost {bad = 1} END {exit bad}' ||
+    echo resynchronization lost more than one interval
+rm foo bar baz
+
+# every lossy sample must decode to within the maximum error of its input;
+# samples are 1 or 2 bytes with the od type that reads them the same way
+echo checking lossy coding
+cat sample *.c > foo
+head -c $(($(wc -c < foo) / 2 * 2)) foo > baz
+
+for X in "int8 3 1 d1" "uint8 3 1 u1" "int16 100 2 d2" "uint16 100 2 u2"
+do
+    set -- $X
+    ./sample -c -y $1 -e $2 -i baz -o foo
+    ./sample -d -i foo -o bar
+
+    if [ $(wc -c < baz) -ne $(wc -c < bar) ]
+    then
+        echo $1 lossy output is the wrong length
+    fi
+
+    od -An -v -w$3 -t$4 baz > foo
+    od -An -v -w$3 -t$4 bar > qux
+    paste foo qux | awk -v max=$2 '{d = $1 - $2}
+        d > max || -d > max {bad = 1} END {exit bad}' ||
+        echo $1 lossy output is off by more than $2
+done
+
+rm foo bar baz qux
+
+# joined streams decode to their inputs in order, and the halves of a
+# split stream decode to the whole
+echo checking joining and splitting streams
+cat sample.c delta.c sample.c > qux
+./sample -c -k 1024 -i sample.c -o foo
+./sample -c -k 1024 -i delta.c -o bar
+./splice -i foo -i bar -i foo -o baz
+./sample -d -i baz | cmp -s - qux || echo joined stream decodes wrong
+
+X=$(./splice -i baz -s 50000 -o foo -t bar | awk '{print $3}')
+
+if [ -z "$X" ] || [ $(./sample -d -i foo | wc -c) -ne $X ]
+then
+    echo split is not where it was reported
+fi
+
+(./sample -d -i foo; ./sample -d -i bar) | cmp -s - qux ||
+    echo split stream decodes wrong
+rm foo bar baz qux
+
+# adding input that starts on a block boundary must write the same stream
+# as encoding all of it at once
+echo checking appending to a stream
+cat *.c > baz
+head -c 65536 baz > bar
+tail -c +65537 baz > qux
+
+for X in "" "-k 4096" "-y int16 -e 3 -a ema" "-s a -n 2"
+do
+    ./sample -c $X -i bar -o foo
+    ./sample -u $X -i qux -o foo
+    ./sample -c $X -i baz | cmp -s - foo ||
+        echo appending with \"$X\" differs from a single encode
+done
+
+rm foo bar baz qux
+
 exit 0
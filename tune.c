@@ -0,0 +1,1057 @@
+/***************************************************************************
+*              Encoding Option Tuner Using Delta Encoding Library
+*
+*   File    : tune.c
+*   Purpose : Search the code size adaptation policies, their parameters,
+*             and starting code sizes for the combination that encodes a
+*             corpus of sample files into the fewest bytes, then save it as
+*             a profile that the encoder can load.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* TUNE: Encoding option tuner for the Delta Encoding Library
+* Copyright (C) 2026 by
+*       Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the delta library.
+*
+* The delta library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The delta library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#ifndef _WIN32
+/* fork, pipe, and sysconf, for costing combinations in parallel */
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include "optlist/optlist.h"
+#include "delta.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+typedef struct sample_t
+{
+    unsigned char *data;        /* contents of a corpus file */
+    size_t length;              /* number of bytes in data */
+    struct sample_t *next;      /* next file in the corpus */
+} sample_t;
+
+typedef struct
+{
+    delta_options_t options;    /* options that were tried */
+    unsigned long bytes;        /* encoded size of the whole corpus */
+    double seconds;             /* processor time used to cost the corpus */
+} result_t;
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define READ_CHUNK      65536
+#define MAX_THRESHOLD   7       /* largest overflow/underflow count tried */
+#define MAX_STEP        3       /* largest code size step tried */
+#define MAX_EMA_SHIFT   8       /* largest EMA shift tried */
+
+/* most parameter sets tried for one policy (threshold's) */
+#define MAX_PARAMS      ((MAX_THRESHOLD + 1) * (MAX_THRESHOLD + 1) * MAX_STEP)
+
+#define REFINE_COUNT    4       /* parameter sets tried with every size */
+#define MAX_WORKERS     64      /* most processes costing at once */
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static void ShowUsage(const char *const progName);
+static sample_t *LoadSample(const char *fileName);
+static void FreeCorpus(sample_t *corpus);
+static int ChoosePredictor(const sample_t *corpus,
+    const delta_options_t *layout, int verbose, predictor_t *predictor);
+static int TryPolicy(const sample_t *corpus, const adapt_params_t *params,
+    const size_t count, const delta_options_t *layout,
+    const predictor_t predictor, int verbose, result_t *policyBest);
+static void SetLayout(delta_options_t *options,
+    const delta_options_t *layout);
+static int TryBatch(const sample_t *corpus, result_t *results,
+    const size_t count);
+static int TrySlice(const sample_t *corpus, result_t *results,
+    const size_t count, const size_t first, const size_t stride);
+#ifndef _WIN32
+static int ReadAll(const int fd, void *buffer, size_t length);
+static int WriteAll(const int fd, const void *buffer, size_t length);
+#endif
+static int TryOptions(const sample_t *corpus,
+    const delta_options_t *options, result_t *result);
+static void PrintResult(const char *label, const result_t *result,
+    unsigned long corpusBytes);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : main
+*   Description: This is the main function for this program.  It loads the
+*                corpus named on the command line, picks the predictor
+*                that costs the least with the classic policy, costs every
+*                combination of adaptation policy, policy parameters, and
+*                starting code size with that predictor, reports the best
+*                combination for each policy, costs the other backends with
+*                that predictor (gorilla with xor), and optionally saves
+*                the overall best as a profile.
+*   Parameters : argc - number of parameters
+*                argv - parameter list
+*   Effects    : Results are written to stdout and possibly a profile file.
+*   Returned   : EXIT_SUCCESS for success, otherwise EXIT_FAILURE.
+****************************************************************************/
+int main(int argc, char *argv[])
+{
+    sample_t *corpus, *sample;
+    const char *profileName;
+    int verbose;
+    option_t *optList, *thisOpt;
+    unsigned long corpusBytes;
+    adapt_params_t params[MAX_PARAMS];
+    size_t count;
+    result_t best, policyBest, others[DELTA_NUM_BACKENDS];
+    predictor_t predictor;
+    int backend;
+    delta_options_t layout;
+    unsigned char overflow, underflow, step, shift, size;
+
+    corpus = NULL;
+    profileName = NULL;
+    verbose = 0;
+    DeltaDefaultOptions(&layout);       /* only the sample layout is used */
+
+    /* parse command line */
+    optList = GetOptList(argc, argv, "i:o:w:y:n:r:e:tvh?");
+    thisOpt = optList;
+
+    while (thisOpt != NULL)
+    {
+        switch(thisOpt->option)
+        {
+            case 'i':       /* corpus file name */
+                if (NULL == (sample = LoadSample(thisOpt->argument)))
+                {
+                    perror(thisOpt->argument);
+                    FreeCorpus(corpus);
+                    FreeOptList(optList);
+                    return EXIT_FAILURE;
+                }
+
+                sample->next = corpus;
+                corpus = sample;
+                break;
+
+            case 'o':       /* profile file name */
+                profileName = thisOpt->argument;
+                break;
+
+            case 'w':       /* bytes per sample */
+                layout.sampleSize = atoi(thisOpt->argument);
+
+                if ((layout.sampleSize < 1) ||
+                    (layout.sampleSize > DELTA_MAX_SAMPLE_SIZE))
+                {
+                    fprintf(stderr, "Sample size must be between 1 and %d "
+                        "bytes.\n", DELTA_MAX_SAMPLE_SIZE);
+                    FreeCorpus(corpus);
+                    FreeOptList(optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'y':       /* sample type; only its layout is used */
+                if (0 != DeltaSampleType(thisOpt->argument, &layout))
+                {
+                    fprintf(stderr, "Invalid sample type %s.\n",
+                        thisOpt->argument);
+                    FreeCorpus(corpus);
+                    FreeOptList(optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'n':       /* interleaved channels */
+                layout.channels = atoi(thisOpt->argument);
+
+                if ((layout.channels < 1) ||
+                    (layout.channels > DELTA_MAX_CHANNELS))
+                {
+                    fprintf(stderr, "Channels must be between 1 and %d.\n",
+                        DELTA_MAX_CHANNELS);
+                    FreeCorpus(corpus);
+                    FreeOptList(optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'r':       /* image row width */
+                layout.width = atoi(thisOpt->argument);
+
+                if (layout.width > DELTA_MAX_WIDTH)
+                {
+                    fprintf(stderr, "Row width must be between 0 and %u.\n",
+                        DELTA_MAX_WIDTH);
+                    FreeCorpus(corpus);
+                    FreeOptList(optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 'e':       /* lossy maximum error */
+                layout.maxError = (unsigned long)atol(thisOpt->argument);
+
+                if (layout.maxError > DELTA_MAX_ERROR)
+                {
+                    fprintf(stderr, "Maximum error must be between 0 and "
+                        "%lu.\n", DELTA_MAX_ERROR);
+                    FreeCorpus(corpus);
+                    FreeOptList(optList);
+                    return EXIT_FAILURE;
+                }
+
+                break;
+
+            case 't':       /* byte planes */
+                layout.planes = 1;
+                break;
+
+            case 'v':       /* report every combination */
+                verbose = 1;
+                break;
+
+            case 'h':
+            case '?':
+                ShowUsage(FindFileName(argv[0]));
+                FreeCorpus(corpus);
+                FreeOptList(optList);
+                return EXIT_SUCCESS;
+        }
+
+        thisOpt = thisOpt->next;
+    }
+
+    if (NULL == corpus)
+    {
+        fprintf(stderr, "At least one corpus file is required.\n\n");
+        ShowUsage(FindFileName(argv[0]));
+        FreeOptList(optList);
+        return EXIT_FAILURE;
+    }
+
+    corpusBytes = 0;
+
+    for (sample = corpus; NULL != sample; sample = sample->next)
+    {
+        corpusBytes += sample->length;
+    }
+
+    if (0 != ChoosePredictor(corpus, &layout, verbose, &predictor))
+    {
+        goto failed;
+    }
+
+    best.bytes = (unsigned long)(-1);
+
+    /* classic */
+    DefaultAdaptiveParams(&params[0], ADAPT_CLASSIC);
+    policyBest.bytes = (unsigned long)(-1);
+
+    if (0 != TryPolicy(corpus, params, 1, &layout, predictor, verbose,
+        &policyBest))
+    {
+        goto failed;
+    }
+
+    PrintResult("classic", &policyBest, corpusBytes);
+    best = policyBest;
+
+    /* threshold */
+    policyBest.bytes = (unsigned long)(-1);
+    count = 0;
+
+    for (overflow = 0; overflow <= MAX_THRESHOLD; overflow++)
+    {
+        for (underflow = 0; underflow <= MAX_THRESHOLD; underflow++)
+        {
+            for (step = 1; step <= MAX_STEP; step++)
+            {
+                DefaultAdaptiveParams(&params[count], ADAPT_THRESHOLD);
+                params[count].maxOverflow = overflow;
+                params[count].maxUnderflow = underflow;
+                params[count].step = step;
+                count++;
+            }
+        }
+    }
+
+    if (0 != TryPolicy(corpus, params, count, &layout, predictor, verbose,
+        &policyBest))
+    {
+        goto failed;
+    }
+
+    PrintResult("threshold", &policyBest, corpusBytes);
+
+    if (policyBest.bytes < best.bytes)
+    {
+        best = policyBest;
+    }
+
+    /* ema */
+    policyBest.bytes = (unsigned long)(-1);
+    count = 0;
+
+    for (shift = 1; shift <= MAX_EMA_SHIFT; shift++)
+    {
+        DefaultAdaptiveParams(&params[count], ADAPT_EMA);
+        params[count].emaShift = shift;
+        count++;
+    }
+
+    if (0 != TryPolicy(corpus, params, count, &layout, predictor, verbose,
+        &policyBest))
+    {
+        goto failed;
+    }
+
+    PrintResult("ema", &policyBest, corpusBytes);
+
+    if (policyBest.bytes < best.bytes)
+    {
+        best = policyBest;
+    }
+
+    /* window */
+    policyBest.bytes = (unsigned long)(-1);
+    count = 0;
+
+    for (size = 4; size <= MAX_WINDOW_SIZE; size *= 2)
+    {
+        DefaultAdaptiveParams(&params[count], ADAPT_WINDOW);
+        params[count].windowSize = size;
+        count++;
+    }
+
+    if (0 != TryPolicy(corpus, params, count, &layout, predictor, verbose,
+        &policyBest))
+    {
+        goto failed;
+    }
+
+    PrintResult("window", &policyBest, corpusBytes);
+
+    if (policyBest.bytes < best.bytes)
+    {
+        best = policyBest;
+    }
+
+    /* the other backends have no code size or policy to search; gorilla
+     * is built for XOR residuals, so it's costed with those */
+    for (backend = DELTA_BACKEND_RANS; backend < DELTA_NUM_BACKENDS;
+        backend++)
+    {
+        SetLayout(&(others[backend].options), &layout);
+        others[backend].options.predictor =
+            (DELTA_BACKEND_GORILLA == backend) ? PREDICT_XOR : predictor;
+        others[backend].options.backend = (delta_backend_t)backend;
+    }
+
+    if (0 != TryBatch(corpus, others + DELTA_BACKEND_RANS,
+        DELTA_NUM_BACKENDS - DELTA_BACKEND_RANS))
+    {
+        perror("Costing corpus");
+        goto failed;
+    }
+
+    for (backend = DELTA_BACKEND_RANS; backend < DELTA_NUM_BACKENDS;
+        backend++)
+    {
+        PrintResult(DeltaBackendName(others[backend].options.backend),
+            &others[backend], corpusBytes);
+
+        if (others[backend].bytes < best.bytes)
+        {
+            best = others[backend];
+        }
+    }
+
+    printf("\n");
+    PrintResult("best", &best, corpusBytes);
+
+    if (NULL != profileName)
+    {
+        if (0 != DeltaSaveProfile(profileName, &(best.options)))
+        {
+            perror(profileName);
+            goto failed;
+        }
+
+        printf("Profile written to %s\n", profileName);
+    }
+
+    FreeCorpus(corpus);
+    FreeOptList(optList);
+    return EXIT_SUCCESS;
+
+failed:
+    FreeCorpus(corpus);
+    FreeOptList(optList);
+    return EXIT_FAILURE;
+}
+
+/****************************************************************************
+*   Function   : ShowUsage
+*   Description: This function sends instructions for using this program to
+*                stdout.
+*   Parameters : progName - the name of the executable version of this
+*                           program.
+*   Effects    : Usage instructions are sent to stdout.
+*   Returned   : None
+****************************************************************************/
+static void ShowUsage(const char *const progName)
+{
+    printf("Usage: %s <options>\n\n", progName);
+    printf("Options:\n");
+    printf("  -i <filename> : Name of a corpus file.  May be repeated.\n");
+    printf("  -o <filename> : Name of profile to write the best options to.\n");
+    printf("  -w : sample size (1 - %d bytes, little endian).\n",
+        DELTA_MAX_SAMPLE_SIZE);
+    printf("  -y <type> : sample type (int8 - int64, uint8 - uint64,\n");
+    printf("       float, double, time32, or time64); sets -w and signed\n");
+    printf("       samples.\n");
+    printf("  -n : interleaved channels (1 - %d).\n", DELTA_MAX_CHANNELS);
+    printf("  -r : image row width in pixels, 0 if not an image.\n");
+    printf("  -t : code each byte of a sample as a channel of its own.\n");
+    printf("  -e : lossy coding's maximum error, 0 for lossless.\n");
+    printf("  -v : report the result of every combination tried.\n");
+    printf("  -h | ?  : Print out command line options.\n\n");
+    printf("Example: %s -i sensor1.raw -i sensor2.raw -o sensor.prf\n",
+        progName);
+}
+
+/****************************************************************************
+*   Function   : LoadSample
+*   Description: This function reads an entire corpus file into memory.
+*   Parameters : fileName - The name of the file to read.
+*   Effects    : Memory is allocated for the file and its contents.
+*   Returned   : Pointer to the loaded file or NULL on failure.  errno will
+*                be set in the event of a failure.
+****************************************************************************/
+static sample_t *LoadSample(const char *fileName)
+{
+    FILE *fp;
+    sample_t *sample;
+    unsigned char *grown;
+    size_t capacity, got;
+
+    if (NULL == (fp = fopen(fileName, "rb")))
+    {
+        return NULL;
+    }
+
+    if (NULL == (sample = (sample_t *)malloc(sizeof(sample_t))))
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    sample->data = NULL;
+    sample->length = 0;
+    sample->next = NULL;
+    capacity = 0;
+
+    do
+    {
+        if (sample->length == capacity)
+        {
+            capacity += READ_CHUNK;
+            grown = (unsigned char *)realloc(sample->data, capacity);
+
+            if (NULL == grown)
+            {
+                free(sample->data);
+                free(sample);
+                fclose(fp);
+                return NULL;
+            }
+
+            sample->data = grown;
+        }
+
+        got = fread(sample->data + sample->length, 1,
+            capacity - sample->length, fp);
+        sample->length += got;
+    } while (0 != got);
+
+    if (ferror(fp))
+    {
+        free(sample->data);
+        free(sample);
+        fclose(fp);
+        return NULL;
+    }
+
+    fclose(fp);
+    return sample;
+}
+
+/****************************************************************************
+*   Function   : FreeCorpus
+*   Description: This function frees a list of corpus files.
+*   Parameters : corpus - The list of loaded files.
+*   Effects    : All memory used by the corpus is freed.
+*   Returned   : None
+****************************************************************************/
+static void FreeCorpus(sample_t *corpus)
+{
+    sample_t *next;
+
+    while (NULL != corpus)
+    {
+        next = corpus->next;
+        free(corpus->data);
+        free(corpus);
+        corpus = next;
+    }
+}
+
+/****************************************************************************
+*   Function   : ChoosePredictor
+*   Description: This function costs the corpus with every predictor and
+*                with per block selection (PREDICT_AUTO), using the classic
+*                policy and automatic code sizing.  The
+*                predictor barely interacts with the adaptation policy, so
+*                picking it first keeps the policy search from being
+*                repeated for every predictor.
+*   Parameters : corpus - The list of loaded files.
+*                layout - Options holding the sample size, channels, byte
+*                         planes, and row width of the corpus.
+*                verbose - Non-zero if every result should be printed.
+*                predictor - Where to store the cheapest predictor.
+*   Effects    : *predictor is set to the cheapest predictor.
+*   Returned   : 0 for success, -1 for failure.
+****************************************************************************/
+static int ChoosePredictor(const sample_t *corpus,
+    const delta_options_t *layout, int verbose, predictor_t *predictor)
+{
+    result_t results[PREDICT_AUTO + 1];
+    unsigned long bestBytes;
+    size_t count, i;
+    int trial;
+
+    count = 0;
+
+    for (trial = 0; trial <= PREDICT_AUTO; trial++)
+    {
+        if ((0 == layout->width) && PredictorUsesRows((predictor_t)trial))
+        {
+            /* not an image */
+            continue;
+        }
+
+        SetLayout(&(results[count].options), layout);
+        results[count].options.codeSize = DELTA_AUTO_SIZE;
+        results[count].options.predictor = (predictor_t)trial;
+        count++;
+    }
+
+    if (0 != TryBatch(corpus, results, count))
+    {
+        perror("Costing corpus");
+        return -1;
+    }
+
+    bestBytes = (unsigned long)(-1);
+    *predictor = results[0].options.predictor;
+
+    for (i = 0; i < count; i++)
+    {
+        if (verbose)
+        {
+            printf("%-8s classic size a: %lu bytes\n",
+                PredictorName(results[i].options.predictor),
+                results[i].bytes);
+        }
+
+        if (results[i].bytes < bestBytes)
+        {
+            bestBytes = results[i].bytes;
+            *predictor = results[i].options.predictor;
+        }
+    }
+
+    return 0;
+}
+
+/****************************************************************************
+*   Function   : TryPolicy
+*   Description: This function costs the corpus for a policy's parameter
+*                sets.  Every set is costed with automatic code sizing
+*                first, and only the REFINE_COUNT cheapest are then costed
+*                with every starting code size.  A set that does poorly
+*                with automatic sizing rarely wins with a fixed size, and
+*                trying every size for every set multiplied the search by
+*                the number of sizes.
+*   Parameters : corpus - The list of loaded files.
+*                params - The adaptation parameter sets to try.
+*                count - The number of parameter sets.
+*                layout - Options holding the sample size, channels, byte
+*                         planes, and row width of the corpus.
+*                predictor - The predictor to use.
+*                verbose - Non-zero if every result should be printed.
+*                policyBest - The best result for this policy so far.
+*   Effects    : policyBest is updated if a better combination is found.
+*   Returned   : 0 for success, -1 for failure.
+****************************************************************************/
+static int TryPolicy(const sample_t *corpus, const adapt_params_t *params,
+    const size_t count, const delta_options_t *layout,
+    const predictor_t predictor, int verbose, result_t *policyBest)
+{
+    result_t *results;
+    size_t chosen[REFINE_COUNT];
+    size_t sizes, refine, tried, pick, i, j, k;
+    unsigned char size;
+    char text[ADAPT_TEXT_SIZE];
+
+    sizes = 8 * layout->sampleSize - MIN_CODE_SIZE + 1;
+    refine = (count < REFINE_COUNT) ? count : REFINE_COUNT;
+    results = (result_t *)malloc((count + refine * sizes) *
+        sizeof(result_t));
+
+    if (NULL == results)
+    {
+        perror("Costing corpus");
+        return -1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        SetLayout(&(results[i].options), layout);
+        results[i].options.adapt = params[i];
+        results[i].options.predictor = predictor;
+        results[i].options.codeSize = DELTA_AUTO_SIZE;
+    }
+
+    if (0 != TryBatch(corpus, results, count))
+    {
+        perror("Costing corpus");
+        free(results);
+        return -1;
+    }
+
+    tried = count;
+
+    for (i = 0; i < refine; i++)
+    {
+        /* the cheapest set not chosen yet; ties go to the first */
+        pick = count;
+
+        for (j = 0; j < count; j++)
+        {
+            for (k = 0; (k < i) && (chosen[k] != j); k++)
+            {
+                /* look for j among the sets already chosen */
+            }
+
+            if ((k == i) &&
+                ((count == pick) || (results[j].bytes < results[pick].bytes)))
+            {
+                pick = j;
+            }
+        }
+
+        chosen[i] = pick;
+
+        for (size = MIN_CODE_SIZE; size <= 8 * layout->sampleSize; size++)
+        {
+            results[tried] = results[pick];
+            results[tried].options.codeSize = size;
+            tried++;
+        }
+    }
+
+    if (0 != TryBatch(corpus, results + count, tried - count))
+    {
+        perror("Costing corpus");
+        free(results);
+        return -1;
+    }
+
+    for (i = 0; i < tried; i++)
+    {
+        if (verbose)
+        {
+            FormatAdaptiveParams(&(results[i].options.adapt), text);
+            printf("%-8s %-24s size ",
+                PredictorName(results[i].options.predictor), text);
+
+            if (DELTA_AUTO_SIZE == results[i].options.codeSize)
+            {
+                printf("a: %lu bytes\n", results[i].bytes);
+            }
+            else
+            {
+                printf("%u: %lu bytes\n", results[i].options.codeSize,
+                    results[i].bytes);
+            }
+        }
+
+        if (results[i].bytes < policyBest->bytes)
+        {
+            *policyBest = results[i];
+        }
+    }
+
+    free(results);
+    return 0;
+}
+
+/****************************************************************************
+*   Function   : SetLayout
+*   Description: This function sets options to the defaults with the
+*                sample layout of the corpus.
+*   Parameters : options - The options to set.
+*                layout - Options holding the sample size, channels, byte
+*                         planes, and row width of the corpus.
+*   Effects    : options is overwritten.
+*   Returned   : None
+****************************************************************************/
+static void SetLayout(delta_options_t *options,
+    const delta_options_t *layout)
+{
+    DeltaDefaultOptions(options);
+    options->sampleSize = layout->sampleSize;
+    options->channels = layout->channels;
+    options->planes = layout->planes;
+    options->width = layout->width;
+    options->maxError = layout->maxError;
+    options->isSigned = layout->isSigned;
+}
+
+/****************************************************************************
+*   Function   : TryBatch
+*   Description: This function costs the corpus for a batch of encoding
+*                options.  Where fork is available, the batch is shared
+*                by a process for each processor: each costs every nth
+*                set of options and sends its results back through a pipe.
+*                The parent costs the first share itself, and any share
+*                whose process couldn't be started or didn't send all of
+*                its results.  Elsewhere the batch is costed in order.
+*   Parameters : corpus - The list of loaded files.
+*                results - The results to fill in.  Each holds the options
+*                          to try.
+*                count - The number of results.
+*   Effects    : The bytes and seconds of every result are set.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int TryBatch(const sample_t *corpus, result_t *results,
+    const size_t count)
+{
+#ifndef _WIN32
+    pid_t pids[MAX_WORKERS];
+    int fds[MAX_WORKERS], ends[2], status, failed;
+    size_t workers, limit, w, i;
+    long online;
+
+    online = sysconf(_SC_NPROCESSORS_ONLN);
+    workers = (online > 1) ? (size_t)online : 1;
+
+    if (workers > MAX_WORKERS)
+    {
+        workers = MAX_WORKERS;
+    }
+
+    if (workers > count)
+    {
+        workers = count;
+    }
+
+    for (w = 1; w < workers; w++)
+    {
+        pids[w] = -1;
+
+        if (0 != pipe(ends))
+        {
+            continue;
+        }
+
+        if (0 == (pids[w] = fork()))
+        {
+            /* costs its share and sends the results */
+            close(ends[0]);
+            status = TrySlice(corpus, results, count, w, workers);
+
+            for (i = w; (0 == status) && (i < count); i += workers)
+            {
+                status = WriteAll(ends[1], &results[i], sizeof(result_t));
+            }
+
+            _exit((0 == status) ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+
+        close(ends[1]);
+        fds[w] = ends[0];
+
+        if (pids[w] < 0)
+        {
+            close(ends[0]);
+        }
+    }
+
+    limit = count;
+    failed = 0;
+
+    if (0 != TrySlice(corpus, results, count, 0, workers))
+    {
+        failed = errno;
+        limit = 0;      /* just collect the processes */
+    }
+
+    for (w = 1; w < workers; w++)
+    {
+        i = w;
+
+        if (pids[w] >= 0)
+        {
+            while ((i < limit) &&
+                (0 == ReadAll(fds[w], &results[i], sizeof(result_t))))
+            {
+                i += workers;
+            }
+
+            close(fds[w]);
+            waitpid(pids[w], &status, 0);
+        }
+
+        if ((0 == failed) && (0 != TrySlice(corpus, results, limit, i,
+            workers)))
+        {
+            failed = errno;
+            limit = 0;
+        }
+    }
+
+    if (0 != failed)
+    {
+        errno = failed;
+        return -1;
+    }
+
+    return 0;
+#else
+    return TrySlice(corpus, results, count, 0, 1);
+#endif
+}
+
+/****************************************************************************
+*   Function   : TrySlice
+*   Description: This function costs the corpus for every stride-th set
+*                of options in a batch, starting with first.
+*   Parameters : corpus - The list of loaded files.
+*                results - The batch of results.  Each holds the options
+*                          to try.
+*                count - The number of results.
+*                first - The index of the first result to fill in.
+*                stride - The distance between results filled in.
+*   Effects    : The bytes and seconds of the results are set.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int TrySlice(const sample_t *corpus, result_t *results,
+    const size_t count, const size_t first, const size_t stride)
+{
+    size_t i;
+
+    for (i = first; i < count; i += stride)
+    {
+        if (0 != TryOptions(corpus, &(results[i].options), &results[i]))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+#ifndef _WIN32
+/****************************************************************************
+*   Function   : ReadAll
+*   Description: This function reads a buffer from a pipe, waiting for
+*                pieces of it if needed.
+*   Parameters : fd - The pipe to read.
+*                buffer - The buffer to fill.
+*                length - The number of bytes to read.
+*   Effects    : buffer is filled in.
+*   Returned   : 0 for success, -1 if the pipe closes first or fails.
+****************************************************************************/
+static int ReadAll(const int fd, void *buffer, size_t length)
+{
+    unsigned char *next;
+    ssize_t got;
+
+    for (next = (unsigned char *)buffer; 0 != length; length -= got)
+    {
+        got = read(fd, next, length);
+
+        if ((got < 0) && (EINTR == errno))
+        {
+            got = 0;
+        }
+        else if (got <= 0)
+        {
+            return -1;
+        }
+
+        next += got;
+    }
+
+    return 0;
+}
+
+/****************************************************************************
+*   Function   : WriteAll
+*   Description: This function writes a buffer to a pipe, writing it in
+*                pieces if needed.
+*   Parameters : fd - The pipe to write.
+*                buffer - The buffer to write.
+*                length - The number of bytes to write.
+*   Effects    : buffer is written to fd.
+*   Returned   : 0 for success, -1 if the pipe fails.
+****************************************************************************/
+static int WriteAll(const int fd, const void *buffer, size_t length)
+{
+    const unsigned char *next;
+    ssize_t put;
+
+    for (next = (const unsigned char *)buffer; 0 != length; length -= put)
+    {
+        put = write(fd, next, length);
+
+        if ((put < 0) && (EINTR == errno))
+        {
+            put = 0;
+        }
+        else if (put <= 0)
+        {
+            return -1;
+        }
+
+        next += put;
+    }
+
+    return 0;
+}
+#endif
+
+/****************************************************************************
+*   Function   : TryOptions
+*   Description: This function computes the encoded size of every file in
+*                the corpus for one set of encoding options.  Only the cost
+*                model is run; nothing is written.
+*   Parameters : corpus - The list of loaded files.
+*                options - The encoding options to try.
+*                result - Where to store the encoded size and time used.
+*   Effects    : result->bytes and result->seconds are set.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int TryOptions(const sample_t *corpus,
+    const delta_options_t *options, result_t *result)
+{
+    unsigned long bits;
+    clock_t start;
+
+    result->bytes = 0;
+    start = clock();
+
+    for (; NULL != corpus; corpus = corpus->next)
+    {
+        bits = DeltaCostBuffer(corpus->data, corpus->length, options);
+
+        if ((unsigned long)(-1) == bits)
+        {
+            return -1;
+        }
+
+        result->bytes += (bits + 7) / 8;
+    }
+
+    result->seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    return 0;
+}
+
+/****************************************************************************
+*   Function   : PrintResult
+*   Description: This function prints a tuning result.
+*   Parameters : label - Text to print in front of the result.
+*                result - The result to print.
+*                corpusBytes - The unencoded size of the corpus.
+*   Effects    : The result is written to stdout.
+*   Returned   : None
+****************************************************************************/
+static void PrintResult(const char *label, const result_t *result,
+    unsigned long corpusBytes)
+{
+    char text[ADAPT_TEXT_SIZE];
+
+    printf("%-10s -m %-6s ", label,
+        PredictorName(result->options.predictor));
+
+    if (DELTA_BACKEND_BITS != result->options.backend)
+    {
+        printf("-b %-25s", DeltaBackendName(result->options.backend));
+    }
+    else if (DELTA_AUTO_SIZE == result->options.codeSize)
+    {
+        FormatAdaptiveParams(&(result->options.adapt), text);
+        printf("-a %-20s -s a", text);
+    }
+    else
+    {
+        FormatAdaptiveParams(&(result->options.adapt), text);
+        printf("-a %-20s -s %u", text, result->options.codeSize);
+    }
+
+    printf(" : %lu of %lu bytes", result->bytes, corpusBytes);
+
+    if (result->seconds > 0)
+    {
+        printf(", %.1f MB/s", corpusBytes / result->seconds / 1e6);
+    }
+
+    printf("\n");
+}
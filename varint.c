@@ -0,0 +1,409 @@
+/***************************************************************************
+*               Delta Encoding Group Varint Residual Coder
+*
+*   File    : varint.c
+*   Purpose : Module that codes blocks of residuals as zigzag mapped group
+*             varints.  Everything is byte aligned, so it decodes much
+*             faster than the adaptive width code words, at the cost of
+*             compression.  It suits wide counters whose residuals vary
+*             a lot in size.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Delta: An adaptive delta encoding/decoding library
+* Copyright (C) 2026 by
+*       Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the Delta library.
+*
+* Delta is free software; you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or (at your
+* option) any later version.
+*
+* Delta is distributed in the hope that it will be useful, but WITHOUT ANY
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+* License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+* Residuals are zigzag mapped and stored as little endian values of 1, 2,
+* 3, or 4 bytes (1, 2, 4, or 8 bytes for samples wider than 32 bits).
+* Each group of 4 values has a control byte holding the 2 bit length code
+* of each value, first value in the low bits.
+*
+* A payload is:
+*   control bytes - one for every 4 residuals (the last may be partial)
+*   data bytes    - the values, in order
+*
+* Keeping the control bytes apart from the data (the Stream VByte layout)
+* means a group's data length is known from its control byte alone, so a
+* decoder can look it up in a table and check or fetch the whole group at
+* once.
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <limits.h>
+#include "predict.h"
+#include "varint.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define GROUP_SIZE      4       /* values per control byte */
+#define NUM_CONTROLS    256     /* possible control bytes */
+
+/* groups of values up to 4 bytes long can be decoded with SSSE3 byte
+ * shuffles, which need GCC's target attribute and CPU detection; define
+ * DELTA_NO_SIMD to build with the byte loops only */
+#if defined(__GNUC__) && !defined(DELTA_NO_SIMD) && \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define SIMD_GROUPS
+#include <tmmintrin.h>
+#endif
+
+/* bytes in an SSE register, which is the most a group of values up to 4
+ * bytes long takes */
+#define VECTOR_SIZE     16
+
+/***************************************************************************
+*                            GLOBAL VARIABLES
+***************************************************************************/
+/* bytes in a value for each length code */
+static const unsigned char narrowLengths[GROUP_SIZE] = {1, 2, 3, 4};
+static const unsigned char wideLengths[GROUP_SIZE] = {1, 2, 4, 8};
+
+#ifdef SIMD_GROUPS
+static int shuffleReady = 0;
+static int haveShuffles = 0;    /* non-zero if SSSE3 shuffles are used */
+
+/* shuffles[ctrl] moves the values of a group with control byte ctrl into
+ * 4 byte lanes, zeroing the bytes past each value */
+static unsigned char shuffles[NUM_CONTROLS][VECTOR_SIZE];
+static unsigned char groupBytes[NUM_CONTROLS];  /* data bytes in a group */
+#endif
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static const unsigned char *Lengths(const unsigned char sampleBits);
+static unsigned int LengthCode(const unsigned char *lengths,
+    const unsigned long value);
+
+#ifdef SIMD_GROUPS
+static int UseShuffles(void);
+static size_t DecodeGroups(const unsigned char *control,
+    const unsigned char **data, const unsigned char *end, long *residuals,
+    const size_t groups) __attribute__((target("ssse3")));
+#endif
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : VarintEncode
+*   Description: This function codes a block of residuals as group
+*                varints.
+*   Parameters : residuals - The residuals to code.
+*                count - The number of residuals.  It must not be 0.
+*                sampleBits - The number of bits in a sample.  Every
+*                             residual must fit in sampleBits bits.
+*                payload - Buffer receiving the coded block.  It must hold
+*                          VARINT_MAX_PAYLOAD(count, sampleBits) bytes.
+*   Effects    : The coded block is written to payload.
+*   Returned   : The number of bytes in the coded block.
+***************************************************************************/
+size_t VarintEncode(const long *residuals, const size_t count,
+    const unsigned char sampleBits, unsigned char *payload)
+{
+    const unsigned char *lengths;
+    unsigned char *control, *data;
+    unsigned long value;
+    unsigned int code, j;
+    size_t i;
+
+    lengths = Lengths(sampleBits);
+    control = payload;
+    data = payload + (count + GROUP_SIZE - 1) / GROUP_SIZE;
+
+    for (i = 0; i < count; i++)
+    {
+        if (0 == (i % GROUP_SIZE))
+        {
+            *control = 0;
+        }
+
+        value = ZigZag(residuals[i]);
+        code = LengthCode(lengths, value);
+        *control |= (unsigned char)(code << (2 * (i % GROUP_SIZE)));
+
+        for (j = 0; j < lengths[code]; j++)
+        {
+            *data++ = (unsigned char)(value & 0xFF);
+            value >>= 8;
+        }
+
+        if ((GROUP_SIZE - 1) == (i % GROUP_SIZE))
+        {
+            control++;
+        }
+    }
+
+    return data - payload;
+}
+
+/***************************************************************************
+*   Function   : VarintDecode
+*   Description: This function decodes a block of residuals written by
+*                VarintEncode.
+*   Parameters : payload - The coded block.
+*                length - The number of bytes in payload.
+*                sampleBits - The number of bits in a sample.
+*                residuals - Buffer receiving the residuals.
+*                count - The number of residuals to decode.
+*   Effects    : residuals is filled in.
+*   Returned   : 0 for success, -1 if the payload isn't a valid block of
+*                count residuals.
+***************************************************************************/
+int VarintDecode(const unsigned char *payload, const size_t length,
+    const unsigned char sampleBits, long *residuals, const size_t count)
+{
+    const unsigned char *lengths, *control, *data, *end;
+    unsigned char groupLength[NUM_CONTROLS];
+    unsigned long value;
+    unsigned int ctrl, len, j, k;
+    size_t i, controls;
+
+    lengths = Lengths(sampleBits);
+    controls = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+
+    if (length < controls)
+    {
+        return -1;
+    }
+
+    /* data bytes used by each possible control byte */
+    for (ctrl = 0; ctrl < NUM_CONTROLS; ctrl++)
+    {
+        groupLength[ctrl] = 0;
+
+        for (j = 0; j < GROUP_SIZE; j++)
+        {
+            groupLength[ctrl] += lengths[(ctrl >> (2 * j)) & 3];
+        }
+    }
+
+    control = payload;
+    data = payload + controls;
+    end = payload + length;
+    i = 0;
+
+#ifdef SIMD_GROUPS
+    if ((lengths == narrowLengths) && UseShuffles())
+    {
+        i = DecodeGroups(control, &data, end, residuals, count / GROUP_SIZE);
+        control += i / GROUP_SIZE;
+    }
+#endif
+
+    /* whole groups are checked against the end of the payload once */
+    for (; (i + GROUP_SIZE <= count) &&
+        ((size_t)(end - data) >= groupLength[*control]); control++)
+    {
+        ctrl = *control;
+
+        for (j = 0; j < GROUP_SIZE; j++, i++)
+        {
+            len = lengths[(ctrl >> (2 * j)) & 3];
+            value = 0;
+
+            for (k = len; k-- > 0; )
+            {
+                value = (value << 8) | data[k];
+            }
+
+            data += len;
+            residuals[i] = UnZigZag(value);
+        }
+    }
+
+    /* a partial last group, or a payload that runs out */
+    for (; i < count; i++)
+    {
+        len = lengths[(payload[i / GROUP_SIZE] >> (2 * (i % GROUP_SIZE))) &
+            3];
+
+        if ((size_t)(end - data) < len)
+        {
+            return -1;
+        }
+
+        value = 0;
+
+        for (k = len; k-- > 0; )
+        {
+            value = (value << 8) | data[k];
+        }
+
+        data += len;
+        residuals[i] = UnZigZag(value);
+    }
+
+    return (data == end) ? 0 : -1;
+}
+
+#ifdef SIMD_GROUPS
+/***************************************************************************
+*   Function   : UseShuffles
+*   Description: This function checks whether the processor has SSSE3's
+*                byte shuffles, which DecodeGroups needs, and builds the
+*                shuffle for every control byte.
+*   Parameters : None
+*   Effects    : The processor is checked, and shuffles and groupBytes are
+*                filled in, on the first call.
+*   Returned   : Non-zero if DecodeGroups may be used.
+***************************************************************************/
+static int UseShuffles(void)
+{
+    unsigned int ctrl, j, k, next, len;
+
+    if (!shuffleReady)
+    {
+        for (ctrl = 0; ctrl < NUM_CONTROLS; ctrl++)
+        {
+            next = 0;
+
+            for (j = 0; j < GROUP_SIZE; j++)
+            {
+                len = narrowLengths[(ctrl >> (2 * j)) & 3];
+
+                /* a byte with its high bit set shuffles in a 0 */
+                for (k = 0; k < 4; k++)
+                {
+                    shuffles[ctrl][4 * j + k] =
+                        (unsigned char)((k < len) ? (next + k) : 0x80);
+                }
+
+                next += len;
+            }
+
+            groupBytes[ctrl] = (unsigned char)next;
+        }
+
+        __builtin_cpu_init();
+        haveShuffles = __builtin_cpu_supports("ssse3");
+        shuffleReady = 1;
+    }
+
+    return haveShuffles;
+}
+
+/***************************************************************************
+*   Function   : DecodeGroups
+*   Description: This function decodes whole groups of values up to 4
+*                bytes long, a group at a time.  Each group's values are
+*                shuffled into 4 byte lanes, unzigzagged, and widened to
+*                longs together.  It stops at the first group that isn't
+*                followed by VECTOR_SIZE data bytes, so that the register
+*                load stays in the payload.  It must only be called if
+*                UseShuffles returns non-zero.
+*   Parameters : control - The control byte of the first group.
+*                data - Pointer to the data bytes of the first group.  It
+*                       is moved past the groups decoded.
+*                end - The end of the payload.
+*                residuals - Buffer receiving the residuals.
+*                groups - The number of whole groups to decode.
+*   Effects    : residuals is filled in for the groups decoded.
+*   Returned   : The number of residuals decoded.
+***************************************************************************/
+static size_t DecodeGroups(const unsigned char *control,
+    const unsigned char **data, const unsigned char *end, long *residuals,
+    const size_t groups)
+{
+    const unsigned char *next;
+    __m128i values, ones;
+    size_t g;
+
+    next = *data;
+    ones = _mm_set1_epi32(1);
+
+    for (g = 0; (g < groups) && ((size_t)(end - next) >= VECTOR_SIZE); g++)
+    {
+        values = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)next),
+            _mm_loadu_si128((const __m128i *)shuffles[control[g]]));
+        next += groupBytes[control[g]];
+
+        /* (value >> 1) ^ -(value & 1), the 32 bit UnZigZag */
+        values = _mm_xor_si128(_mm_srli_epi32(values, 1),
+            _mm_sub_epi32(_mm_setzero_si128(),
+            _mm_and_si128(values, ones)));
+
+#if (ULONG_MAX > 0xFFFFFFFFUL)
+        {
+            __m128i sign;
+
+            sign = _mm_srai_epi32(values, 31);
+            _mm_storeu_si128((__m128i *)(residuals + GROUP_SIZE * g),
+                _mm_unpacklo_epi32(values, sign));
+            _mm_storeu_si128((__m128i *)(residuals + GROUP_SIZE * g + 2),
+                _mm_unpackhi_epi32(values, sign));
+        }
+#else
+        _mm_storeu_si128((__m128i *)(residuals + GROUP_SIZE * g), values);
+#endif
+    }
+
+    *data = next;
+    return GROUP_SIZE * g;
+}
+#endif
+
+/***************************************************************************
+*   Function   : Lengths
+*   Description: This function returns the value lengths used for samples
+*                of a given width.
+*   Parameters : sampleBits - The number of bits in a sample.
+*   Effects    : None
+*   Returned   : The number of bytes for each of the 4 length codes.
+***************************************************************************/
+static const unsigned char *Lengths(const unsigned char sampleBits)
+{
+    return (sampleBits > 32) ? wideLengths : narrowLengths;
+}
+
+/***************************************************************************
+*   Function   : LengthCode
+*   Description: This function finds the shortest length code that holds
+*                a value.
+*   Parameters : lengths - The number of bytes for each length code.
+*                value - The zigzag mapped value to store.
+*   Effects    : None
+*   Returned   : The length code for value.
+***************************************************************************/
+static unsigned int LengthCode(const unsigned char *lengths,
+    const unsigned long value)
+{
+    unsigned int code;
+
+    for (code = 0; code < GROUP_SIZE - 1; code++)
+    {
+        /* shift in two steps so 8 byte lengths don't shift by 64 */
+        if (0 == ((value >> (8 * lengths[code] - 1)) >> 1))
+        {
+            break;
+        }
+    }
+
+    return code;
+}
@@ -0,0 +1,60 @@
+/***************************************************************************
+*            Header for Delta Encoding Group Varint Residual Coder
+*
+*   File    : varint.h
+*   Purpose : Provides prototypes for functions that code blocks of
+*             residuals as zigzag mapped, byte aligned group varints.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Delta: An adaptive delta encoding/decoding library
+* Copyright (C) 2026 by
+*       Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the Delta library.
+*
+* Delta is free software; you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or (at your
+* option) any later version.
+*
+* Delta is distributed in the hope that it will be useful, but WITHOUT ANY
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+* License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+#ifndef _VARINT_H_
+#define _VARINT_H_
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stddef.h>
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+/* largest payload VarintEncode writes for count residuals of sampleBits */
+#define VARINT_MAX_PAYLOAD(count, sampleBits) \
+    (((count) + 3) / 4 + (count) * ((sampleBits) > 32 ? 8 : \
+    ((sampleBits) + 7) / 8))
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+/* code count residuals of sampleBits bits, returning the payload size */
+size_t VarintEncode(const long *residuals, const size_t count,
+    const unsigned char sampleBits, unsigned char *payload);
+
+/* decode count residuals from a payload of length bytes, 0 for success */
+int VarintDecode(const unsigned char *payload, const size_t length,
+    const unsigned char sampleBits, long *residuals, const size_t count);
+
+#endif  /* ndef _VARINT_H_ */